@@ -0,0 +1,151 @@
+#include "BotController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+BotController::BotController(PlayerType type_) : type(type_) {
+	assert(type == PLAYER_0 || type == PLAYER_1);
+}
+
+//position of a point moving freely along x, after reflecting off walls at 'lo' and 'hi':
+// (unfolding: the mirrored copies of the arena tile the line with period 2 * width)
+static float fold(float x, float lo, float hi) {
+	float width = hi - lo;
+	float u = std::fmod(x - lo, 2.0f * width);
+	if (u < 0.0f) u += 2.0f * width;
+	return lo + (u <= width ? u : 2.0f * width - u);
+}
+
+bool BotController::predict_crossing(glm::vec2 position, glm::vec2 velocity, float line, float goal_radius, float horizon, float *x_, float *t_) {
+	assert(x_ && t_);
+
+	float const x_lo = Game::ArenaMin.x + Game::PuckRadius;
+	float const x_hi = Game::ArenaMax.x - Game::PuckRadius;
+	float const y_near = Game::ArenaMin.y + Game::PuckRadius;
+	float const y_far = Game::ArenaMax.y - Game::PuckRadius;
+	float const mouth = goal_radius - Game::PuckRadius;
+
+	//x stays unfolded (side walls are handled by fold()), y is followed from end wall to end wall:
+	float x = position.x;
+	float y = position.y;
+	float vy = velocity.y;
+	float t = 0.0f;
+
+	if (std::abs(vy) < 1e-4f) return false;
+
+	//a crossing comes after at most one bounce off each end:
+	for (uint32_t bounce = 0; bounce < 3; ++bounce) {
+		if (vy < 0.0f && y >= line) {
+			//heading down at the line:
+			float dt = (line - y) / vy;
+			if (t + dt > horizon) return false;
+			*x_ = fold(x + velocity.x * dt, x_lo, x_hi);
+			*t_ = t + dt;
+			return true;
+		}
+
+		//otherwise it reaches an end first -- bottom if heading down (from behind the line), else top:
+		float end = (vy < 0.0f ? y_near : y_far);
+		float dt = (end - y) / vy;
+		if (t + dt > horizon) return false;
+		x += velocity.x * dt;
+		t += dt;
+		y = end;
+		//through the goal mouth means a goal (the posts keep it in the goal once it's there):
+		if (std::abs(fold(x, x_lo, x_hi)) <= mouth) return false;
+		vy = -vy;
+	}
+	return false;
+}
+
+void BotController::update(Game const &game, Player::Controls *controls) {
+	assert(controls);
+
+	//work in bot space, where the bot defends the -y end:
+	float flip = (type == PLAYER_0 ? 1.0f : -1.0f);
+	Player const &self = (type == PLAYER_0 ? game.player_0 : game.player_1);
+	glm::vec2 position = glm::vec2(self.position.x, flip * self.position.y);
+	glm::vec2 velocity = glm::vec2(self.velocity.x, flip * self.velocity.y);
+
+	float const halflife = game.config.player_accel_halflife;
+	float const reach = Game::PlayerRadius + Game::PuckRadius;
+	glm::vec2 const goal = glm::vec2(0.0f, Game::ArenaMax.y); //(the one to shoot at)
+
+	//when the mallet could be at 'at' (full speed after spinning up for about two half-lives):
+	auto arrival = [&](glm::vec2 const &at) {
+		return glm::length(at - position) / Game::PlayerSpeed + 2.0f * halflife;
+	};
+
+	//line up 'behind' a puck at 'at' (on the side away from the goal being shot at),
+	// or swing through it once the puck is about to arrive:
+	auto approach = [&](glm::vec2 const &at, float time_left) {
+		glm::vec2 aim = goal - at;
+		aim = (glm::length(aim) > 0.0f ? glm::normalize(aim) : glm::vec2(0.0f, 1.0f));
+		if (time_left < 3.0f * halflife) return at + aim * reach;
+		return at - aim * (0.8f * reach);
+	};
+
+	plan = Guard;
+	float best_t = horizon;
+
+	//intercept whichever copy can be met soonest:
+	for (uint32_t i = 0; i < game.pucks.count; ++i) {
+		glm::vec2 p = glm::vec2(game.pucks.x[i], flip * game.pucks.y[i]);
+		glm::vec2 v = glm::vec2(game.pucks.vx[i], flip * game.pucks.vy[i]);
+
+		//slow on our side: go hit it
+		if (p.y < 0.0f && glm::dot(v, v) < 0.25f) {
+			float t = arrival(p);
+			if (t < best_t) {
+				best_t = t;
+				plan = Strike;
+				target = approach(p, glm::length(p - position) < 2.0f * reach ? 0.0f : t);
+			}
+			continue;
+		}
+
+		//moving: check each line, furthest from the goal first, for the earliest reachable crossing:
+		// (if none is reachable, fall back on the one nearest the goal, which leaves the most time)
+		glm::vec2 fallback = glm::vec2(0.0f);
+		float fallback_t = -1.0f;
+		for (uint32_t l = sizeof(Lines) / sizeof(Lines[0]); l > 0; --l) {
+			float line = Lines[l - 1];
+			float x, t;
+			if (!predict_crossing(p, v, line, game.config.goal_radius, horizon, &x, &t)) continue;
+			glm::vec2 at = glm::vec2(x, line);
+			if (arrival(at) <= t) {
+				if (t < best_t) {
+					best_t = t;
+					plan = Intercept;
+					target = approach(at, t);
+				}
+				fallback_t = -1.0f;
+				break;
+			}
+			fallback = at;
+			fallback_t = t;
+		}
+		if (fallback_t >= 0.0f && fallback_t < best_t) {
+			best_t = fallback_t;
+			plan = Intercept;
+			target = approach(fallback, fallback_t);
+		}
+	}
+
+	if (plan == Guard) {
+		//sit in front of the goal, shading toward the puck:
+		float x = (game.pucks.count ? game.pucks.x[0] : 0.0f);
+		target = glm::vec2(std::clamp(0.5f * x, -game.config.goal_radius, game.config.goal_radius), Game::Player0Min + 0.35f);
+	}
+
+	//steer, allowing for the distance it takes to stop (velocity drifts to zero with a half-life of 2 * halflife):
+	glm::vec2 stop = position + velocity * (2.0f * halflife / std::log(2.0f));
+	glm::vec2 delta = target - stop;
+
+	controls->left.pressed = (delta.x < -deadzone);
+	controls->right.pressed = (delta.x > deadzone);
+	bool up = (delta.y > deadzone);
+	bool down = (delta.y < -deadzone);
+	controls->up.pressed = (type == PLAYER_0 ? up : down);
+	controls->down.pressed = (type == PLAYER_0 ? down : up);
+}
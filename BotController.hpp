@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * BotController plays one side of a Game by choosing Player::Controls from the game state,
+ *  for practice, filling empty seats, and load testing.
+ *
+ * Every update it predicts where each puck copy will cross a few lines across its zone
+ *  (Player0Min..Player0Max, mirrored for PLAYER_1) -- in closed form, without stepping the
+ *  game: a straight path reflected off the side walls, and at each end line either reflected
+ *  off the wall or, inside the goal mouth, into the goal between the posts, the same way
+ *  Pucks::collide_arena bounces things. It then heads for the earliest crossing it can get
+ *  to before the puck does, lining up behind it so the hit sends the puck toward the other
+ *  goal. With nothing coming it hits a puck sitting on its side, or else guards its goal.
+ *
+ * A bot is a few bytes of state and an update is O(puck copies) with no allocation, so a
+ *  process can run thousands of them.
+ */
+
+#include "Game.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct BotController {
+	//play as 'type' (PLAYER_0 or PLAYER_1):
+	explicit BotController(PlayerType type = PLAYER_0);
+	PlayerType type;
+
+	//set the pressed state of 'controls' for what to do next in 'game':
+	// (doesn't touch downs, seq, or view_time)
+	void update(Game const &game, Player::Controls *controls);
+
+	//where a puck at 'position' moving at 'velocity' first crosses y = 'line' heading toward
+	// the -y end, within 'horizon' seconds; positions are in "bot space" (PLAYER_0's view, so the
+	// bot's own goal is at the -y end). Returns false if it won't (it scores at either end first,
+	// stops moving across the arena, or takes too long):
+	static bool predict_crossing(glm::vec2 position, glm::vec2 velocity, float line, float goal_radius, float horizon, float *x, float *t);
+
+	//tuning:
+	float horizon = 3.0f; //seconds of puck path to consider
+	float deadzone = 0.02f; //how close to the target (in each axis) counts as there
+
+	//what the bot is doing (for debugging or drawing):
+	enum Plan : uint8_t {
+		Guard, //nothing coming; sitting in front of the goal
+		Intercept, //meeting a puck where it crosses the zone
+		Strike, //hitting a slow puck on its own side
+	} plan = Guard;
+	glm::vec2 target = glm::vec2(0.0f); //where the bot is heading (bot space)
+
+	//lines across the zone that crossings are checked on (bot space, nearest the goal first):
+	inline static constexpr float Lines[] = {-1.75f, -1.45f, -1.15f, -0.85f};
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * ByteQueue is a first-in, first-out run of bytes, used for Connection's send and receive
+ *  buffers: bytes are appended at the back and consumed from the front, and whatever hasn't
+ *  been consumed yet is always contiguous, so message parsers can index into it (and memcpy
+ *  out of it) directly.
+ *
+ * Consuming just moves a read offset. The unread bytes are only slid back to the start of the
+ *  storage when an append needs room and at least as many bytes have been consumed as are left
+ *  (or for free, when everything has been consumed), so each byte is moved at most about once
+ *  however the reads are sliced -- rather than once per read, as with erasing from the front of
+ *  a vector, which makes a connection with many messages backed up quadratic to drain.
+ *
+ * Writers can also fill the storage in place: prepare(n) returns room for n bytes at the back,
+ *  and commit(k) appends the first k of them.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct ByteQueue {
+	//---- reading ----
+	size_t size() const { return tail - head; }
+	bool empty() const { return tail == head; }
+
+	//the unread bytes, in order ('size()' of them; only good until the next append or prepare):
+	uint8_t const *data() const { return storage.data() + head; }
+	uint8_t *data() { return storage.data() + head; }
+	uint8_t const &operator[](size_t i) const { assert(i < size()); return storage[head + i]; }
+	uint8_t &operator[](size_t i) { assert(i < size()); return storage[head + i]; }
+
+	//drop the first 'count' unread bytes:
+	void consume(size_t count) {
+		assert(count <= size());
+		head += count;
+		if (head == tail) head = tail = 0; //(empty, so the next append starts over at the front)
+	}
+	void clear() { head = tail = 0; }
+
+	//---- writing ----
+	void append(void const *bytes, size_t count) {
+		if (count == 0) return;
+		std::memcpy(prepare(count), bytes, count);
+		commit(count);
+	}
+
+	//room for 'count' more bytes at the back (only good until the next append or prepare)...
+	uint8_t *prepare(size_t count) {
+		if (storage.size() - tail < count) {
+			if (head > 0 && head >= tail - head) {
+				std::memmove(storage.data(), storage.data() + head, tail - head);
+				tail -= head;
+				head = 0;
+			}
+			if (storage.size() - tail < count) storage.resize(std::max(2 * storage.size(), tail + count));
+		}
+		return storage.data() + tail;
+	}
+	//...of which the first 'count' now hold data:
+	void commit(size_t count) {
+		assert(tail + count <= storage.size());
+		tail += count;
+	}
+
+	//trade contents with 'bytes' (e.g., to hand a whole message off without copying it):
+	void swap(std::vector< uint8_t > &bytes) {
+		if (head > 0) std::memmove(storage.data(), storage.data() + head, tail - head);
+		storage.resize(tail - head); //(keeps its capacity)
+		storage.swap(bytes);
+		head = 0;
+		tail = storage.size();
+	}
+
+	//-- internals --
+	std::vector< uint8_t > storage; //unread bytes are [head, tail); storage.size() is the capacity in use
+	size_t head = 0;
+	size_t tail = 0;
+};
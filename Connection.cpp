@@ -20,6 +20,7 @@ typedef int ssize_t;
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/ip.h>
 #include <unistd.h>
@@ -27,9 +28,28 @@ typedef int ssize_t;
 
 #define closesocket close
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 //(macOS doesn't have it)
+#endif
+
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <fcntl.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+//(multishot receives and provided buffer rings need headers from Linux 6.0 or later)
+#ifdef IORING_RECV_MULTISHOT
+#define POLLER_IO_URING 1
+#endif
+#endif
 #endif
 
 #include "Connection.hpp"
+#include "SlotMap.hpp"
 
 //------------------------------------------------------
 
@@ -38,6 +58,8 @@ typedef int ssize_t;
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
+#include <system_error>
 
 //NOTE: much of the sockets code herein is based on http-tweak's single-header http server
 // see: https://github.com/ixchow/http-tweak
@@ -47,144 +69,799 @@ typedef int ssize_t;
 
 void Connection::close() {
 	if (socket != InvalidSocket) {
+		if (poller) poller->closing(*this);
 		::closesocket(socket);
 		socket = InvalidSocket;
 	}
 }
 
-//---------------------------------
-//Polling helper used by both server and client:
-void poll_connections(
-	char const *where,
-	std::list< Connection > &connections,
-	std::function< void(Connection *, Connection::Event event) > const &on_event,
-	double timeout,
-	Socket listen_socket = InvalidSocket) {
-
-	fd_set read_fds, write_fds;
-	FD_ZERO(&read_fds);
-	FD_ZERO(&write_fds);
-
-	int max = 0;
-
-	//add listen_socket to fd_set if needed:
-	if (listen_socket != InvalidSocket) {
-		max = std::max(max, int(listen_socket));
-		FD_SET(listen_socket, &read_fds);
-	}
-
-	//add each connection's socket to read (and possibly write) sets:
-	for (auto c : connections) {
-		if (c.socket != InvalidSocket) {
-			max = std::max(max, int(c.socket));
-			FD_SET(c.socket, &read_fds);
-			if (!c.send_buffer.empty()) {
-				FD_SET(c.socket, &write_fds);
-			}
-		}
+void Connection::send_shared(std::shared_ptr< std::vector< uint8_t > const > const &bytes) {
+	if (!bytes || bytes->empty()) return;
+	shared.emplace_back(Shared{bytes, send_buffer.size() - shared_before, 0});
+	shared_before = send_buffer.size();
+}
+
+uint32_t Connection::gather_output(Piece *pieces, uint32_t max) const {
+	uint32_t count = 0;
+	//(once 'max' pieces are gathered nothing more is added, so what's gathered is always a prefix of the output)
+	auto add = [&](uint8_t const *data, size_t size) {
+		if (size > 0 && count < max) pieces[count++] = Piece{data, size};
+	};
+	size_t at = 0; //in send_buffer
+	for (auto const &s : shared) {
+		if (count == max) break;
+		add(send_buffer.data() + at, s.before);
+		at += s.before;
+		add(s.bytes->data() + s.sent, s.bytes->size() - s.sent);
 	}
+	add(send_buffer.data() + at, send_buffer.size() - at);
+	return count;
+}
 
-	{ //wait (until timeout) for sockets' data to become available:
-		struct timeval tv;
-		tv.tv_sec = std::lround(std::floor(timeout));
-		tv.tv_usec = std::lround((timeout - std::floor(timeout)) * 1e6);
-		//NOTE: on windows nfds is ignored -- https://msdn.microsoft.com/en-us/library/windows/desktop/ms740141(v=vs.85).aspx
-		int ret = select(max + 1, &read_fds, &write_fds, NULL, &tv);
+void Connection::output_sent(size_t count) {
+	while (count > 0 && !shared.empty()) {
+		Shared &s = shared.front();
+		size_t owned = std::min(count, s.before);
+		send_buffer.consume(owned);
+		s.before -= owned;
+		shared_before -= owned;
+		count -= owned;
 
-		if (ret < 0) {
-			std::cerr << "[" << where << "] Select returned an error; will attempt to read/write anyway." << std::endl;
-		} else if (ret == 0) {
-			//nothing to read or write.
-			return;
-		}
+		size_t part = std::min(count, s.bytes->size() - s.sent);
+		s.sent += part;
+		count -= part;
+
+		if (s.before > 0 || s.sent < s.bytes->size()) break; //(so count is used up)
+		shared.pop_front();
 	}
+	assert(count <= send_buffer.size() - shared_before);
+	send_buffer.consume(count);
+}
 
-	//add new connections as needed:
-	if (listen_socket != InvalidSocket && FD_ISSET(listen_socket, &read_fds)) {
-		Socket got = accept(listen_socket, NULL, NULL);
-		if (got == InvalidSocket) {
-			//oh well.
-		} else {
-			#ifdef _WIN32
-			unsigned long one = 1;
-			if (0 == ioctlsocket(got, FIONBIO, &one)) {
-			#else
-			{
-			#endif
-				connections.emplace_back();
-				connections.back().socket = got;
-				std::cerr << "[" << where << "] client connected on " << connections.back().socket << "." << std::endl; //INFO
-				if (on_event) on_event(&connections.back(), Connection::OnOpen);
-			}
-		}
+void Connection::swap_output(Connection &other) {
+	std::swap(send_buffer, other.send_buffer);
+	std::swap(shared, other.shared);
+	std::swap(shared_before, other.shared_before);
+}
+
+//---------------------------------
+//Helpers used by both polling backends:
+
+//accept one pending connection on 'listen_socket' and add it to 'connections' (returns nullptr if none could be accepted):
+static Connection *accept_connection(char const *where, std::list< Connection > &connections, Socket listen_socket) {
+	Socket got = accept(listen_socket, NULL, NULL);
+	if (got == InvalidSocket) {
+		//oh well.
+		return nullptr;
+	}
+	#ifdef _WIN32
+	unsigned long one = 1;
+	if (0 != ioctlsocket(got, FIONBIO, &one)) {
+		closesocket(got);
+		return nullptr;
 	}
+	#endif
+	connections.emplace_back();
+	connections.back().socket = got;
+	std::cerr << "[" << where << "] client connected on " << connections.back().socket << "." << std::endl; //INFO
+	return &connections.back();
+}
 
+//read everything waiting on 'c' (closing it if the other end hung up or something went wrong):
+static void recv_connection(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event) {
 	const uint32_t BufferSize = 20000;
 	static thread_local char *buffer = new char[BufferSize];
 
-	//process requests:
-	for (auto &c : connections) {
-		//only read from valid sockets marked readable:
-		if (c.socket == InvalidSocket || !FD_ISSET(c.socket, &read_fds)) continue;
-
-		while (true) { //read until more data left to read
-			ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
-			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-				//~no problem~ but no data
-				break;
-			} else if (ret <= 0 || ret > (ssize_t)BufferSize) {
-				//~problem~ so remove connection
-				if (ret == 0) {
-					std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
-				} else if (ret < 0) {
-					std::cerr << "[" << where << "] recv() returned error " << errno << "(" << strerror(errno) << "), disconnecting." << std::endl;
-				} else {
-					std::cerr << "[" << where << "] recv() returned strange number of bytes, disconnecting." << std::endl;
-				}
-				c.close();
-				if (on_event) on_event(&c, Connection::OnClose);
-				break;
-			} else { //ret > 0
-				c.recv_buffer.insert(c.recv_buffer.end(), buffer, buffer + ret);
-				if (on_event) on_event(&c, Connection::OnRecv);
-				if (ret < BufferSize) break; //ran out of data before buffer: no more data left to read
+	while (true) { //read until more data left to read
+		ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			//~no problem~ but no data
+			break;
+		} else if (ret <= 0 || ret > (ssize_t)BufferSize) {
+			//~problem~ so remove connection
+			if (ret == 0) {
+				std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
+			} else if (ret < 0) {
+				std::cerr << "[" << where << "] recv() returned error " << errno << "(" << strerror(errno) << "), disconnecting." << std::endl;
+			} else {
+				std::cerr << "[" << where << "] recv() returned strange number of bytes, disconnecting." << std::endl;
 			}
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+			break;
+		} else { //ret > 0
+			c.recv_buffer.append(buffer, size_t(ret));
+			if (on_event) on_event(&c, Connection::OnRecv);
+			//(a short read means the socket is drained; anything that arrives later is a new event)
+			if (ret < BufferSize) break; //ran out of data before buffer: no more data left to read
 		}
 	}
+}
 
-	//process responses:
-	for (auto &c : connections) {
-		//don't bother with connections unless they are valid, have something to send, and are marked writable:
-		if (c.socket == InvalidSocket || c.send_buffer.empty() || !FD_ISSET(c.socket, &write_fds)) continue;
-		
+//most pieces of output handed to the kernel in one call:
+static constexpr uint32_t MaxSendPieces = 64;
+
+//send as much of 'c's queued output (send_buffer and shared buffers) as the socket will take, in as few
+// calls as possible and without copying any of it (closing it if something went wrong);
+// clears c.writable if the socket filled up before the output was all sent:
+static void send_connection(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	Connection::Piece pieces[MaxSendPieces];
+	while (c.socket != InvalidSocket && c.send_pending()) {
+		uint32_t count = c.gather_output(pieces, MaxSendPieces);
+		size_t total = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			total += pieces[i].size;
+		}
 		#ifdef _WIN32
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), int(c.send_buffer.size()), MSG_DONTWAIT);
+		WSABUF buffers[MaxSendPieces];
+		for (uint32_t i = 0; i < count; ++i) {
+			buffers[i].buf = reinterpret_cast< CHAR * >(const_cast< uint8_t * >(pieces[i].data));
+			buffers[i].len = ULONG(pieces[i].size);
+		}
+		DWORD sent = 0;
+		ssize_t ret = (WSASend(c.socket, buffers, DWORD(count), &sent, 0, NULL, NULL) == 0 ? ssize_t(sent) : -1);
+		if (ret < 0 && WSAGetLastError() == WSAEWOULDBLOCK) errno = EWOULDBLOCK;
 		#else
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), c.send_buffer.size(), MSG_DONTWAIT);
-		#endif 
+		struct iovec iov[MaxSendPieces];
+		for (uint32_t i = 0; i < count; ++i) {
+			iov[i].iov_base = const_cast< uint8_t * >(pieces[i].data);
+			iov[i].iov_len = pieces[i].size;
+		}
+		struct msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = iov;
+		message.msg_iovlen = count;
+		//(MSG_NOSIGNAL: a peer that already hung up is an EPIPE to close on below, not a SIGPIPE that kills the server)
+		ssize_t ret = sendmsg(c.socket, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+		#endif
 		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
 			//~no problem~, but don't keep trying
+			c.writable = false;
 			break;
-		} else if (ret <= 0 || ret > (ssize_t)c.send_buffer.size()) {
+		} else if (ret <= 0 || ret > (ssize_t)total) {
 			if (ret < 0) {
 				std::cerr << "[" << where << "] send() returned error " << errno << ", disconnecting." << std::endl;
-			} else { assert(ret == 0 || ret > (ssize_t)c.send_buffer.size());
-				std::cerr << "[" << where << "] send() returned strange number of bytes [" << ret << " of " << c.send_buffer.size() << "], disconnecting." << std::endl;
+			} else { assert(ret == 0 || ret > (ssize_t)total);
+				std::cerr << "[" << where << "] send() returned strange number of bytes [" << ret << " of " << total << "], disconnecting." << std::endl;
 			}
 			c.close();
 			if (on_event) on_event(&c, Connection::OnClose);
 		} else { //ret seems reasonable
-			c.send_buffer.erase(c.send_buffer.begin(), c.send_buffer.begin() + ret);
+			c.output_sent(size_t(ret));
 		}
 	}
+}
+
+//---------------------------------
+//select() backend (portable):
+
+struct SelectPoller : Poller {
+	void poll(
+		char const *where,
+		std::list< Connection > &connections,
+		std::function< void(Connection *, Connection::Event event) > const &on_event,
+		double timeout,
+		Socket listen_socket) override {
+
+		fd_set read_fds, write_fds;
+		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
+
+		int max = 0;
+
+		//add listen_socket to fd_set if needed:
+		if (listen_socket != InvalidSocket) {
+			max = std::max(max, int(listen_socket));
+			FD_SET(listen_socket, &read_fds);
+		}
+
+		//add each connection's socket to read (and possibly write) sets:
+		for (auto &c : connections) {
+			if (c.socket != InvalidSocket) {
+				#ifndef _WIN32
+				//(an fd_set is a bitmask FD_SETSIZE long, so larger descriptors can't be watched at all)
+				if (int(c.socket) >= FD_SETSIZE) {
+					std::cerr << "[" << where << "] socket " << c.socket << " is past select()'s limit of " << FD_SETSIZE << ", disconnecting (the epoll backend has no limit)." << std::endl;
+					c.close();
+					if (on_event) on_event(&c, Connection::OnClose);
+					continue;
+				}
+				#endif
+				max = std::max(max, int(c.socket));
+				FD_SET(c.socket, &read_fds);
+				if (c.send_pending()) {
+					FD_SET(c.socket, &write_fds);
+				}
+			}
+		}
+
+		{ //wait (until timeout) for sockets' data to become available:
+			struct timeval tv;
+			tv.tv_sec = std::lround(std::floor(timeout));
+			tv.tv_usec = std::lround((timeout - std::floor(timeout)) * 1e6);
+			//NOTE: on windows nfds is ignored -- https://msdn.microsoft.com/en-us/library/windows/desktop/ms740141(v=vs.85).aspx
+			int ret = select(max + 1, &read_fds, &write_fds, NULL, &tv);
+
+			if (ret < 0) {
+				std::cerr << "[" << where << "] Select returned an error; will attempt to read/write anyway." << std::endl;
+			} else if (ret == 0) {
+				//nothing to read or write.
+				return;
+			}
+		}
+
+		//add new connections as needed:
+		if (listen_socket != InvalidSocket && FD_ISSET(listen_socket, &read_fds)) {
+			if (Connection *c = accept_connection(where, connections, listen_socket)) {
+				if (on_event) on_event(c, Connection::OnOpen);
+			}
+		}
+
+		//process requests:
+		for (auto &c : connections) {
+			//only read from valid sockets marked readable:
+			if (c.socket == InvalidSocket || !FD_ISSET(c.socket, &read_fds)) continue;
+			recv_connection(where, c, on_event);
+		}
+
+		//process responses:
+		for (auto &c : connections) {
+			//don't bother with connections unless they are valid, have something to send, and are marked writable:
+			if (c.socket == InvalidSocket || !c.send_pending() || !FD_ISSET(c.socket, &write_fds)) continue;
+			send_connection(where, c, on_event);
+		}
+	}
+};
+
+//---------------------------------
+//epoll backend (Linux):
+
+#ifdef __linux__
+struct EpollPoller : Poller {
+	EpollPoller() {
+		epoll = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create epoll instance");
+		}
+	}
+	virtual ~EpollPoller() {
+		::close(epoll);
+	}
+
+	int epoll = -1;
+	Socket listening = InvalidSocket; //listen socket already being watched
+	std::vector< struct epoll_event > events = std::vector< struct epoll_event >(256);
+
+	//connections are watched edge-triggered: an event means "something new arrived" or "there is room to
+	// send again", so reads go until the socket is drained and sends go until it fills up.
+	//(closing a socket takes it out of the interest list, so there is nothing to remove)
+	void add(Connection &c) override {
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		event.data.ptr = &c;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, c.socket, &event) != 0) {
+			throw std::system_error(errno, std::system_category(), "failed to watch socket " + std::to_string(c.socket));
+		}
+		c.writable = true;
+	}
+
+	void poll(
+		char const *where,
+		std::list< Connection > &connections,
+		std::function< void(Connection *, Connection::Event event) > const &on_event,
+		double timeout,
+		Socket listen_socket) override {
+
+		if (listen_socket != listening) {
+			//the listen socket is level-triggered (and non-blocking, so accept() can be called until it runs dry):
+			fcntl(listen_socket, F_SETFL, fcntl(listen_socket, F_GETFL, 0) | O_NONBLOCK);
+			struct epoll_event event;
+			event.events = EPOLLIN;
+			event.data.ptr = nullptr;
+			if (epoll_ctl(epoll, EPOLL_CTL_ADD, listen_socket, &event) != 0) {
+				throw std::system_error(errno, std::system_category(), "failed to watch listen socket");
+			}
+			listening = listen_socket;
+		}
+
+		//send whatever was queued since the last poll (a socket only says it's writable again after filling up):
+		for (auto &c : connections) {
+			if (c.socket == InvalidSocket || !c.send_pending() || !c.writable) continue;
+			send_connection(where, c, on_event);
+		}
+
+		//wait (until timeout) for sockets' data to become available:
+		// (rounding up, so a sub-millisecond timeout still waits rather than spinning)
+		int count = epoll_wait(epoll, events.data(), int(events.size()), int(std::ceil(timeout * 1000.0)));
+		if (count < 0) {
+			if (errno != EINTR) std::cerr << "[" << where << "] epoll_wait() returned error " << errno << "(" << strerror(errno) << ")." << std::endl;
+			return;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			struct epoll_event const &event = events[i];
+
+			//add new connections as needed:
+			if (event.data.ptr == nullptr) {
+				while (Connection *c = accept_connection(where, connections, listen_socket)) {
+					try {
+						add(*c);
+					} catch (std::system_error const &e) {
+						std::cerr << "[" << where << "] " << e.what() << ", disconnecting." << std::endl;
+						c->close();
+						continue;
+					}
+					if (on_event) on_event(c, Connection::OnOpen);
+				}
+				continue;
+			}
+
+			//(a connection closed earlier in this batch is still in the list, just invalid, until the owner reaps it)
+			Connection &c = *reinterpret_cast< Connection * >(event.data.ptr);
+			if (c.socket == InvalidSocket) continue;
+
+			if (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+				recv_connection(where, c, on_event);
+			}
+			if (c.socket != InvalidSocket && (event.events & EPOLLOUT)) {
+				c.writable = true;
+				send_connection(where, c, on_event);
+			}
+		}
+
+		//a full batch might mean more were waiting; take more next time:
+		if (size_t(count) == events.size()) events.resize(events.size() * 2);
+	}
+};
+#endif
+
+//---------------------------------
+//io_uring backend (Linux 6.0 or later), driven through the raw system calls (see io_uring(7)):
 
-		
+#ifdef POLLER_IO_URING
+struct IoUringPoller : Poller {
+	IoUringPoller() {
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		//(a broadcast completes a send for every connection, which can be far more than the submission queue holds)
+		params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+		params.cq_entries = 8 * QueueSize;
+		ring = int(syscall(__NR_io_uring_setup, QueueSize, &params));
+		if (ring < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to set up io_uring");
+		}
+		try {
+			if (!(params.features & IORING_FEAT_EXT_ARG)) {
+				throw std::runtime_error("io_uring doesn't support waiting with a timeout (needs Linux 5.11 or later)");
+			}
+			map_rings(params);
+			register_buffers();
+		} catch (...) {
+			release();
+			throw;
+		}
+	}
+	virtual ~IoUringPoller() {
+		//(closing the ring cancels everything in flight)
+		watches.for_each([](SlotHandle, Watch &watch) {
+			if (watch.connection) watch.connection->poller = nullptr;
+		});
+		release();
+	}
+
+	inline static constexpr uint32_t QueueSize = 4096; //submission queue entries (the completion queue gets 8x as many)
+	inline static constexpr uint32_t BufferCount = 4096; //receive buffers shared by every connection (a power of two)
+	inline static constexpr uint32_t BufferSize = 2048; //bytes per receive buffer
+	inline static constexpr uint16_t BufferGroup = 0;
+
+	int ring = -1;
+
+	//submission queue (entries are used in order, so the ring's index array is just 0, 1, 2, ...):
+	void *sq_map = MAP_FAILED;
+	size_t sq_map_size = 0;
+	struct io_uring_sqe *sqes = reinterpret_cast< struct io_uring_sqe * >(MAP_FAILED);
+	size_t sqes_size = 0;
+	unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_flags = nullptr;
+	unsigned sq_mask = 0, sq_entries = 0;
+	unsigned sq_next = 0; //tail counting entries filled in but not yet handed to the kernel
+
+	//completion queue (in the same mapping as the submission queue on most kernels):
+	void *cq_map = MAP_FAILED;
+	size_t cq_map_size = 0;
+	unsigned *cq_head = nullptr, *cq_tail = nullptr;
+	unsigned cq_mask = 0;
+	struct io_uring_cqe *cqes = nullptr;
+
+	//provided receive buffers: the kernel takes one from the ring for each receive it completes,
+	// and it goes back on the ring once its data has been copied to the connection's recv_buffer:
+	struct io_uring_buf_ring *buffer_ring = reinterpret_cast< struct io_uring_buf_ring * >(MAP_FAILED);
+	size_t buffer_ring_size = 0;
+	std::vector< uint8_t > buffer_data;
+	uint16_t buffer_tail = 0;
+
+	//per-connection state; it outlives its connection until the operations it started have finished:
+	struct Watch {
+		Connection *connection = nullptr; //nullptr once the connection has closed
+		//(socket-less) the output in flight, taken from the connection so that appends can't move it:
+		Connection sending;
+		//what a send hands the kernel (heap-allocated, so it stays put if the watch moves):
+		std::vector< struct iovec > iov;
+		std::unique_ptr< struct msghdr > message = std::make_unique< struct msghdr >();
+		bool receiving = false; //a multishot receive is armed
+		bool send_busy = false;
+	};
+	SlotMap< Watch > watches;
+	std::vector< SlotHandle > rearm; //watches whose receive ended (e.g., the buffers ran out) and needs arming again
+
+	Socket listening = InvalidSocket;
+	bool accepting = false; //a multishot accept is armed on 'listening'
+
+	//each operation's user_data says which watch it's for and what it was:
+	enum Op : uint64_t { Recv = 0, Send = 1, Accept = 2, Cancel = 3 };
+	static uint64_t user_data(SlotHandle handle, Op op) {
+		assert(handle.index < (1u << 30));
+		return (uint64_t(handle.index) << 34) | (uint64_t(handle.generation) << 2) | op;
+	}
+
+	void map_rings(struct io_uring_params const &params) {
+		sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		bool single = (params.features & IORING_FEAT_SINGLE_MMAP);
+		if (single) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+		sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+		if (sq_map == MAP_FAILED) {
+			throw std::system_error(errno, std::system_category(), "failed to map io_uring submission queue");
+		}
+		if (single) {
+			cq_map = sq_map;
+		} else {
+			cq_map = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+			if (cq_map == MAP_FAILED) {
+				throw std::system_error(errno, std::system_category(), "failed to map io_uring completion queue");
+			}
+		}
+		sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+		sqes = reinterpret_cast< struct io_uring_sqe * >(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES));
+		if (sqes == MAP_FAILED) {
+			throw std::system_error(errno, std::system_category(), "failed to map io_uring submission entries");
+		}
+
+		char *sq = reinterpret_cast< char * >(sq_map);
+		sq_head = reinterpret_cast< unsigned * >(sq + params.sq_off.head);
+		sq_tail = reinterpret_cast< unsigned * >(sq + params.sq_off.tail);
+		sq_flags = reinterpret_cast< unsigned * >(sq + params.sq_off.flags);
+		sq_mask = *reinterpret_cast< unsigned * >(sq + params.sq_off.ring_mask);
+		sq_entries = *reinterpret_cast< unsigned * >(sq + params.sq_off.ring_entries);
+		unsigned *array = reinterpret_cast< unsigned * >(sq + params.sq_off.array);
+		for (unsigned i = 0; i < sq_entries; ++i) {
+			array[i] = i;
+		}
+		sq_next = *sq_tail;
+
+		char *cq = reinterpret_cast< char * >(cq_map);
+		cq_head = reinterpret_cast< unsigned * >(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast< unsigned * >(cq + params.cq_off.tail);
+		cq_mask = *reinterpret_cast< unsigned * >(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast< struct io_uring_cqe * >(cq + params.cq_off.cqes);
+	}
+
+	void register_buffers() {
+		//(the buffer ring has to be page-aligned, hence mmap)
+		buffer_ring_size = BufferCount * sizeof(struct io_uring_buf);
+		buffer_ring = reinterpret_cast< struct io_uring_buf_ring * >(mmap(nullptr, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (buffer_ring == MAP_FAILED) {
+			throw std::system_error(errno, std::system_category(), "failed to allocate io_uring buffer ring");
+		}
+		buffer_data.resize(size_t(BufferCount) * BufferSize);
+
+		struct io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.ring_addr = uint64_t(reinterpret_cast< uintptr_t >(buffer_ring));
+		reg.ring_entries = BufferCount;
+		reg.bgid = BufferGroup;
+		if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+			throw std::system_error(errno, std::system_category(), "failed to register io_uring receive buffers (needs Linux 5.19 or later)");
+		}
+		for (uint32_t b = 0; b < BufferCount; ++b) {
+			recycle(uint16_t(b));
+		}
+		publish_buffers();
+	}
+
+	void release() {
+		if (buffer_ring != MAP_FAILED) munmap(buffer_ring, buffer_ring_size);
+		if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+		if (cq_map != MAP_FAILED && cq_map != sq_map) munmap(cq_map, cq_map_size);
+		if (sq_map != MAP_FAILED) munmap(sq_map, sq_map_size);
+		if (ring >= 0) ::close(ring);
+	}
+
+	//put buffer 'bid' back on the ring (the kernel sees it after the next publish_buffers()):
+	void recycle(uint16_t bid) {
+		//(not buffer_ring->bufs, which the kernel header declares in a way C++ compilers lay out one entry too far along)
+		struct io_uring_buf &buf = reinterpret_cast< struct io_uring_buf * >(buffer_ring)[buffer_tail & (BufferCount - 1)];
+		buf.addr = uint64_t(reinterpret_cast< uintptr_t >(buffer_data.data() + size_t(bid) * BufferSize));
+		buf.len = BufferSize;
+		buf.bid = bid;
+		buffer_tail += 1;
+	}
+	void publish_buffers() {
+		__atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+	}
+
+	//a cleared submission entry to fill in (handing the queue to the kernel first if it's full):
+	struct io_uring_sqe *next_sqe() {
+		if (sq_next - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries) {
+			enter("IoUringPoller", false, 0.0);
+			if (sq_next - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == sq_entries) {
+				throw std::runtime_error("io_uring submission queue is stuck full");
+			}
+		}
+		struct io_uring_sqe *sqe = &sqes[sq_next & sq_mask];
+		memset(sqe, 0, sizeof(*sqe));
+		sq_next += 1;
+		return sqe;
+	}
+
+	//hand over everything queued and, with 'wait', wait up to 'timeout' seconds for something to complete:
+	void enter(char const *where, bool wait, double timeout) {
+		__atomic_store_n(sq_tail, sq_next, __ATOMIC_RELEASE);
+		unsigned to_submit = sq_next - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+		if (to_submit == 0 && !wait) return;
+
+		struct __kernel_timespec ts;
+		ts.tv_sec = std::lround(std::floor(timeout));
+		ts.tv_nsec = std::lround((timeout - std::floor(timeout)) * 1e9);
+		struct io_uring_getevents_arg arg;
+		memset(&arg, 0, sizeof(arg));
+		arg.ts = uint64_t(reinterpret_cast< uintptr_t >(&ts));
+
+		long ret;
+		if (wait) ret = syscall(__NR_io_uring_enter, ring, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+		else ret = syscall(__NR_io_uring_enter, ring, to_submit, 0, 0, nullptr, 0);
+		if (ret < 0 && errno != ETIME && errno != EINTR) {
+			std::cerr << "[" << where << "] io_uring_enter() returned error " << errno << "(" << strerror(errno) << ")." << std::endl;
+		}
+	}
+
+	void queue_accept() {
+		struct io_uring_sqe *sqe = next_sqe();
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->fd = listening;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->user_data = user_data(SlotHandle(), Accept);
+		accepting = true;
+	}
+	void queue_recv(SlotHandle handle, Watch &watch) {
+		struct io_uring_sqe *sqe = next_sqe();
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = watch.connection->socket;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = BufferGroup;
+		sqe->user_data = user_data(handle, Recv);
+		watch.receiving = true;
+	}
+	void queue_send(SlotHandle handle, Watch &watch) {
+		assert(watch.sending.send_pending());
+		Connection::Piece pieces[MaxSendPieces];
+		uint32_t count = watch.sending.gather_output(pieces, MaxSendPieces);
+		watch.iov.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			watch.iov[i].iov_base = const_cast< uint8_t * >(pieces[i].data);
+			watch.iov[i].iov_len = pieces[i].size;
+		}
+		memset(watch.message.get(), 0, sizeof(struct msghdr));
+		watch.message->msg_iov = watch.iov.data();
+		watch.message->msg_iovlen = count;
+
+		struct io_uring_sqe *sqe = next_sqe();
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = watch.connection->socket;
+		sqe->addr = uint64_t(reinterpret_cast< uintptr_t >(watch.message.get()));
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = user_data(handle, Send);
+		watch.send_busy = true;
+	}
+	void queue_cancel(SlotHandle handle, Op op) {
+		struct io_uring_sqe *sqe = next_sqe();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = user_data(handle, op);
+		sqe->user_data = user_data(handle, Cancel);
+	}
+
+	//send everything queued on c (unless a send is still in flight; that one picks it up when it finishes):
+	void start_send(Connection &c) {
+		SlotHandle handle = SlotHandle::from_bits(c.poll_data);
+		Watch *watch = watches.get(handle);
+		if (!watch || watch->send_busy || !c.send_pending()) return;
+		//(the connection gets the idle buffers back, so the two trade places without allocating)
+		assert(!watch->sending.send_pending());
+		c.swap_output(watch->sending);
+		queue_send(handle, *watch);
+	}
+
+	void add(Connection &c) override {
+		SlotHandle handle = watches.emplace();
+		Watch &watch = *watches.get(handle);
+		watch.connection = &c;
+		c.poller = this;
+		c.poll_data = handle.bits();
+		queue_recv(handle, watch);
+	}
+
+	void closing(Connection &c) override {
+		SlotHandle handle = SlotHandle::from_bits(c.poll_data);
+		c.poller = nullptr;
+		Watch *watch = watches.get(handle);
+		if (!watch) return;
+		watch->connection = nullptr;
+		//(the kernel holds its own reference to the socket, so closing it doesn't stop what's in flight)
+		if (watch->receiving) queue_cancel(handle, Recv);
+		if (watch->send_busy) queue_cancel(handle, Send);
+		if (!watch->receiving && !watch->send_busy) watches.erase(handle);
+	}
+
+	void poll(
+		char const *where,
+		std::list< Connection > &connections,
+		std::function< void(Connection *, Connection::Event event) > const &on_event,
+		double timeout,
+		Socket listen_socket) override {
+
+		if (listen_socket != InvalidSocket && (listen_socket != listening || !accepting)) {
+			listening = listen_socket;
+			queue_accept();
+		}
+
+		//queue whatever was added to send since the last poll:
+		for (auto &c : connections) {
+			if (c.poller == this && c.send_pending()) start_send(c);
+		}
+
+		//submit it all and wait (until timeout) for something to complete, in one call:
+		enter(where, timeout > 0.0, timeout);
+
+		//handle everything that completed:
+		// (anything queued along the way -- receives to re-arm, the rest of a partial send -- is submitted by the next poll)
+		bool flushed = false;
+		while (true) {
+			unsigned head = *cq_head;
+			if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+				//completions that didn't fit in the queue wait in the kernel until asked for:
+				if (flushed || !(__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)) break;
+				syscall(__NR_io_uring_enter, ring, 0, 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+				flushed = true;
+				continue;
+			}
+			struct io_uring_cqe cqe = cqes[head & cq_mask];
+			__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+			complete(where, connections, on_event, cqe);
+		}
+
+		publish_buffers();
+		for (SlotHandle handle : rearm) {
+			Watch *watch = watches.get(handle);
+			if (watch && watch->connection && !watch->receiving) queue_recv(handle, *watch);
+		}
+		rearm.clear();
+	}
+
+	void complete(
+		char const *where,
+		std::list< Connection > &connections,
+		std::function< void(Connection *, Connection::Event event) > const &on_event,
+		struct io_uring_cqe const &cqe) {
+
+		Op op = Op(cqe.user_data & 3);
+		SlotHandle handle{uint32_t(cqe.user_data >> 34), uint32_t(cqe.user_data >> 2)};
+		bool more = (cqe.flags & IORING_CQE_F_MORE);
+
+		if (op == Cancel) return;
+
+		//add new connections as needed:
+		if (op == Accept) {
+			if (!more) accepting = false; //(armed again by the next poll)
+			if (cqe.res < 0) {
+				if (cqe.res != -ECANCELED) std::cerr << "[" << where << "] accept failed with error " << -cqe.res << "(" << strerror(-cqe.res) << ")." << std::endl;
+				return;
+			}
+			connections.emplace_back();
+			Connection &c = connections.back();
+			c.socket = cqe.res;
+			std::cerr << "[" << where << "] client connected on " << c.socket << "." << std::endl; //INFO
+			add(c);
+			if (on_event) on_event(&c, Connection::OnOpen);
+			return;
+		}
+
+		Watch *watch = watches.get(handle);
+		assert(watch && "watches outlive their operations");
+		Connection *c = watch->connection;
+
+		auto disconnect = [&]() {
+			c->close();
+			if (on_event) on_event(c, Connection::OnClose);
+		};
+
+		if (op == Recv) {
+			if (!more) watch->receiving = false;
+			if (cqe.flags & IORING_CQE_F_BUFFER) {
+				uint16_t bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+				if (c && cqe.res > 0) {
+					uint8_t const *data = buffer_data.data() + size_t(bid) * BufferSize;
+					c->recv_buffer.append(data, size_t(cqe.res));
+				}
+				recycle(bid);
+			}
+			if (c) {
+				if (cqe.res > 0) {
+					if (on_event) on_event(c, Connection::OnRecv);
+				} else if (cqe.res == -ENOBUFS) {
+					//every buffer was holding data not yet copied out; armed again once they've been recycled
+				} else {
+					if (cqe.res == 0) {
+						std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
+					} else {
+						std::cerr << "[" << where << "] recv failed with error " << -cqe.res << "(" << strerror(-cqe.res) << "), disconnecting." << std::endl;
+					}
+					disconnect();
+				}
+			}
+		} else { assert(op == Send);
+			watch->send_busy = false;
+			if (c) {
+				if (cqe.res <= 0) {
+					std::cerr << "[" << where << "] send failed with error " << -cqe.res << "(" << strerror(-cqe.res) << "), disconnecting." << std::endl;
+					disconnect();
+				} else {
+					watch->sending.output_sent(size_t(cqe.res));
+					if (watch->sending.send_pending()) {
+						queue_send(handle, *watch); //the rest
+					} else {
+						start_send(*c); //anything queued while this was in flight
+					}
+				}
+			}
+		}
+
+		//(callbacks may have closed the connection, which may have erased the watch)
+		watch = watches.get(handle);
+		if (!watch) return;
+		if (watch->connection) {
+			if (!watch->receiving) rearm.emplace_back(handle);
+		} else if (!watch->receiving && !watch->send_busy) {
+			watches.erase(handle);
+		}
+	}
+};
+#endif
+
+std::unique_ptr< Poller > Poller::make(Backend backend) {
+	if (backend == Select) return std::make_unique< SelectPoller >();
+	#ifdef __linux__
+	if (backend == Epoll) return std::make_unique< EpollPoller >();
+	#endif
+	#ifdef POLLER_IO_URING
+	if (backend == IoUring) return std::make_unique< IoUringPoller >();
+	#endif
+	throw std::runtime_error(std::string("Polling backend '") + name(backend) + "' isn't available on this platform.");
+}
+
+char const *Poller::name(Backend backend) {
+	if (backend == Select) return "select";
+	if (backend == Epoll) return "epoll";
+	if (backend == IoUring) return "io_uring";
+	return "unknown";
 }
 
 //---------------------------------
 
 
-Server::Server(std::string const &port) {
+Server::Server(std::string const &port, Poller::Backend backend) : poller(Poller::make(backend)) {
 
 	#ifdef _WIN32
 	{ //init winsock:
@@ -266,7 +943,7 @@ Server::Server(std::string const &port) {
 	}
 
 	{ //listen on socket
-		int ret = ::listen(listen_socket, 5);
+		int ret = ::listen(listen_socket, SOMAXCONN); //(a deep backlog, so a crowd connecting at once isn't turned away)
 		if (ret < 0) {
 			closesocket(listen_socket);
 			throw std::system_error(errno, std::system_category(), "failed to listen on socket");
@@ -275,7 +952,7 @@ Server::Server(std::string const &port) {
 }
 
 void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	poller->poll("Server::poll", connections, on_event, timeout, listen_socket);
 
 	//reap closed clients:
 	for (auto connection = connections.begin(); connection != connections.end(); /*later*/) {
@@ -287,7 +964,7 @@ void Server::poll(std::function< void(Connection *, Connection::Event event) > c
 	}
 }
 
-Client::Client(std::string const &host, std::string const &port) : connections(1), connection(connections.front()) {
+Client::Client(std::string const &host, std::string const &port, Poller::Backend backend) : connections(1), connection(connections.front()), poller(Poller::make(backend)) {
 	#ifdef _WIN32
 	{ //init winsock:
 		WSADATA info;
@@ -352,10 +1029,12 @@ Client::Client(std::string const &host, std::string const &port) : connections(1
 			throw std::runtime_error("Failed to connect to any of the addresses tried for server.");
 		}
 	}
+
+	poller->add(connection);
 }
 
 
 void Client::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Client::poll", connections, on_event, timeout, InvalidSocket);
+	poller->poll("Client::poll", connections, on_event, timeout, InvalidSocket);
 }
 
@@ -14,7 +14,7 @@ int main(int argc, char **argv) {
 		server.poll([](Connection *connection, Connection::Event evt){
 			if (evt == Connection::OnRecv) {
 				//extract and erase data from the connection's recv_buffer:
-				std::vector< uint8_t > data = connection->recv_buffer;
+				std::vector< uint8_t > data(connection->recv_buffer.data(), connection->recv_buffer.data() + connection->recv_buffer.size());
 				connection->recv_buffer.clear();
 				//send to other connections:
 
@@ -60,10 +60,17 @@ int main(int argc, char **argv) {
 #endif
 //--------- ---------------------------------- ---------
 
+#include "ByteQueue.hpp"
+
+#include <deque>
 #include <vector>
 #include <list>
 #include <string>
 #include <functional>
+#include <memory>
+#include <cstdint>
+
+struct Poller;
 
 //Thin wrapper around a (polling-based) TCP socket connection:
 struct Connection {
@@ -74,8 +81,14 @@ struct Connection {
 	}
 	//Helper that will append raw bytes to the send buffer:
 	void send_raw(void const *data, size_t size) {
-		send_buffer.insert(send_buffer.end(), reinterpret_cast< uint8_t const * >(data), reinterpret_cast< uint8_t const * >(data) + size);
+		send_buffer.append(data, size);
 	}
+	//Queue a buffer that's shared with other connections (e.g., a broadcast) without copying it;
+	// it goes out after everything already in send_buffer, and is read from until it has been sent:
+	void send_shared(std::shared_ptr< std::vector< uint8_t > const > const &bytes);
+
+	//true if anything (in send_buffer, or shared) is waiting to go out:
+	bool send_pending() const { return !send_buffer.empty() || !shared.empty(); }
 
 	//Call 'close' to mark a connection for discard:
 	void close();
@@ -84,12 +97,39 @@ struct Connection {
 	explicit operator bool() { return socket != InvalidSocket; }
 
 	//To send data over a connection, append it to send_buffer:
-	std::vector< uint8_t > send_buffer;
-	//When the connection receives data, it is appended to recv_buffer:
-	std::vector< uint8_t > recv_buffer;
+	// (the pollers consume it as it's sent; nothing else should)
+	ByteQueue send_buffer;
+	//When the connection receives data, it is appended to recv_buffer (consume() what you've handled):
+	ByteQueue recv_buffer;
+
+	//free for the owner's use (e.g., the server keeps each connection's client handle here):
+	uint64_t tag = 0;
 
 	//internals:
 	Socket socket = InvalidSocket;
+	bool writable = true; //(epoll) false once the socket's send buffer filled up, until it says it has room again
+	Poller *poller = nullptr; //(io_uring) told when the connection closes, so it can cancel operations in flight
+	uint64_t poll_data = 0; //(io_uring) the poller's handle for this connection
+
+	//buffers queued by send_shared, each going out after 'before' more bytes of send_buffer:
+	struct Shared {
+		std::shared_ptr< std::vector< uint8_t > const > bytes;
+		size_t before = 0; //bytes of send_buffer between the previous Shared (or the front) and this one
+		size_t sent = 0; //bytes of this one that have gone out already
+	};
+	std::deque< Shared > shared;
+	size_t shared_before = 0; //sum of the 'before's (so, where in send_buffer the last Shared goes)
+
+	//the queued output, in order, as up to 'max' pieces, without copying any of it (returns how many):
+	struct Piece {
+		uint8_t const *data;
+		size_t size;
+	};
+	uint32_t gather_output(Piece *pieces, uint32_t max) const;
+	//drop the first 'count' bytes of queued output, now that they've been sent:
+	void output_sent(size_t count);
+	//trade queued output (send_buffer and shared) with 'other':
+	void swap_output(Connection &other);
 
 	enum Event {
 		OnOpen,
@@ -98,8 +138,49 @@ struct Connection {
 	};
 };
 
+//Waits for socket activity and moves data for Server::poll and Client::poll:
+// 'Select' works everywhere, but rebuilds its descriptor sets on every call (so each poll costs
+//  O(connections) however few are active) and can't watch descriptors past FD_SETSIZE (1024 on Linux).
+// 'Epoll' (Linux only) keeps the watched sockets in the kernel and is edge-triggered, so each poll
+//  only touches the sockets that did something (plus a quick pass over connections with data to send).
+// 'IoUring' (Linux 6.0 or later, and not on by default) keeps a multishot receive armed on every
+//  connection (filling buffers from a shared provided-buffer ring) and queues every send, so a whole
+//  poll -- all of its sends, and the wait for whatever arrives -- is a single io_uring_enter() call.
+struct Poller {
+	enum Backend : uint8_t {
+		Select,
+		Epoll,
+		IoUring,
+		#ifdef __linux__
+		Default = Epoll,
+		#else
+		Default = Select,
+		#endif
+	};
+	static std::unique_ptr< Poller > make(Backend backend); //throws if 'backend' isn't available on this platform
+	static char const *name(Backend backend);
+
+	virtual ~Poller() = default;
+
+	//start watching a connection the owner opened itself (poll() watches the ones it accepts):
+	virtual void add(Connection &/*connection*/) { }
+	//called by Connection::close() (before the socket closes) on connections that set Connection::poller:
+	virtual void closing(Connection &/*connection*/) { }
+
+	//accept new connections on 'listen_socket' (if any), then receive from and send to 'connections',
+	// waiting up to 'timeout' seconds for something to happen ('where' labels log messages):
+	virtual void poll(
+		char const *where,
+		std::list< Connection > &connections,
+		std::function< void(Connection *, Connection::Event event) > const &on_event,
+		double timeout,
+		Socket listen_socket
+	) = 0;
+};
+
 struct Server {
-	Server(std::string const &port); //pass the port number to listen on, as a string (servname, really)
+	//pass the port number to listen on, as a string (servname, really):
+	Server(std::string const &port, Poller::Backend backend = Poller::Default);
 
 	//poll() updates the list of active connections and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -110,11 +191,12 @@ struct Server {
 
 	std::list< Connection > connections;
 	Socket listen_socket = InvalidSocket;
+	std::unique_ptr< Poller > poller;
 };
 
 
 struct Client {
-	Client(std::string const &host, std::string const &port);
+	Client(std::string const &host, std::string const &port, Poller::Backend backend = Poller::Default);
 
 	//poll() checks the status of the active connection and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -125,4 +207,5 @@ struct Client {
 
 	std::list< Connection > connections; //will only ever contain exactly one connection
 	Connection &connection; //reference to the only connection in the connections list
+	std::unique_ptr< Poller > poller;
 };
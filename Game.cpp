@@ -2,12 +2,13 @@
 
 #include "Connection.hpp"
 
+#include <array>
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
+#include <cmath>
 
 #include <glm/gtx/norm.hpp>
-#include <glm/gtx/rotate_vector.hpp>
 
 // #define DEBUG
 
@@ -21,7 +22,7 @@ void Player::Controls::send_controls_message(Connection *connection_) const {
 	assert(connection_);
 	auto &connection = *connection_;
 
-	uint32_t size = 5;
+	uint32_t size = 17;
 	connection.send(Message::C2S_Controls);
 	connection.send(uint8_t(size));
 	connection.send(uint8_t(size >> 8));
@@ -39,6 +40,13 @@ void Player::Controls::send_controls_message(Connection *connection_) const {
 	send_button(up);
 	send_button(down);
 	send_button(jump);
+
+	connection.send(uint8_t(seq));
+	connection.send(uint8_t(seq >> 8));
+	connection.send(uint8_t(seq >> 16));
+	connection.send(uint8_t(seq >> 24));
+
+	connection.send(view_time);
 }
 
 bool Player::Controls::recv_controls_message(Connection *connection_) {
@@ -53,7 +61,7 @@ bool Player::Controls::recv_controls_message(Connection *connection_) {
 	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
 	              | (uint32_t(recv_buffer[2]) << 8)
 	              |  uint32_t(recv_buffer[1]);
-	if (size != 5) throw std::runtime_error("Controls message with size " + std::to_string(size) + " != 5!");
+	if (size != 17) throw std::runtime_error("Controls message with size " + std::to_string(size) + " != 17!");
 
 	//expecting complete message:
 	if (recv_buffer.size() < 4 + size) return false;
@@ -74,8 +82,15 @@ bool Player::Controls::recv_controls_message(Connection *connection_) {
 	recv_button(recv_buffer[4+3], &down);
 	recv_button(recv_buffer[4+4], &jump);
 
+	seq = (uint32_t(recv_buffer[4+8]) << 24)
+	    | (uint32_t(recv_buffer[4+7]) << 16)
+	    | (uint32_t(recv_buffer[4+6]) << 8)
+	    |  uint32_t(recv_buffer[4+5]);
+
+	std::memcpy(&view_time, &recv_buffer[4+9], sizeof(view_time));
+
 	//delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+	recv_buffer.consume(4 + size);
 
 	return true;
 }
@@ -91,169 +106,578 @@ void Player::Controls::reset() {
 
 //-----------------------------------------
 
-Game::Game() {
+void GameConfig::validate() const {
+	auto check = [](bool ok, std::string const &what) {
+		if (!ok) throw std::runtime_error("Game config: " + what + ".");
+	};
+	check(puck_count >= 1 && puck_count <= Game::MaxPuckCount, "puck_count " + std::to_string(puck_count) + " is not in [1," + std::to_string(Game::MaxPuckCount) + "]");
+	check(fan_angle >= 0.0f && fan_angle <= 360.0f, "fan_angle " + std::to_string(fan_angle) + " is not in [0,360]");
+	check(puck_speed > 0.0f, "puck_speed " + std::to_string(puck_speed) + " is not positive");
+	check(puck_retain >= 0.0f && puck_retain <= 1.0f, "puck_retain " + std::to_string(puck_retain) + " is not in [0,1]");
+	check(player_accel_halflife > 0.0f, "player_accel_halflife " + std::to_string(player_accel_halflife) + " is not positive");
+	//(the goal mouth must fit a puck and leave the corners some wall)
+	check(goal_radius > Game::PuckRadius && goal_radius < Game::ArenaMax.x - Game::PuckRadius, "goal_radius " + std::to_string(goal_radius) + " is not in (" + std::to_string(Game::PuckRadius) + "," + std::to_string(Game::ArenaMax.x - Game::PuckRadius) + ")");
+}
+
+double GameConfig::get(std::string const &name) const {
+	if (name == "puck_count") return puck_count;
+	if (name == "fan_angle") return fan_angle;
+	if (name == "puck_speed") return puck_speed;
+	if (name == "puck_retain") return puck_retain;
+	if (name == "player_accel_halflife") return player_accel_halflife;
+	if (name == "goal_radius") return goal_radius;
+	throw std::runtime_error("Unknown game config field '" + name + "'.");
+}
+
+void GameConfig::set(std::string const &name, double value) {
+	if (name == "puck_count") {
+		//(checked here, since a value out of uint32_t's range -- or NaN -- can't even be cast for validate() to catch)
+		if (!(value >= 1.0 && value <= double(Game::MaxPuckCount))) {
+			throw std::runtime_error("Game config: puck_count " + std::to_string(value) + " is not in [1," + std::to_string(Game::MaxPuckCount) + "].");
+		}
+		puck_count = uint32_t(value);
+	}
+	else if (name == "fan_angle") fan_angle = float(value);
+	else if (name == "puck_speed") puck_speed = float(value);
+	else if (name == "puck_retain") puck_retain = float(value);
+	else if (name == "player_accel_halflife") player_accel_halflife = float(value);
+	else if (name == "goal_radius") goal_radius = float(value);
+	else throw std::runtime_error("Unknown game config field '" + name + "'.");
+}
+
+void GameConfig::send_config_message(Connection *connection_) const {
+	assert(connection_);
+	auto &connection = *connection_;
+
+	uint32_t size = 4 + 5 * 4;
+	connection.send(Message::S2C_Config);
+	connection.send(uint8_t(size));
+	connection.send(uint8_t(size >> 8));
+	connection.send(uint8_t(size >> 16));
+
+	connection.send(puck_count);
+	connection.send(fan_angle);
+	connection.send(puck_speed);
+	connection.send(puck_retain);
+	connection.send(player_accel_halflife);
+	connection.send(goal_radius);
+}
+
+bool GameConfig::recv_config_message(Connection *connection_) {
+	assert(connection_);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	if (recv_buffer.size() < 4) return false;
+	if (recv_buffer[0] != uint8_t(Message::S2C_Config)) return false;
+	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
+	              | (uint32_t(recv_buffer[2]) << 8)
+	              |  uint32_t(recv_buffer[1]);
+	if (size != 24) throw std::runtime_error("Config message with size " + std::to_string(size) + " != 24!");
+	if (recv_buffer.size() < 4 + size) return false;
+
+	std::memcpy(&puck_count, &recv_buffer[4+0], 4);
+	std::memcpy(&fan_angle, &recv_buffer[4+4], 4);
+	std::memcpy(&puck_speed, &recv_buffer[4+8], 4);
+	std::memcpy(&puck_retain, &recv_buffer[4+12], 4);
+	std::memcpy(&player_accel_halflife, &recv_buffer[4+16], 4);
+	std::memcpy(&goal_radius, &recv_buffer[4+20], 4);
+
+	recv_buffer.consume(4 + size);
+
+	return true;
+}
+
+//-----------------------------------------
+
+Game::Game(uint32_t puck_count, float fan_angle_) : Game(GameConfig{puck_count, fan_angle_}) {
+}
+
+Game::Game(GameConfig const &config_) {
+	set_config(config_);
+
+	//cells as wide as a puck/puck collision, so colliding pairs are always in neighboring cells:
+	grid.setup(ArenaMin, ArenaMax, 2.0f * PuckRadius);
+
 	//player 0 gets first serve
 	reset(PLAYER_0);
 }
 
+void Game::set_puck_count(uint32_t puck_count, float fan_angle_) {
+	if (puck_count == 0 || puck_count > MaxPuckCount) {
+		throw std::runtime_error("Puck count " + std::to_string(puck_count) + " is not in [1," + std::to_string(MaxPuckCount) + "].");
+	}
+
+	//new copies start wherever the first puck is:
+	glm::vec2 at = pucks.count ? pucks.position(0) : glm::vec2(0.0f);
+	PlayerType hit = pucks.count ? pucks.last_hit[0] : NEUTRAL;
+	pucks.resize(puck_count);
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		pucks.set_position(i, at);
+		pucks.last_hit[i] = hit;
+	}
+
+	config.puck_count = puck_count;
+	config.fan_angle = fan_angle_;
+	build_fan_table();
+
+	//the pucks jumped, and recorded frames have the old count, so nothing from before can be rewound to:
+	epoch += 1;
+	history.set_puck_count(pucks.count);
+	history.clear();
+}
+
+void Game::set_config(GameConfig const &config_) {
+	config_.validate();
+	config = config_;
+	set_puck_count(config.puck_count, config.fan_angle);
+}
+
+void Game::set_deterministic(bool deterministic_) {
+	deterministic = deterministic_;
+	build_fan_table();
+}
+
+//---- libm-free math for deterministic mode ----
+//These only use +, -, *, / (which IEEE 754 rounds exactly the same everywhere) and the exact
+// floor/ldexp/fmod, so -- unlike std::pow/std::sin/std::cos -- they agree to the bit across platforms.
+
+//2^x via 2^floor(x) * 2^frac(x), with 2^frac from its Taylor series (error below float precision):
+static float exact_exp2(float x) {
+	x = std::clamp(x, -126.0f, 127.0f);
+	float whole = std::floor(x);
+	float f = x - whole;
+	float p = 1.017808601e-07f;
+	p = p * f + 1.321548679e-06f;
+	p = p * f + 1.525273380e-05f;
+	p = p * f + 1.540353039e-04f;
+	p = p * f + 1.333355815e-03f;
+	p = p * f + 9.618129108e-03f;
+	p = p * f + 5.550410866e-02f;
+	p = p * f + 2.402265070e-01f;
+	p = p * f + 6.931471806e-01f;
+	p = p * f + 1.0f;
+	return std::ldexp(p, int(whole));
+}
+
+//cos and sin of an angle in degrees; reduces to [-45,45] degrees exactly, then uses Taylor series:
+static void exact_cos_sin(double degrees, double *c_, double *s_) {
+	double d = std::fmod(degrees, 360.0);
+	double quadrant = std::floor(d / 90.0 + 0.5);
+	double x = (d - 90.0 * quadrant) * (3.14159265358979323846 / 180.0);
+	double x2 = x * x;
+	double s = x * (1.0 - x2 / 6.0 * (1.0 - x2 / 20.0 * (1.0 - x2 / 42.0 * (1.0 - x2 / 72.0 * (1.0 - x2 / 110.0 * (1.0 - x2 / 156.0))))));
+	double c = 1.0 - x2 / 2.0 * (1.0 - x2 / 12.0 * (1.0 - x2 / 30.0 * (1.0 - x2 / 56.0 * (1.0 - x2 / 90.0 * (1.0 - x2 / 132.0)))));
+	switch (int(quadrant) & 3) {
+		case 0: *c_ =  c; *s_ =  s; break;
+		case 1: *c_ = -s; *s_ =  c; break;
+		case 2: *c_ = -c; *s_ = -s; break;
+		case 3: *c_ =  s; *s_ = -c; break;
+	}
+}
+
+void Game::build_fan_table() {
+	build_fan_table(pucks.count, config.fan_angle, deterministic, &fan_cos, &fan_sin);
+}
+
+void Game::build_fan_table(uint32_t count, float fan_angle, bool deterministic, std::vector< float > *fan_cos, std::vector< float > *fan_sin) {
+	assert(fan_cos && fan_sin);
+	//copies fan out symmetrically around the root, skipping the root's own (zero) angle:
+	fan_cos->clear();
+	fan_sin->clear();
+	int cnt = -int(count - 1) / 2;
+	for (uint32_t k = 0; k + 1 < count; ++k) {
+		if (deterministic) {
+			double c, s;
+			exact_cos_sin(double(fan_angle) * cnt, &c, &s);
+			fan_cos->emplace_back(float(c));
+			fan_sin->emplace_back(float(s));
+		} else {
+			float angle = glm::radians(fan_angle * cnt);
+			fan_cos->emplace_back(std::cos(angle));
+			fan_sin->emplace_back(std::sin(angle));
+		}
+
+		cnt++;
+		if (cnt == 0) cnt++;
+	}
+}
 
 void Game::reset(PlayerType type) {
 	LOG("Resetting!");
+	epoch += 1;
 	//place players in initial positions
-	player_0.position.x = 0.0f;
-	player_0.position.y = -1.75f;
-
+	player_0.position = Player0Start;
 	player_0.controls.reset();
 
-	player_1.position.x = 0.0f;
-	player_1.position.y = 1.75f;
-
+	player_1.position = Player1Start;
 	player_1.controls.reset();
 
 	//place pucks in initial position
+	serve_pucks(pucks, 0, pucks.count, type);
+}
+
+void Game::serve_pucks(Pucks &pucks, uint32_t begin, uint32_t count, PlayerType type) {
 	float y = type == PLAYER_0 ? -0.75f : 0.75f;
-	for (auto &puck : pucks) {
-		puck.position.x = 0.0f;
-		puck.position.y = y;
-		puck.last_hit = NEUTRAL;
+	for (uint32_t i = begin; i < begin + count; ++i) {
+		pucks.x[i] = 0.0f;
+		pucks.y[i] = y;
+		pucks.last_hit[i] = NEUTRAL;
 	}
 }
 
-Player *Game::spawn_player() {
+Game::Seat Game::spawn_player() {
+	Seat seat;
 	switch (next_player) {
 	case PLAYER_0:
 		player_0.type = PLAYER_0;
 		next_player = player_1.type == PLAYER_1 ? NEUTRAL : PLAYER_1;
-		return &player_0;
+		seat.type = PLAYER_0;
+		break;
 	case PLAYER_1:
 		player_1.type = PLAYER_1;
 		next_player = player_0.type == PLAYER_0 ? NEUTRAL : PLAYER_0;
-		return &player_1;
+		seat.type = PLAYER_1;
+		break;
 	default:
-		spectators.emplace_back();
-		Player &player = spectators.back();
-		player.type = NEUTRAL;
-		return &player;
+		seat.spectator = spectators.emplace();
+		spectators.get(seat.spectator)->type = NEUTRAL;
+		break;
 	}
+	return seat;
 }
 
-void Game::remove_player(Player *player) {
-	if (player == &player_0) {
-		player_0.type = NEUTRAL;
+void Game::remove_player(Seat const &seat) {
+	//whoever takes the seat next (client or bot) starts with fresh controls -- not the last occupant's
+	// buttons, seq, or view_time (which would keep lag compensation rewinding for a bot that never sets it).
+	//The mallet's motion is left alone to decay under those controls: replays record only type and controls
+	// each tick, so changing anything else here would make re-simulating a recording diverge:
+	auto vacate = [](Player &player) {
+		player.type = NEUTRAL;
+		player.controls = Player::Controls();
+	};
+
+	if (seat.type == PLAYER_0) {
+		vacate(player_0);
 		next_player = PLAYER_0;
 		return;
 	}
 
-	if (player == &player_1) {
-		player_1.type = NEUTRAL;
+	if (seat.type == PLAYER_1) {
+		vacate(player_1);
 		next_player = PLAYER_1;
 		return;
 	}
 
-	bool found = false;
-	for (auto pi = spectators.begin(); pi != spectators.end(); ++pi) {
-		if (&*pi == player) {
-			spectators.erase(pi);
-			found = true;
-			break;
-		}
-	}
+	bool found = spectators.erase(seat.spectator);
 	assert(found);
+	(void)found;
 }
 
-void Game::update_player(Player &p, float elapsed, float y_min, float y_max) {
-	//Note: Player movement update is adapted from base code
+Player *Game::get_player(Seat const &seat) {
+	if (seat.type == PLAYER_0) return &player_0;
+	if (seat.type == PLAYER_1) return &player_1;
+	return spectators.get(seat.spectator);
+}
 
+void Game::update_player(Player &p, float elapsed, float y_min, float y_max) {
 	glm::vec2 dir = glm::vec2(0.0f, 0.0f);
 	if (p.controls.left.pressed) dir.x -= 1.0f;
 	if (p.controls.right.pressed) dir.x += 1.0f;
 	if (p.controls.down.pressed) dir.y -= 1.0f;
 	if (p.controls.up.pressed) dir.y += 1.0f;
 
+	float drift, accel;
+	player_blend(elapsed, config.player_accel_halflife, deterministic, &drift, &accel);
+	move_player(p.position, p.velocity, dir, drift, accel, elapsed, y_min, y_max);
+
+	//reset 'downs' since controls have been handled:
+	p.controls.reset();
+}
+
+void Game::player_blend(float elapsed, float halflife, bool deterministic, float *drift, float *accel) {
+	float x = elapsed / (halflife * 2.0f);
+	*drift = 1.0f - (deterministic ? exact_exp2(-x) : std::pow(0.5f, x));
+	x = elapsed / halflife;
+	*accel = 1.0f - (deterministic ? exact_exp2(-x) : std::pow(0.5f, x));
+}
+
+void Game::move_player(glm::vec2 &position, glm::vec2 &velocity, glm::vec2 dir, float drift, float accel, float elapsed, float y_min, float y_max) {
+	//Note: Player movement update is adapted from base code
+
 	if (dir == glm::vec2(0.0f)) {
 		//no inputs: just drift to a stop
-		float amt = 1.0f - std::pow(0.5f, elapsed / (PlayerAccelHalflife * 2.0f));
-		p.velocity = glm::mix(p.velocity, glm::vec2(0.0f,0.0f), amt);
+		velocity = glm::mix(velocity, glm::vec2(0.0f,0.0f), drift);
 	} else {
 		//inputs: tween velocity to target direction
 		dir = glm::normalize(dir);
 
-		float amt = 1.0f - std::pow(0.5f, elapsed / PlayerAccelHalflife);
-
 		//accelerate along velocity (if not fast enough):
-		float along = glm::dot(p.velocity, dir);
+		float along = glm::dot(velocity, dir);
 		if (along < PlayerSpeed) {
-			along = glm::mix(along, PlayerSpeed, amt);
+			along = glm::mix(along, PlayerSpeed, accel);
 		}
 
 		//damp perpendicular velocity:
-		float perp = glm::dot(p.velocity, glm::vec2(-dir.y, dir.x));
-		perp = glm::mix(perp, 0.0f, amt);
+		float perp = glm::dot(velocity, glm::vec2(-dir.y, dir.x));
+		perp = glm::mix(perp, 0.0f, accel);
 
-		p.velocity = dir * along + glm::vec2(-dir.y, dir.x) * perp;
+		velocity = dir * along + glm::vec2(-dir.y, dir.x) * perp;
 	}
-	p.position += p.velocity * elapsed;
-
-	//reset 'downs' since controls have been handled:
-	p.controls.reset();
+	position += velocity * elapsed;
 
 	//player/arena collisions:
-	if (p.position.x < ArenaMin.x + PlayerRadius) {
-		p.position.x = ArenaMin.x + PlayerRadius;
-		p.velocity.x = std::abs(p.velocity.x);
+	if (position.x < ArenaMin.x + PlayerRadius) {
+		position.x = ArenaMin.x + PlayerRadius;
+		velocity.x = std::abs(velocity.x);
 	}
-	if (p.position.x > ArenaMax.x - PlayerRadius) {
-		p.position.x = ArenaMax.x - PlayerRadius;
-		p.velocity.x =-std::abs(p.velocity.x);
+	if (position.x > ArenaMax.x - PlayerRadius) {
+		position.x = ArenaMax.x - PlayerRadius;
+		velocity.x =-std::abs(velocity.x);
 	}
-	if (p.position.y < y_min + PlayerRadius) {
-		p.position.y = y_min + PlayerRadius;
-		p.velocity.y = std::abs(p.velocity.y);
+	if (position.y < y_min + PlayerRadius) {
+		position.y = y_min + PlayerRadius;
+		velocity.y = std::abs(velocity.y);
 	}
-	if (p.position.y > y_max - PlayerRadius) {
-		p.position.y = y_max - PlayerRadius;
-		p.velocity.y =-std::abs(p.velocity.y);
+	if (position.y > y_max - PlayerRadius) {
+		position.y = y_max - PlayerRadius;
+		velocity.y =-std::abs(velocity.y);
 	}
 }
 
 
-bool Game::check_collision(Puck &puck, Player const &player) {
-	glm::vec2 disp = player.position - puck.position;
-	float dist = std::sqrt(glm::length2(disp));
-	if (dist > PlayerRadius + PuckRadius) return false;
+float Game::time_of_impact(uint32_t puck, Player const &player) const {
+	return time_of_impact(glm::vec2(pucks.prev_x[puck], pucks.prev_y[puck]), pucks.position(puck), player.prev_position, player.position);
+}
+
+float Game::time_of_impact(glm::vec2 const &puck_from, glm::vec2 const &puck_to, glm::vec2 const &player_from, glm::vec2 const &player_to) {
+	//puck and player both moved in straight lines during the step, so work in the player's frame
+	// and find when the puck's path first comes within touching distance:
+	float reach = PlayerRadius + PuckRadius;
+	glm::vec2 from = puck_from - player_from;
+	glm::vec2 to = puck_to - player_to;
+	glm::vec2 step = to - from;
+
+	float c = glm::length2(from) - reach * reach;
+	if (c <= 0.0f) return 0.0f; //already touching at the start of the step
+
+	float b = glm::dot(from, step);
+	if (b >= 0.0f) return NoImpact; //not approaching
+
+	float a = glm::length2(step);
+	float disc = b * b - a * c;
+	if (disc < 0.0f) return NoImpact; //passes by
+
+	float t = (-b - std::sqrt(disc)) / a;
+	return (t <= 1.0f ? t : NoImpact);
+}
 
-	//collides!
+void Game::check_collision(uint32_t puck, Player const &player, float t, float elapsed) {
+	bounce_puck(pucks, puck, player.prev_position, player.position, player.velocity, t, elapsed);
+}
+
+void Game::bounce_puck(Pucks &pucks, uint32_t puck, glm::vec2 const &player_from, glm::vec2 const &player_to, glm::vec2 const &player_velocity, float t, float elapsed) {
+	//where both were when they touched:
+	glm::vec2 puck_at = glm::mix(glm::vec2(pucks.prev_x[puck], pucks.prev_y[puck]), pucks.position(puck), t);
+	glm::vec2 player_at = glm::mix(player_from, player_to, t);
+
+	glm::vec2 disp = player_at - puck_at;
+	float dist = std::sqrt(glm::length2(disp));
+	//(only possible if they started exactly on top of each other; push the puck out "downstream")
+	glm::vec2 dir = (dist > 0.0f ? disp / dist : glm::vec2(0.0f, (player_to.y < 0.0f ? -1.0f : 1.0f)));
 
 	//elastic collision with "player_mass >>>> puck_mass"
-	glm::vec2 dir = disp / dist;
-	glm::vec2 v12 = player.velocity - puck.velocity;
+	glm::vec2 v12 = player_velocity - pucks.velocity(puck);
 	glm::vec2 delta_v12 = dir * glm::dot(dir, v12);
 	//Note: player much heavier than puck, no change in player velocity
-	puck.velocity += delta_v12 * 2.0f; // 2*m1 / (m1 + m2) ~ 2 when m1 >>>> m2
+	pucks.set_velocity(puck, pucks.velocity(puck) + delta_v12 * 2.0f); // 2*m1 / (m1 + m2) ~ 2 when m1 >>>> m2
+
+	//move puck outside of player (where it is now), then let it travel away for the rest of the step:
+	glm::vec2 position = player_to - (PlayerRadius + PuckRadius + 0.01f) * dir;
+	glm::vec2 away = pucks.velocity(puck) - player_velocity;
+	if (glm::dot(away, dir) < 0.0f) {
+		position += away * ((1.0f - t) * elapsed);
+	}
+	pucks.set_position(puck, position);
+
+	//the rest of the step (for wall checks) starts from the contact point:
+	pucks.prev_x[puck] = puck_at.x;
+	pucks.prev_y[puck] = puck_at.y;
+}
+
+uint32_t Game::rewind_ticks(Player const &player, float elapsed) const {
+	if (history.size() == 0 || player.controls.view_time <= 0.0) return 0;
+
+	//'time' already includes the current step; history.frame(0) is the state before it:
+	double behind = (time - elapsed) - player.controls.view_time;
+	if (behind < 0.5 * elapsed) return 0;
+	uint32_t ago = uint32_t(std::min(double(history.size()), std::floor(behind / elapsed + 0.5)));
+
+	//the pucks the player saw are gone if there's been a fork/goal/reset (or a change of puck count) since:
+	GameHistory::Frame frame = history.frame(ago - 1);
+	if (frame.epoch != epoch || frame.puck_count != pucks.count) return 0;
+
+	return ago;
+}
+
+Game::Contact Game::find_player_collision(bool use_grid, float elapsed) const {
+	Contact first;
+	first.puck = pucks.count;
+
+	//lag compensation: players looking at an older state are checked against the pucks they saw.
+	//(a rewound contact happened before anything in the current step, so the furthest back one wins)
+	std::array< Player const *, 2 > current;
+	uint32_t current_count = 0;
+	for (Player const *player : {&player_0, &player_1}) {
+		uint32_t ago = rewind_ticks(*player, elapsed);
+		if (ago == 0) {
+			current[current_count++] = player;
+			continue;
+		}
+		GameHistory::Frame frame = history.frame(ago - 1);
+		for (uint32_t i = 0; i < pucks.count; ++i) {
+			float t = time_of_impact(glm::vec2(frame.prev_x[i], frame.prev_y[i]), glm::vec2(frame.x[i], frame.y[i]), player->prev_position, player->position);
+			if (t == NoImpact) continue;
+			if (ago > first.ago || (ago == first.ago && t < first.t)) {
+				first.puck = i;
+				first.player = player;
+				first.t = t;
+				first.ago = ago;
+			}
+		}
+	}
+	if (first.puck != pucks.count) return first;
+
+	std::array< glm::vec2, 2 > from, to;
+	for (uint32_t p = 0; p < current_count; ++p) {
+		from[p] = current[p]->prev_position;
+		to[p] = current[p]->position;
+	}
+
+	if (!use_grid) {
+		uint32_t which = 0;
+		first.puck = first_contact(pucks, 0, pucks.count, current_count, from.data(), to.data(), &which, &first.t);
+		if (first.puck != pucks.count) first.player = current[which];
+		return first;
+	}
+
+	//earliest contact wins (ties go to the lower puck index, then to player 0):
+	auto consider = [&](uint32_t i, Player const &player) {
+		float t = time_of_impact(i, player);
+		if (t < first.t || (t == first.t && t != NoImpact && i < first.puck)) {
+			first.puck = i;
+			first.player = &player;
+			first.t = t;
+		}
+	};
+
+	grid.query_swept(pucks, current_count, from.data(), to.data(), PlayerRadius + PuckRadius, [&](uint32_t p, uint32_t i) {
+		consider(i, *current[p]);
+	});
+	return first;
+}
+
+uint32_t Game::first_contact(Pucks const &pucks, uint32_t begin, uint32_t count, uint32_t players, glm::vec2 const *from, glm::vec2 const *to, uint32_t *player, float *t) {
+	uint32_t first = begin + count;
+	float first_t = NoImpact;
+	for (uint32_t i = begin; i < begin + count; ++i) {
+		glm::vec2 puck_from = glm::vec2(pucks.prev_x[i], pucks.prev_y[i]);
+		glm::vec2 puck_to = pucks.position(i);
+		for (uint32_t p = 0; p < players; ++p) {
+			//(strictly earlier, so ties keep the lower puck, then the lower player)
+			float pt = time_of_impact(puck_from, puck_to, from[p], to[p]);
+			if (pt < first_t) {
+				first = i;
+				first_t = pt;
+				*player = p;
+			}
+		}
+	}
+	*t = first_t;
+	return first;
+}
 
-	//move puck outside of player
-	puck.position = player.position - (PlayerRadius + PuckRadius + 0.01f) * dir;
+bool Game::collide_puck_pair(uint32_t a, uint32_t b) {
+	glm::vec2 disp = pucks.position(b) - pucks.position(a);
+	float dist2 = glm::length2(disp);
+	if (dist2 >= (2.0f * PuckRadius) * (2.0f * PuckRadius)) return false;
+	//coincident pucks (e.g., right after a fork) have no well-defined normal:
+	if (dist2 == 0.0f) return false;
+
+	float dist = std::sqrt(dist2);
+	glm::vec2 dir = disp / dist;
+	float approach = glm::dot(pucks.velocity(a) - pucks.velocity(b), dir);
+	//already separating (e.g., freshly forked copies fanning out):
+	if (approach <= 0.0f) return false;
+
+	//elastic collision between equal masses: exchange velocity along the normal
+	pucks.set_velocity(a, pucks.velocity(a) - approach * dir);
+	pucks.set_velocity(b, pucks.velocity(b) + approach * dir);
+
+	//push apart so they don't stay overlapped
+	glm::vec2 push = (0.5f * (2.0f * PuckRadius - dist)) * dir;
+	pucks.set_position(a, pucks.position(a) - push);
+	pucks.set_position(b, pucks.position(b) + push);
 
 	return true;
 }
 
-void Game::fork_pucks(Puck *root) {
-	int cnt = -(NUM_PUCKS - 1) / 2;
-	for (auto &puck : pucks) {
-		if (&puck == root) continue;
+void Game::collide_pucks(bool use_grid) {
+	if (!use_grid) {
+		for (uint32_t a = 0; a < pucks.count; ++a) {
+			for (uint32_t b = a + 1; b < pucks.count; ++b) {
+				if (collide_puck_pair(a, b)) stats.puck_hits += 1;
+			}
+		}
+	} else {
+		grid.for_each_pair([this](uint32_t a, uint32_t b) {
+			if (collide_puck_pair(a, b)) stats.puck_hits += 1;
+		});
+	}
+}
 
-		puck.position = root->position;
-		puck.velocity = glm::rotate(root->velocity, glm::radians(PUCK_FAN_ANGLE * cnt));
-		puck.last_hit = root->last_hit;
+void Game::fork_pucks(uint32_t root) {
+	stats.forks += 1;
+	epoch += 1;
+	fork_pucks(pucks, 0, pucks.count, root, fan_cos.data(), fan_sin.data());
+}
 
-		cnt++;
-		if (cnt == 0) cnt++;
+void Game::fork_pucks(Pucks &pucks, uint32_t begin, uint32_t count, uint32_t root, float const *fan_cos, float const *fan_sin) {
+	float x = pucks.x[root], y = pucks.y[root];
+	float prev_x = pucks.prev_x[root], prev_y = pucks.prev_y[root];
+	float vx = pucks.vx[root], vy = pucks.vy[root];
+	PlayerType last_hit = pucks.last_hit[root];
+
+	//copy k is rotated by fan[k]; pucks before the root are copies [0,root), after it are [root,count-1):
+	auto fork = [&](uint32_t i, uint32_t k) {
+		pucks.x[i] = x;
+		pucks.y[i] = y;
+		pucks.prev_x[i] = prev_x;
+		pucks.prev_y[i] = prev_y;
+		pucks.vx[i] = vx * fan_cos[k] - vy * fan_sin[k];
+		pucks.vy[i] = vx * fan_sin[k] + vy * fan_cos[k];
+		pucks.last_hit[i] = last_hit;
+	};
+	for (uint32_t i = begin; i < root; ++i) {
+		fork(i, i - begin);
+	}
+	for (uint32_t i = root + 1; i < begin + count; ++i) {
+		fork(i, i - begin - 1);
 	}
 }
 
 void Game::update(float elapsed) {
 	//no need to update spectators
 
+	tick_number += 1;
+	time += elapsed;
+	events.clear();
+	update_state(elapsed);
+	if (deterministic) tick_hash = state_hash();
+	history.record(*this);
+}
+
+void Game::update_state(float elapsed) {
 	bool was_grace = grace_period > 0.0f;
 	if (was_grace) {
 		grace_period = std::max(0.0f, grace_period - elapsed);
@@ -265,114 +689,106 @@ void Game::update(float elapsed) {
 
 	if (was_grace) { // was in grace period, no logner in grace period, reset everything
 		reset(to_serve);
+		GameEvent event;
+		event.type = GameEvent::GraceEnd;
+		event.player = to_serve;
+		event.tick = tick_number;
+		event.position = pucks.position(0);
+		events.emplace_back(event);
 	}
 
 	//update players
+	player_0.prev_position = player_0.position;
+	player_1.prev_position = player_1.position;
 	update_player(player_0, elapsed, Player0Min, Player0Max);
 	update_player(player_1, elapsed, Player1Min, Player1Max);
 
 	{ //update pucks
 		//position/velocity update:
-		for (auto &puck : pucks) {
-			puck.prev_pos = puck.position;
-			puck.position += puck.velocity * elapsed;
-			//pucks decay velocity above a certain max
-			float speed = std::sqrt(glm::length2(puck.velocity));
-			if (PuckSpeed < speed) {
-				puck.velocity *= (PuckSpeed + (speed - PuckSpeed) * PuckRetain) / speed;
-			}
-		}
+		pucks.integrate(elapsed, config.puck_speed, config.puck_retain);
 
 		//collision resolution:
-		Puck *collide_puck = nullptr;
-
-		for (auto &puck : pucks) {
-			//puck/player collisions:
-			if (check_collision(puck, player_0)) {
-				puck.last_hit = player_0.type;
-				collide_puck = &puck;
-				break;
+		//(the grid only pays for itself when it's also used for puck/puck collisions)
+		bool use_grid = puck_collisions && pucks.count >= GridMinPucks;
+		if (use_grid) grid.build(pucks);
+
+		//goals are checked for after every step of puck movement:
+		auto check_scored = [&](uint32_t scored) {
+			if (scored == pucks.count) return false;
+			if (pucks.y[scored] < ArenaMin.y) {
+				handle_scored(scored, player_1.type);
+			} else {
+				handle_scored(scored, player_0.type);
 			}
-			if (check_collision(puck, player_1)) {
-				puck.last_hit = player_1.type;
-				collide_puck = &puck;
-				break;
+			return true;
+		};
+
+		//puck/player collisions (only the first puck to touch a player counts):
+		Contact contact = find_player_collision(use_grid, elapsed);
+		uint32_t collide_puck = contact.puck;
+		if (collide_puck != pucks.count) {
+			if (contact.ago) {
+				//lag-compensated hit: put the puck back how the player saw it...
+				GameHistory::Frame frame = history.frame(contact.ago - 1);
+				pucks.x[collide_puck] = frame.x[collide_puck];
+				pucks.y[collide_puck] = frame.y[collide_puck];
+				pucks.vx[collide_puck] = frame.vx[collide_puck];
+				pucks.vy[collide_puck] = frame.vy[collide_puck];
+				pucks.prev_x[collide_puck] = frame.prev_x[collide_puck];
+				pucks.prev_y[collide_puck] = frame.prev_y[collide_puck];
 			}
-		}
 
-		//was a collision, respawn all pucks from the one that collided
-		if (collide_puck != nullptr) {
+			check_collision(collide_puck, *contact.player, contact.t, elapsed);
+			stats.hits += 1;
+			pucks.last_hit[collide_puck] = contact.player->type;
+			GameEvent event;
+			event.type = GameEvent::Hit;
+			event.player = contact.player->type;
+			event.tick = tick_number;
+			event.puck = collide_puck;
+			event.position = pucks.position(collide_puck);
+			events.emplace_back(event);
+
+			//was a collision, respawn all pucks from the one that collided
 			fork_pucks(collide_puck);
-		}
-
-		//puck/arena collisions:
-		for (auto &puck : pucks) {
-			if (puck.position.x < ArenaMin.x + PuckRadius) {
-				puck.position.x = ArenaMin.x + PuckRadius;
-				puck.velocity.x = std::abs(puck.velocity.x);
-			}
-			if (puck.position.x > ArenaMax.x - PuckRadius) {
-				puck.position.x = ArenaMax.x - PuckRadius;
-				puck.velocity.x = -std::abs(puck.velocity.x);
-			}
 
-			//boolean variables indicating puck is outside of {var_name}
-			bool x_goal_min = puck.position.x < -GoalRadius + PuckRadius;
-			bool x_goal_max = puck.position.x > GoalRadius - PuckRadius;
-			bool y_min = puck.position.y < ArenaMin.y + PuckRadius;
-			bool y_max = puck.position.y > ArenaMax.y - PuckRadius;
-
-			if (x_goal_min || x_goal_max) {
-				//not completely within goal x bounds, check vertical wall collision
-				if (y_min) {
-					puck.position.y = ArenaMin.y + PuckRadius;
-					puck.velocity.y = std::abs(puck.velocity.y);
-				}
-				if (y_max) {
-					puck.position.y = ArenaMax.y - PuckRadius;
-					puck.velocity.y = -std::abs(puck.velocity.y);
-				}
-			}
-
-			if (y_min || y_max) {
-				//not completely within arena y bounds, check horizontal goal wall collision
-				if (x_goal_min && puck.prev_pos.x >= -GoalRadius + PuckRadius) {
-					puck.position.x = -GoalRadius + PuckRadius;
-					puck.velocity.x = std::abs(puck.velocity.x);
-				}
-				if (x_goal_max && puck.prev_pos.x < GoalRadius - PuckRadius) {
-					puck.position.x = GoalRadius - PuckRadius;
-					puck.velocity.x = -std::abs(puck.velocity.x);
-				}
-			}
-
-			//yes, the above has the downside of corner collisions teleporting the puck a bit too far.
-			//it shouldn't be too noticeable anyway...
-
-			//check if scored
-			if (puck.position.y < ArenaMin.y - PuckRadius) {
-				handle_scored(&puck, player_1.type);
-				break;
+			//...and then bring the copies forward from that step to the present:
+			for (uint32_t step = 0; step < contact.ago; ++step) {
+				if (check_scored(pucks.collide_arena(ArenaMin, ArenaMax, config.goal_radius, PuckRadius, MaxPuckStep))) return;
+				pucks.integrate(elapsed, config.puck_speed, config.puck_retain);
 			}
+		}
 
-			if (puck.position.y > ArenaMax.y + PuckRadius) {
-				handle_scored(&puck, player_0.type);
-				break;
-			}
+		//puck/puck collisions:
+		if (puck_collisions) {
+			//(forking moved every puck, so re-bin them)
+			if (collide_puck != pucks.count && use_grid) grid.build(pucks);
+			collide_pucks(use_grid);
 		}
+
+		//puck/arena collisions:
+		check_scored(pucks.collide_arena(ArenaMin, ArenaMax, config.goal_radius, PuckRadius, MaxPuckStep));
 	}
 
 }
 
-void Game::handle_scored(Puck *scored, PlayerType type) {
+void Game::handle_scored(uint32_t scored, PlayerType type) {
 	LOG("Goal scored! " << type);
 
 	grace_period = GRACE_PERIOD;
-
-	for (auto &puck : pucks) {
-		puck.position = scored->position;
-		puck.velocity = glm::vec2(0.0f, 0.0f);
-	}
+	stats.goals += 1;
+	epoch += 1;
+
+	collapse_pucks(pucks, 0, pucks.count, scored);
+	GameEvent event;
+	event.type = GameEvent::Collapse;
+	event.tick = tick_number;
+	event.puck = scored;
+	event.position = pucks.position(scored);
+	events.emplace_back(event);
+	event.type = GameEvent::Goal;
+	event.player = type;
+	events.emplace_back(event);
 
 	switch (type) {
 	case PLAYER_0:
@@ -389,6 +805,244 @@ void Game::handle_scored(Puck *scored, PlayerType type) {
 	}
 }
 
+void Game::collapse_pucks(Pucks &pucks, uint32_t begin, uint32_t count, uint32_t root) {
+	glm::vec2 at = pucks.position(root);
+	for (uint32_t i = begin; i < begin + count; ++i) {
+		pucks.set_position(i, at);
+		pucks.set_velocity(i, glm::vec2(0.0f, 0.0f));
+	}
+}
+
+//FNV-1a over 32-bit words (floats by bit pattern, so even -0.0f vs 0.0f counts as a difference),
+// with the four puck arrays in independent lanes so large puck counts stay cheap:
+namespace {
+	struct StateHasher {
+		static constexpr uint64_t Prime = 0x100000001b3ull;
+		uint64_t h = 0xcbf29ce484222325ull;
+		static uint64_t mix(uint64_t h, uint32_t word) { return (h ^ word) * Prime; }
+		static uint32_t bits(float f) { uint32_t w; std::memcpy(&w, &f, sizeof(w)); return w; }
+		void add(uint32_t word) { h = mix(h, word); }
+		void add(float f) { add(bits(f)); }
+		void add(glm::vec2 const &v) { add(v.x); add(v.y); }
+		void add(double d) { uint64_t w; std::memcpy(&w, &d, sizeof(w)); add(uint32_t(w)); add(uint32_t(w >> 32)); }
+	};
+}
+
+uint64_t Game::state_hash() const {
+	StateHasher hasher;
+	hasher.add(tick_number);
+	hasher.add(time);
+	hasher.add(epoch); //(lag compensation only rewinds within an epoch)
+	hasher.add(grace_period);
+	hasher.add(uint32_t(to_serve));
+
+	for (Player const *player : {&player_0, &player_1}) {
+		hasher.add(player->position);
+		hasher.add(player->velocity);
+		hasher.add(uint32_t(player->type));
+		hasher.add(player->score);
+		Player::Controls const &c = player->controls;
+		hasher.add(uint32_t(c.left.pressed) | uint32_t(c.right.pressed) << 1 | uint32_t(c.up.pressed) << 2
+		         | uint32_t(c.down.pressed) << 3 | uint32_t(c.jump.pressed) << 4);
+		hasher.add(c.view_time); //(decides how far back this player's hits are checked)
+	}
+
+	hasher.add(pucks.count);
+	uint64_t lanes[4] = {hasher.h, hasher.h + 1, hasher.h + 2, hasher.h + 3};
+	uint64_t hit = hasher.h;
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		lanes[0] = StateHasher::mix(lanes[0], StateHasher::bits(pucks.x[i]));
+		lanes[1] = StateHasher::mix(lanes[1], StateHasher::bits(pucks.y[i]));
+		lanes[2] = StateHasher::mix(lanes[2], StateHasher::bits(pucks.vx[i]));
+		lanes[3] = StateHasher::mix(lanes[3], StateHasher::bits(pucks.vy[i]));
+		hit = StateHasher::mix(hit, uint32_t(pucks.last_hit[i]));
+	}
+
+	//fold lanes together, then finish with a 64-bit avalanche so every input bit reaches every output bit:
+	uint64_t h = hit;
+	for (uint64_t lane : lanes) {
+		h = (h ^ lane ^ (lane >> 32)) * StateHasher::Prime;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+
+void Game::save(GameSnapshot &snapshot) const {
+	GameSnapshot::Header header;
+	header.player_0 = player_0;
+	header.player_1 = player_1;
+	header.next_player = next_player;
+	header.to_serve = to_serve;
+	header.grace_period = grace_period;
+	header.tick_number = tick_number;
+	header.tick_hash = tick_hash;
+	header.time = time;
+	header.epoch = epoch;
+	header.puck_count = pucks.count;
+
+	snapshot.bytes.resize(GameSnapshot::size_for(pucks.count));
+	uint8_t *at = snapshot.bytes.data();
+	auto put = [&at](void const *data, size_t size) {
+		std::memcpy(at, data, size);
+		at += size;
+	};
+	put(&header, sizeof(header));
+	put(pucks.x.data(), pucks.count * sizeof(float));
+	put(pucks.y.data(), pucks.count * sizeof(float));
+	put(pucks.vx.data(), pucks.count * sizeof(float));
+	put(pucks.vy.data(), pucks.count * sizeof(float));
+	put(pucks.last_hit.data(), pucks.count * sizeof(PlayerType));
+	assert(at == snapshot.bytes.data() + snapshot.bytes.size());
+}
+
+void Game::load(GameSnapshot const &snapshot) {
+	GameSnapshot::Header header;
+	if (snapshot.bytes.size() < sizeof(header)) {
+		throw std::runtime_error("Snapshot of " + std::to_string(snapshot.bytes.size()) + " bytes is too small to hold a header.");
+	}
+	std::memcpy(&header, snapshot.bytes.data(), sizeof(header));
+	if (header.puck_count == 0 || header.puck_count > MaxPuckCount
+	 || snapshot.bytes.size() != GameSnapshot::size_for(header.puck_count)) {
+		throw std::runtime_error("Snapshot of " + std::to_string(snapshot.bytes.size()) + " bytes doesn't match its puck count (" + std::to_string(header.puck_count) + ").");
+	}
+
+	player_0 = header.player_0;
+	player_1 = header.player_1;
+	next_player = header.next_player;
+	to_serve = header.to_serve;
+	grace_period = header.grace_period;
+	tick_number = header.tick_number;
+	tick_hash = header.tick_hash;
+	time = header.time;
+	epoch = header.epoch;
+
+	if (header.puck_count != pucks.count) {
+		pucks.resize(header.puck_count);
+		config.puck_count = header.puck_count;
+		build_fan_table();
+	}
+	history.set_puck_count(pucks.count);
+	history.clear(); //(recorded from some other timeline)
+	uint8_t const *at = snapshot.bytes.data() + sizeof(header);
+	auto get = [&at](void *data, size_t size) {
+		std::memcpy(data, at, size);
+		at += size;
+	};
+	get(pucks.x.data(), pucks.count * sizeof(float));
+	get(pucks.y.data(), pucks.count * sizeof(float));
+	get(pucks.vx.data(), pucks.count * sizeof(float));
+	get(pucks.vy.data(), pucks.count * sizeof(float));
+	get(pucks.last_hit.data(), pucks.count * sizeof(PlayerType));
+}
+
+void Game::send_ack_message(Connection *connection_, Player const &connection_player) {
+	assert(connection_);
+	auto &connection = *connection_;
+
+	uint32_t size = 1 + 4;
+	connection.send(Message::S2C_Ack);
+	connection.send(uint8_t(size));
+	connection.send(uint8_t(size >> 8));
+	connection.send(uint8_t(size >> 16));
+
+	connection.send(uint8_t(connection_player.type));
+	connection.send(connection_player.controls.seq);
+}
+
+bool Game::recv_ack_message(Connection *connection_, PlayerType *type, uint32_t *seq) {
+	assert(connection_);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	if (recv_buffer.size() < 4) return false;
+	if (recv_buffer[0] != uint8_t(Message::S2C_Ack)) return false;
+	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
+	              | (uint32_t(recv_buffer[2]) << 8)
+	              |  uint32_t(recv_buffer[1]);
+	if (size != 5) throw std::runtime_error("Ack message with size " + std::to_string(size) + " != 5!");
+	if (recv_buffer.size() < 4 + size) return false;
+
+	if (recv_buffer[4] > PLAYER_1) throw std::runtime_error("Ack message with bad player type " + std::to_string(recv_buffer[4]) + ".");
+	*type = PlayerType(recv_buffer[4]);
+	std::memcpy(seq, &recv_buffer[5], sizeof(*seq));
+
+	recv_buffer.consume(4 + size);
+
+	return true;
+}
+
+void Game::send_events_message(Connection *connection_, std::vector< GameEvent > const &events) {
+	assert(connection_);
+	auto &connection = *connection_;
+
+	//each event is type, player, tick, puck, position:
+	constexpr uint32_t EventSize = 1 + 1 + 4 + 4 + 8;
+	uint32_t size = 4 + uint32_t(events.size()) * EventSize;
+	connection.send(Message::S2C_Events);
+	connection.send(uint8_t(size));
+	connection.send(uint8_t(size >> 8));
+	connection.send(uint8_t(size >> 16));
+
+	connection.send(uint32_t(events.size()));
+	for (GameEvent const &event : events) {
+		connection.send(uint8_t(event.type));
+		connection.send(uint8_t(event.player));
+		connection.send(event.tick);
+		connection.send(event.puck);
+		connection.send(event.position);
+	}
+}
+
+bool Game::recv_events_message(Connection *connection_, std::vector< GameEvent > *events) {
+	assert(connection_);
+	assert(events);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	if (recv_buffer.size() < 4) return false;
+	if (recv_buffer[0] != uint8_t(Message::S2C_Events)) return false;
+	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
+	              | (uint32_t(recv_buffer[2]) << 8)
+	              |  uint32_t(recv_buffer[1]);
+	if (recv_buffer.size() < 4 + size) return false;
+
+	uint32_t at = 0;
+	auto read = [&](auto *val) {
+		if (at + sizeof(*val) > size) {
+			throw std::runtime_error("Ran out of bytes reading events message.");
+		}
+		std::memcpy(static_cast< void * >(val), &recv_buffer[4 + at], sizeof(*val));
+		at += sizeof(*val);
+	};
+
+	uint32_t count;
+	read(&count);
+	for (uint32_t i = 0; i < count; ++i) {
+		GameEvent event;
+		uint8_t type, player;
+		read(&type);
+		read(&player);
+		if (type > GameEvent::GraceEnd) throw std::runtime_error("Events message with bad event type " + std::to_string(type) + ".");
+		if (player > PLAYER_1) throw std::runtime_error("Events message with bad player type " + std::to_string(player) + ".");
+		event.type = GameEvent::Type(type);
+		event.player = PlayerType(player);
+		read(&event.tick);
+		read(&event.puck);
+		read(&event.position);
+		events->emplace_back(event);
+	}
+
+	if (at != size) throw std::runtime_error("Trailing data in events message.");
+
+	recv_buffer.consume(4 + size);
+
+	return true;
+}
 
 void Game::send_state_message(Connection *connection_, Player *connection_player) const {
 	assert(connection_);
@@ -411,18 +1065,21 @@ void Game::send_state_message(Connection *connection_, Player *connection_player
 	};
 
 	//send puck info helper:
-	auto send_puck = [&](Puck const &puck) {
-		connection.send(puck.position);
-		connection.send(puck.velocity);
-		connection.send(puck.last_hit);
+	auto send_puck = [&](uint32_t i) {
+		connection.send(pucks.position(i));
+		connection.send(pucks.velocity(i));
+		connection.send(pucks.last_hit[i]);
 	};
 
+	connection.send(time);
+	connection.send(epoch);
 	connection.send(grace_period);
 	send_player(player_0);
 	send_player(player_1);
 	//puck count:
-	for (auto const &puck : pucks) {
-		send_puck(puck);
+	connection.send(pucks.count);
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		send_puck(i);
 	}
 
 	//compute the message size and patch into the message header:
@@ -455,6 +1112,8 @@ bool Game::recv_state_message(Connection *connection_) {
 		at += sizeof(*val);
 	};
 
+	read(&time);
+	read(&epoch);
 	read(&grace_period);
 
 	// read player 0
@@ -469,16 +1128,30 @@ bool Game::recv_state_message(Connection *connection_) {
 	read(&player_1.type);
 	read(&player_1.score);
 
-	for (auto &puck : pucks) {
-		read(&puck.position);
-		read(&puck.velocity);
-		read(&puck.last_hit);
+	uint32_t puck_count;
+	read(&puck_count);
+	if (puck_count == 0 || puck_count > MaxPuckCount) {
+		throw std::runtime_error("State message has " + std::to_string(puck_count) + " pucks.");
+	}
+	if (puck_count != pucks.count) {
+		pucks.resize(puck_count);
+		config.puck_count = puck_count;
+		build_fan_table(); //(forks index it by copy, so it has to match the new count)
+	}
+
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		glm::vec2 position, velocity;
+		read(&position);
+		read(&velocity);
+		read(&pucks.last_hit[i]);
+		pucks.set_position(i, position);
+		pucks.set_velocity(i, velocity);
 	}
 
 	if (at != size) throw std::runtime_error("Trailing data in state message.");
 
 	//delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+	recv_buffer.consume(4 + size);
 
 	return true;
 }
@@ -23,15 +23,17 @@
  */
 #pragma once
 
+#include "GameHistory.hpp"
+#include "PuckGrid.hpp"
+#include "SlotMap.hpp"
+
 #include <glm/glm.hpp>
 
 #include <array>
-#include <list>
-#include <random>
 #include <string>
+#include <type_traits>
+#include <vector>
 
-#define NUM_PUCKS 5
-#define PUCK_FAN_ANGLE 10.0f
 #define GRACE_PERIOD 3.0f
 
 struct Connection;
@@ -49,6 +51,10 @@ enum PlayerType {
 enum class Message : uint8_t {
 	C2S_Controls = 1, //Greg!
 	S2C_State = 's',
+	S2C_Ack = 'a', //which player the client controls + last controls seq applied
+	S2C_Config = 'c', //gameplay settings (sent on connect)
+	S2C_PartyState = 'p', //PartyGame state (any number of players)
+	S2C_Events = 'e', //what happened in the tick whose state follows
 	//...
 };
 
@@ -64,6 +70,13 @@ struct Player {
 	struct Controls {
 		Button left, right, up, down, jump;
 
+		//sequence number of these controls; the client counts up once per message sent,
+		// the server echoes the latest one it has applied in its ack message:
+		uint32_t seq = 0;
+
+		//server time of the state the client was showing when it sent these (used for lag compensation):
+		double view_time = 0.0;
+
 		void send_controls_message(Connection *connection) const;
 
 		//returns 'false' if no message or not a controls message,
@@ -78,52 +91,241 @@ struct Player {
 	glm::vec2 position = glm::vec2(0.0f, 0.0f);
 	glm::vec2 velocity = glm::vec2(0.0f, 0.0f);
 
-	PlayerType type;
+	//position at the start of the current step (used for swept collisions):
+	glm::vec2 prev_position = glm::vec2(0.0f, 0.0f);
+
+	PlayerType type = NEUTRAL;
 
 	unsigned int score = 0;
 };
 
-struct Puck {
-	//player state (sent from server):
-	glm::vec2 position = glm::vec2(0.0f, 0.0f);
-	glm::vec2 velocity = glm::vec2(0.0f, 0.0f);
+//all copies of the puck, stored as structure-of-arrays so that the per-tick
+// passes can process several pucks per instruction (see Pucks.cpp):
+struct Pucks {
+	//pucks state (sent from server):
+	std::vector< float > x, y;
+	std::vector< float > vx, vy;
 
 	//used for wall collisions
-	glm::vec2 prev_pos;
+	std::vector< float > prev_x, prev_y;
+
+	std::vector< PlayerType > last_hit;
+
+	//number of pucks; arrays are padded past this to a multiple of Lanes:
+	uint32_t count = 0;
+	inline static constexpr uint32_t Lanes = 8;
+
+	void resize(uint32_t count);
+
+	glm::vec2 position(uint32_t i) const { return glm::vec2(x[i], y[i]); }
+	glm::vec2 velocity(uint32_t i) const { return glm::vec2(vx[i], vy[i]); }
+	void set_position(uint32_t i, glm::vec2 const &p) { x[i] = p.x; y[i] = p.y; }
+	void set_velocity(uint32_t i, glm::vec2 const &v) { vx[i] = v.x; vy[i] = v.y; }
+
+	//which implementation the passes below use (defaults to the widest available):
+	enum Kernel : uint8_t {
+		Scalar,
+		SIMD
+	};
+	static Kernel kernel;
+
+	//save positions to prev_*, move by velocity * elapsed, and decay any speed above
+	// 'max_speed' so that only 'retain' of the excess is kept:
+	void integrate(float elapsed, float max_speed, float retain) {
+		integrate(0, count, elapsed, max_speed, retain);
+	}
+
+	//bounce off the side walls, the end walls outside the goal mouth, and the goal posts.
+	//bounces reflect the step taken since prev_*, so nothing tunnels through a wall or post at low tick rates.
+	//steps longer than 'max_step' that end past a wall and could have met two (corners, goal posts) are walked again
+	// in up to MaxSubsteps pieces of at most 'max_step', bouncing after each, so they meet the walls in order;
+	// other pucks take the single step, which is exact for one wall (pass infinity to never sub-step).
+	//returns the index of the first puck that is entirely past an end wall (i.e., scored), or 'count' if none:
+	uint32_t collide_arena(glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+		return collide_arena(0, count, arena_min, arena_max, goal_radius, radius, max_step);
+	}
+	inline static constexpr uint32_t MaxSubsteps = 64;
+
+	//the same passes over just [begin, end) (e.g., one match of a GameBatch); 'begin' must be a multiple of Lanes,
+	// and collide_arena returns 'end' if nothing scored:
+	void integrate(uint32_t begin, uint32_t end, float elapsed, float max_speed, float retain);
+	uint32_t collide_arena(uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step);
+};
 
-	PlayerType last_hit;
+struct GameSnapshot;
+
+//something that happened during Game::update (see Game::events):
+struct GameEvent {
+	enum Type : uint8_t {
+		Hit, //'player' hit copy 'puck' at 'position', and every copy forked from there
+		Collapse, //every copy collapsed onto copy 'puck' at 'position' (it went in a goal)
+		Goal, //'player' scored (NEUTRAL if the scoring side is empty) with copy 'puck', now at 'position'
+		GraceEnd, //the pause after a goal ended and the pucks were served to 'player'
+	} type = Hit;
+	PlayerType player = NEUTRAL;
+	uint32_t tick = 0; //Game::tick_number of the update it happened in
+	uint32_t puck = 0;
+	glm::vec2 position = glm::vec2(0.0f);
+};
+
+//gameplay tuning that can be changed without rebuilding (the server sends it to clients when they connect):
+struct GameConfig {
+	uint32_t puck_count = 5; //superposed copies of the puck
+	float fan_angle = 10.0f; //degrees between neighboring copies when struck
+	float puck_speed = 3.0f; //pucks faster than this slow down...
+	float puck_retain = 0.75f; //...keeping this fraction of the excess speed each step
+	float player_accel_halflife = 0.05f; //seconds for a mallet to get halfway to its target velocity
+	float goal_radius = 0.27f; //half-width of the goal mouths
+
+	//throws if any value is out of range:
+	void validate() const;
+
+	//fields by name (for command lines and CSV columns); both throw on unknown names:
+	inline static constexpr std::array< char const *, 6 > Fields{
+		"puck_count", "fan_angle", "puck_speed", "puck_retain", "player_accel_halflife", "goal_radius"
+	};
+	double get(std::string const &name) const;
+	void set(std::string const &name, double value);
+
+	void send_config_message(Connection *connection) const;
+
+	//returns 'false' if no (complete) config message,
+	//returns 'true' if read a config message (which is not validated),
+	//throws on malformed config message
+	bool recv_config_message(Connection *connection);
 };
 
 struct Game {
-	std::array< Puck, NUM_PUCKS > pucks;
+	Pucks pucks;
 
 	Player player_0;
 	Player player_1;
-	std::list< Player > spectators;
+	SlotMap< Player > spectators;
+
+	//where a connection is in the game: one of the two players, or a spectator:
+	struct Seat {
+		PlayerType type = NEUTRAL; //PLAYER_0 or PLAYER_1, or NEUTRAL for a spectator
+		SlotHandle spectator; //(spectators only)
+	};
 
 	/**
 	 * Game always has 2 players present, connecting assume one of two players if possible
 	 * and spectator if not
 	 */
-	Player *spawn_player(); //adopt of one the two players
-	void remove_player(Player *); //release control of one of the two players
+	Seat spawn_player(); //adopt of one the two players (or add a spectator)
+	void remove_player(Seat const &seat); //release control of one of the two players (or remove a spectator)
+	Player *get_player(Seat const &seat); //nullptr if 'seat' was a spectator that has been removed
 
 	PlayerType next_player = PLAYER_0; //used player spawning
 	PlayerType to_serve = PLAYER_0; //used for goal resets
 	float grace_period = 0.0f; //grace period after scoring where neither player can move
 
-	Game();
+	//optional mode where puck copies also bounce off each other:
+	bool puck_collisions = false;
+
+	//optional mode where update() avoids libm transcendentals (whose last bits differ between
+	// platforms), so the same inputs and tick lengths give bit-identical states on every build
+	// (given no fused multiply-add contraction; see Maekfile.js):
+	bool deterministic = false;
+	void set_deterministic(bool deterministic); //also rebuilds the fan table
+
+	uint32_t tick_number = 0; //calls to update() so far
+	double time = 0.0; //seconds simulated so far (clients use it to place states on a timeline)
+	//bumped whenever pucks or players jump instead of moving (fork, goal, reset),
+	// so clients know not to interpolate across it:
+	uint32_t epoch = 0;
+	uint64_t tick_hash = 0; //state_hash() after the last update() (deterministic mode only)
+
+	//64-bit hash of everything that affects future updates, including what lag compensation goes by (time, epoch,
+	// and each player's view_time), but not spectators, stats, the grid, or the history frames themselves:
+	uint64_t state_hash() const;
+
+	//copy match state to/from a snapshot (for rollback, lookahead, replays, ...):
+	// saves everything state_hash() covers (plus tick_hash), but not spectators, stats, or settings.
+	// neither allocates once the snapshot/game have been used with the same puck count.
+	void save(GameSnapshot &snapshot) const;
+	void load(GameSnapshot const &snapshot); //adopts the snapshot's puck count; throws if malformed
+
+	//broadphase for puck/puck collisions (and puck/player checks while it's built anyway):
+	PuckGrid grid;
+
+	//recent states for lag compensation (off unless given a length; the server sets one):
+	GameHistory history;
+
+	//gameplay tuning (change with set_config or set_puck_count, which rebuild what depends on it):
+	GameConfig config;
+	void set_config(GameConfig const &config); //throws if config is invalid
+
+	//what happened in the last update(), in order (cleared at the start of each update(), so it
+	// stops allocating once it has held a busy tick; not part of snapshots or state_hash()):
+	std::vector< GameEvent > events;
+
+	//running totals of things that happened in update() (for benchmarks; not sent):
+	struct Stats {
+		uint64_t hits = 0; //puck/player collisions
+		uint64_t puck_hits = 0; //puck/puck collisions
+		uint64_t forks = 0;
+		uint64_t goals = 0;
+	} stats;
+
+	//'puck_count' superposed copies of the puck fan out 'fan_angle' degrees apart when hit:
+	Game(uint32_t puck_count = DefaultPuckCount, float fan_angle = DefaultFanAngle);
+	explicit Game(GameConfig const &config);
+
+	//set the number of copies (and their fan angle) and rebuild the fan rotation table:
+	void set_puck_count(uint32_t puck_count, float fan_angle);
+	//rotation (cos, sin) applied to the k'th non-root copy by fork_pucks:
+	std::vector< float > fan_cos, fan_sin;
+	void build_fan_table();
+	//(the same table for any 'count' copies, for games that keep their own pucks)
+	static void build_fan_table(uint32_t count, float fan_angle, bool deterministic, std::vector< float > *fan_cos, std::vector< float > *fan_sin);
 
 	//state update function:
 	void reset(PlayerType type);
 	void update_player(Player &p, float elapsed, float y_min, float y_max);
-	bool check_collision(Puck &puck, Player const &player);
-	void fork_pucks(Puck *);
-	void handle_scored(Puck *puck, PlayerType type);
-	void update(float elapsed);
+
+	//swept puck/player collision: fraction [0,1] of the last step at which they first touched, or NoImpact:
+	float time_of_impact(uint32_t puck, Player const &player) const;
+	static float time_of_impact(glm::vec2 const &puck_from, glm::vec2 const &puck_to, glm::vec2 const &player_from, glm::vec2 const &player_to);
+	inline static constexpr float NoImpact = 2.0f;
+	struct Contact {
+		uint32_t puck = 0;
+		Player const *player = nullptr;
+		float t = NoImpact;
+		uint32_t ago = 0; //if nonzero, contact was in the step leading to history.frame(ago-1)
+	};
+	//how many steps back the state 'player' was looking at is (0 if not compensating for it):
+	uint32_t rewind_ticks(Player const &player, float elapsed) const;
+	Contact find_player_collision(bool use_grid, float elapsed) const; //earliest puck/player contact (puck == pucks.count if none)
+	void check_collision(uint32_t puck, Player const &player, float t, float elapsed); //bounce puck off player at time t
+	bool collide_puck_pair(uint32_t a, uint32_t b);
+	void collide_pucks(bool use_grid); //resolve all puck/puck collisions
+	void fork_pucks(uint32_t root);
+	void handle_scored(uint32_t scored, PlayerType type);
+	void update(float elapsed); //counts the tick, calls update_state, and (if deterministic) hashes
+	void update_state(float elapsed);
+
+	//---- pieces of update() shared with GameBatch ----
+	//(GameBatch keeps many matches' pucks in one Pucks, so these take the range [begin, begin+count) of one match's copies)
+
+	//velocity blend factors for a step of 'elapsed' with no input ('drift') and with input ('accel'):
+	static void player_blend(float elapsed, float halflife, bool deterministic, float *drift, float *accel);
+	//move a player holding direction 'dir' (components -1, 0, or 1) and keep it inside its zone:
+	static void move_player(glm::vec2 &position, glm::vec2 &velocity, glm::vec2 dir, float drift, float accel, float elapsed, float y_min, float y_max);
+	//earliest swept contact between the copies and 'players' mallets that moved from[p] -> to[p]:
+	// returns the puck (begin+count if none); ties go to the lower puck, then the lower player
+	static uint32_t first_contact(Pucks const &pucks, uint32_t begin, uint32_t count, uint32_t players, glm::vec2 const *from, glm::vec2 const *to, uint32_t *player, float *t);
+	//bounce a puck off a mallet it touched at fraction t of the step:
+	static void bounce_puck(Pucks &pucks, uint32_t puck, glm::vec2 const &player_from, glm::vec2 const &player_to, glm::vec2 const &player_velocity, float t, float elapsed);
+	//respawn every copy from 'root', fanned out by fan_cos/fan_sin:
+	static void fork_pucks(Pucks &pucks, uint32_t begin, uint32_t count, uint32_t root, float const *fan_cos, float const *fan_sin);
+	//gather every copy (stopped) where 'root' is:
+	static void collapse_pucks(Pucks &pucks, uint32_t begin, uint32_t count, uint32_t root);
+	//put every copy at the serve position on 'type's side:
+	static void serve_pucks(Pucks &pucks, uint32_t begin, uint32_t count, PlayerType type);
 
 	//constants:
-	//the update rate on the server:
+	//the (default) update rate on the server:
 	inline static constexpr float Tick = 1.0f / 30.0f;
 
 	//arena size:
@@ -131,31 +333,78 @@ struct Game {
 	inline static constexpr float Player0Max = -0.5f;
 	inline static constexpr float Player1Min =  0.5f;
 	inline static constexpr float Player1Max =  2.0f;
+	inline static constexpr glm::vec2 Player0Start = glm::vec2(0.0f, -1.75f);
+	inline static constexpr glm::vec2 Player1Start = glm::vec2(0.0f,  1.75f);
 	inline static constexpr glm::vec2 ArenaMin = glm::vec2(-1.0f, Player0Min);
 	inline static constexpr glm::vec2 ArenaMax = glm::vec2( 1.0f, Player1Max);
-	inline static constexpr float GoalRadius = 0.27f;
 	inline static constexpr glm::vec2 Goal0Center = glm::vec2(0.0, Player0Min);
 	inline static constexpr glm::vec2 Goal1Center = glm::vec2(0.0, Player1Max);
 
 	//player constants:
 	inline static constexpr float PlayerRadius = 0.09f;
 	inline static constexpr float PlayerSpeed = 3.0f;
-	inline static constexpr float PlayerAccelHalflife = 0.05f;
 
-	//puck constants:
+	//puck constants (see GameConfig for the tunable ones):
+	inline static constexpr uint32_t DefaultPuckCount = GameConfig().puck_count;
+	inline static constexpr uint32_t MaxPuckCount = 4096;
+	inline static constexpr float DefaultFanAngle = GameConfig().fan_angle;
 	inline static constexpr float PuckRadius = 0.05f;
-	inline static constexpr float PuckSpeed = 3.0f;
-	inline static constexpr float PuckRetain = 0.75f;
+	//longest step a puck takes against the walls (see Pucks::collide_arena); a puck at the default
+	// puck_speed covers four of these per Tick:
+	inline static constexpr float MaxPuckStep = 0.5f * PuckRadius;
+
+	//puck counts at or above this use the grid for puck/puck collisions (below, brute force is cheaper):
+	inline static constexpr uint32_t GridMinPucks = 64;
 
 	//---- communication helpers ----
 
 	//used by client:
 	//set game state from data in connection buffer
-	// (return true if data was read)
+	// (return true if data was read; adopts the server's puck count)
 	bool recv_state_message(Connection *connection);
 
 	//used by server:
 	//send game state.
-	//  Will move "connection_player" to the front of the front of the sent list.
+	// (the message is the same whoever it goes to -- 'connection_player' isn't used -- so a server
+	//  can encode it once per tick and send those bytes to everyone; see Room::tick)
 	void send_state_message(Connection *connection, Player *connection_player = nullptr) const;
+
+	//tell a client which player it controls and the latest controls seq included in the state that follows:
+	static void send_ack_message(Connection *connection, Player const &connection_player);
+
+	//used by client:
+	//returns 'false' if no (complete) ack message, throws on malformed ack message:
+	static bool recv_ack_message(Connection *connection, PlayerType *type, uint32_t *seq);
+
+	//used by server:
+	//send 'events' (e.g., Game::events after an update, whose state is sent next):
+	static void send_events_message(Connection *connection, std::vector< GameEvent > const &events);
+
+	//used by client:
+	//returns 'false' if no (complete) events message; appends the events to 'events'; throws on malformed events message:
+	static bool recv_events_message(Connection *connection, std::vector< GameEvent > *events);
+};
+
+//Game state as one flat blob of bytes: a trivially copyable Header followed by
+// the puck arrays (x, y, vx, vy, last_hit), each Header::puck_count long.
+//Blobs for the same puck count are all the same size, so copying a snapshot into
+// one that has been used before is a single memcpy.
+struct GameSnapshot {
+	struct Header {
+		Player player_0, player_1;
+		PlayerType next_player, to_serve;
+		float grace_period;
+		uint32_t tick_number;
+		uint64_t tick_hash;
+		double time;
+		uint32_t epoch;
+		uint32_t puck_count;
+	};
+	static_assert(std::is_trivially_copyable_v< Header >, "Header is copied with memcpy.");
+
+	std::vector< uint8_t > bytes;
+
+	static size_t size_for(uint32_t puck_count) {
+		return sizeof(Header) + size_t(puck_count) * (4 * sizeof(float) + sizeof(PlayerType));
+	}
 };
@@ -0,0 +1,291 @@
+#include "GameBatch.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+GameBatch::GameBatch(uint32_t matches_, GameConfig const &config, bool deterministic) : matches(matches_), initial(config) {
+	initial.set_deterministic(deterministic);
+	initial.player_0.type = PLAYER_0;
+	initial.player_1.type = PLAYER_1;
+
+	stride = (initial.pucks.count + Pucks::Lanes - 1) / Pucks::Lanes * Pucks::Lanes;
+	pucks.resize(matches * stride);
+
+	for (Players &p : players) {
+		for (auto *v : {&p.x, &p.y, &p.vx, &p.vy, &p.prev_x, &p.prev_y}) {
+			v->assign(matches, 0.0f);
+		}
+		p.score.assign(matches, 0);
+		p.input.assign(matches, 0);
+	}
+	grace_period.assign(matches, 0.0f);
+	to_serve.assign(matches, PLAYER_0);
+	tick_number.assign(matches, 0);
+	epoch.assign(matches, 0);
+	time.assign(matches, 0.0);
+	hit.assign(matches, NEUTRAL);
+	scored.assign(matches, NEUTRAL);
+	moving.assign(matches, 0);
+
+	for (uint32_t m = 0; m < matches; ++m) {
+		reset(m);
+	}
+}
+
+GameBatch::~GameBatch() {
+	set_threads(1);
+}
+
+void GameBatch::reset(uint32_t match) {
+	set(match, initial);
+}
+
+void GameBatch::get(uint32_t match, Game *game) const {
+	assert(match < matches);
+	if (game->deterministic != initial.deterministic) game->set_deterministic(initial.deterministic);
+	for (char const *field : GameConfig::Fields) {
+		if (game->config.get(field) != initial.config.get(field)) {
+			game->set_config(initial.config);
+			break;
+		}
+	}
+
+	Player *game_players[2] = {&game->player_0, &game->player_1};
+	for (uint32_t p = 0; p < 2; ++p) {
+		Players const &from = players[p];
+		Player &to = *game_players[p];
+		to.type = (p == 0 ? PLAYER_0 : PLAYER_1);
+		to.position = glm::vec2(from.x[match], from.y[match]);
+		to.velocity = glm::vec2(from.vx[match], from.vy[match]);
+		to.prev_position = glm::vec2(from.prev_x[match], from.prev_y[match]);
+		to.score = from.score[match];
+		uint8_t bits = from.input[match];
+		to.controls.left.pressed = (bits & Left);
+		to.controls.right.pressed = (bits & Right);
+		to.controls.up.pressed = (bits & Up);
+		to.controls.down.pressed = (bits & Down);
+		to.controls.jump.pressed = (bits & Jump);
+	}
+	game->grace_period = grace_period[match];
+	game->to_serve = to_serve[match];
+	game->tick_number = tick_number[match];
+	game->epoch = epoch[match];
+	game->time = time[match];
+
+	uint32_t base = match * stride;
+	for (uint32_t i = 0; i < game->pucks.count; ++i) {
+		game->pucks.x[i] = pucks.x[base + i];
+		game->pucks.y[i] = pucks.y[base + i];
+		game->pucks.vx[i] = pucks.vx[base + i];
+		game->pucks.vy[i] = pucks.vy[base + i];
+		game->pucks.prev_x[i] = pucks.prev_x[base + i];
+		game->pucks.prev_y[i] = pucks.prev_y[base + i];
+		game->pucks.last_hit[i] = pucks.last_hit[base + i];
+	}
+}
+
+void GameBatch::set(uint32_t match, Game const &game) {
+	assert(match < matches);
+	if (game.pucks.count != initial.pucks.count) {
+		throw std::runtime_error("Game with " + std::to_string(game.pucks.count) + " pucks doesn't fit in a batch of " + std::to_string(initial.pucks.count) + "-puck matches.");
+	}
+
+	Player const *game_players[2] = {&game.player_0, &game.player_1};
+	for (uint32_t p = 0; p < 2; ++p) {
+		Player const &from = *game_players[p];
+		Players &to = players[p];
+		to.x[match] = from.position.x;
+		to.y[match] = from.position.y;
+		to.vx[match] = from.velocity.x;
+		to.vy[match] = from.velocity.y;
+		to.prev_x[match] = from.prev_position.x;
+		to.prev_y[match] = from.prev_position.y;
+		to.score[match] = from.score;
+		to.input[match] = (from.controls.left.pressed ? Left : 0)
+		                | (from.controls.right.pressed ? Right : 0)
+		                | (from.controls.up.pressed ? Up : 0)
+		                | (from.controls.down.pressed ? Down : 0)
+		                | (from.controls.jump.pressed ? Jump : 0);
+	}
+	grace_period[match] = game.grace_period;
+	to_serve[match] = game.to_serve;
+	tick_number[match] = game.tick_number;
+	epoch[match] = game.epoch;
+	time[match] = game.time;
+
+	uint32_t base = match * stride;
+	for (uint32_t i = 0; i < stride; ++i) {
+		//(padding copies are zeroed so they stay put)
+		bool real = i < game.pucks.count;
+		pucks.x[base + i] = real ? game.pucks.x[i] : 0.0f;
+		pucks.y[base + i] = real ? game.pucks.y[i] : 0.0f;
+		pucks.vx[base + i] = real ? game.pucks.vx[i] : 0.0f;
+		pucks.vy[base + i] = real ? game.pucks.vy[i] : 0.0f;
+		pucks.prev_x[base + i] = real ? game.pucks.prev_x[i] : 0.0f;
+		pucks.prev_y[base + i] = real ? game.pucks.prev_y[i] : 0.0f;
+		pucks.last_hit[base + i] = real ? game.pucks.last_hit[i] : NEUTRAL;
+	}
+}
+
+//---------------------------------
+
+void GameBatch::step(Input const *inputs, float elapsed) {
+	float drift, accel;
+	Game::player_blend(elapsed, initial.config.player_accel_halflife, initial.deterministic, &drift, &accel);
+
+	if (workers.empty()) {
+		step_range(0, matches, inputs, elapsed, drift, accel, &stats);
+		return;
+	}
+
+	//hand a slice to each worker...
+	job.inputs = inputs;
+	job.elapsed = elapsed;
+	job.drift = drift;
+	job.accel = accel;
+	workers.begin();
+
+	//...do the first slice here...
+	uint32_t begin, end;
+	slice(0, &begin, &end);
+	step_range(begin, end, inputs, elapsed, drift, accel, &stats);
+
+	//...and wait for the rest:
+	workers.wait();
+	for (Game::Stats &s : worker_stats) {
+		stats.hits += s.hits;
+		stats.puck_hits += s.puck_hits;
+		stats.forks += s.forks;
+		stats.goals += s.goals;
+		s = Game::Stats();
+	}
+}
+
+void GameBatch::step_range(uint32_t begin, uint32_t end, Input const *inputs, float elapsed, float drift, float accel, Game::Stats *stats_) {
+	Game::Stats &slice_stats = *stats_;
+	uint32_t count = initial.pucks.count;
+
+	//players (and the grace period) -- the part of Game::update_state before the pucks move:
+	for (uint32_t m = begin; m < end; ++m) {
+		hit[m] = NEUTRAL;
+		scored[m] = NEUTRAL;
+		tick_number[m] += 1;
+		time[m] += elapsed;
+
+		bool was_grace = grace_period[m] > 0.0f;
+		if (was_grace) {
+			grace_period[m] = std::max(0.0f, grace_period[m] - elapsed);
+		}
+		moving[m] = (grace_period[m] > 0.0f ? 0 : 1);
+
+		players[0].input[m] = inputs[m].player_0;
+		players[1].input[m] = inputs[m].player_1;
+		if (!moving[m]) continue;
+
+		if (was_grace) {
+			//(same as Game::reset)
+			epoch[m] += 1;
+			players[0].x[m] = Game::Player0Start.x;
+			players[0].y[m] = Game::Player0Start.y;
+			players[1].x[m] = Game::Player1Start.x;
+			players[1].y[m] = Game::Player1Start.y;
+			Game::serve_pucks(pucks, m * stride, count, to_serve[m]);
+		}
+
+		for (uint32_t p = 0; p < 2; ++p) {
+			Players &pl = players[p];
+			uint8_t bits = pl.input[m];
+			glm::vec2 dir = glm::vec2(0.0f, 0.0f);
+			if (bits & Left) dir.x -= 1.0f;
+			if (bits & Right) dir.x += 1.0f;
+			if (bits & Down) dir.y -= 1.0f;
+			if (bits & Up) dir.y += 1.0f;
+
+			pl.prev_x[m] = pl.x[m];
+			pl.prev_y[m] = pl.y[m];
+			glm::vec2 position = glm::vec2(pl.x[m], pl.y[m]);
+			glm::vec2 velocity = glm::vec2(pl.vx[m], pl.vy[m]);
+			if (p == 0) {
+				Game::move_player(position, velocity, dir, drift, accel, elapsed, Game::Player0Min, Game::Player0Max);
+			} else {
+				Game::move_player(position, velocity, dir, drift, accel, elapsed, Game::Player1Min, Game::Player1Max);
+			}
+			pl.x[m] = position.x;
+			pl.y[m] = position.y;
+			pl.vx[m] = velocity.x;
+			pl.vy[m] = velocity.y;
+		}
+	}
+
+	//move pucks, a run of consecutive moving matches at a time:
+	for (uint32_t m = begin; m < end; ) {
+		if (!moving[m]) {
+			++m;
+			continue;
+		}
+		uint32_t run = m;
+		while (m < end && moving[m]) ++m;
+		pucks.integrate(run * stride, m * stride, elapsed, initial.config.puck_speed, initial.config.puck_retain);
+	}
+
+	//collisions -- the rest of Game::update_state:
+	for (uint32_t m = begin; m < end; ++m) {
+		if (!moving[m]) continue;
+		uint32_t base = m * stride;
+
+		glm::vec2 from[2], to[2];
+		for (uint32_t p = 0; p < 2; ++p) {
+			from[p] = glm::vec2(players[p].prev_x[m], players[p].prev_y[m]);
+			to[p] = glm::vec2(players[p].x[m], players[p].y[m]);
+		}
+		uint32_t which = 0;
+		float t = Game::NoImpact;
+		uint32_t collide_puck = Game::first_contact(pucks, base, count, 2, from, to, &which, &t);
+		if (collide_puck != base + count) {
+			glm::vec2 velocity = glm::vec2(players[which].vx[m], players[which].vy[m]);
+			Game::bounce_puck(pucks, collide_puck, from[which], to[which], velocity, t, elapsed);
+			slice_stats.hits += 1;
+			hit[m] = (which == 0 ? PLAYER_0 : PLAYER_1);
+			pucks.last_hit[collide_puck] = hit[m];
+
+			slice_stats.forks += 1;
+			epoch[m] += 1;
+			Game::fork_pucks(pucks, base, count, collide_puck, initial.fan_cos.data(), initial.fan_sin.data());
+		}
+
+		uint32_t goal = pucks.collide_arena(base, base + count, Game::ArenaMin, Game::ArenaMax, initial.config.goal_radius, Game::PuckRadius, Game::MaxPuckStep);
+		if (goal != base + count) {
+			//(same as Game::handle_scored, with both players present)
+			scored[m] = (pucks.y[goal] < Game::ArenaMin.y ? PLAYER_1 : PLAYER_0);
+			grace_period[m] = GRACE_PERIOD;
+			slice_stats.goals += 1;
+			epoch[m] += 1;
+			Game::collapse_pucks(pucks, base, count, goal);
+			players[scored[m] == PLAYER_0 ? 0 : 1].score[m] += 1;
+			to_serve[m] = (scored[m] == PLAYER_0 ? PLAYER_1 : PLAYER_0);
+		}
+	}
+}
+
+//---------------------------------
+
+void GameBatch::slice(uint32_t index, uint32_t *begin, uint32_t *end) const {
+	uint32_t slices = workers.size() + 1;
+	*begin = uint32_t(uint64_t(matches) * index / slices);
+	*end = uint32_t(uint64_t(matches) * (index + 1) / slices);
+}
+
+void GameBatch::set_threads(uint32_t threads) {
+	//(the calling thread handles slice 0)
+	uint32_t extra = (threads > 1 ? threads - 1 : 0);
+	workers.resize(0, nullptr); //(stop the old workers before their stats go away)
+	worker_stats.assign(extra, Game::Stats());
+	workers.resize(extra, [this](uint32_t i) { worker(i + 1); });
+}
+
+void GameBatch::worker(uint32_t index) {
+	uint32_t begin, end;
+	slice(index, &begin, &end);
+	step_range(begin, end, job.inputs, job.elapsed, job.drift, job.accel, &worker_stats[index - 1]);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * GameBatch steps many independent matches in lockstep (for bots, training,
+ *  and balance testing).
+ *
+ * Matches are stored structure-of-arrays across the whole batch: every match's
+ *  puck copies live in one Pucks (match m owns [m * stride, m * stride + puck_count),
+ *  with 'stride' padded to a multiple of Pucks::Lanes), so the integrate pass covers
+ *  all matches at once with the same SIMD kernels Game uses, and per-match
+ *  player/puck state is in flat per-field arrays.
+ *
+ * step() gives bit-for-bit the same result as Game::update on a Game in the same
+ *  state, since both are built from the same pieces (see "pieces of update()" in
+ *  Game.hpp). Batched matches always have both players present and don't support
+ *  puck/puck collisions or lag compensation.
+ */
+
+#include "Game.hpp"
+#include "WorkerPool.hpp"
+
+#include <vector>
+
+struct GameBatch {
+	GameBatch(uint32_t matches, GameConfig const &config = GameConfig(), bool deterministic = false);
+	~GameBatch();
+
+	uint32_t matches;
+	uint32_t stride; //pucks storage per match
+
+	//settings (config, deterministic) and starting state for every match:
+	Game initial;
+
+	//one match's controls for a step, as bits:
+	enum InputBits : uint8_t {
+		Left = 0x01,
+		Right = 0x02,
+		Up = 0x04,
+		Down = 0x08,
+		Jump = 0x10,
+	};
+	struct Input {
+		uint8_t player_0 = 0;
+		uint8_t player_1 = 0;
+	};
+
+	//advance every match by 'elapsed' ('inputs' has one entry per match):
+	void step(Input const *inputs, float elapsed);
+
+	//start a match over from 'initial' (scores, tick count, and all):
+	void reset(uint32_t match);
+
+	//copy one match to/from a Game (to draw it, save it, or check it against Game::update):
+	void get(uint32_t match, Game *game) const;
+	void set(uint32_t match, Game const &game); //throws if the puck count doesn't match
+
+	//split step() across this many threads, counting the calling thread (1 = no extra threads):
+	void set_threads(uint32_t threads);
+
+	//what happened in each match during the last step():
+	std::vector< PlayerType > hit; //who hit the puck (NEUTRAL if nobody)
+	std::vector< PlayerType > scored; //who scored (NEUTRAL if nobody)
+
+	//running totals over all matches:
+	Game::Stats stats;
+
+	//-- per-match state --
+	struct Players {
+		std::vector< float > x, y, vx, vy, prev_x, prev_y;
+		std::vector< uint32_t > score;
+		std::vector< uint8_t > input; //bits applied in the last step
+	} players[2];
+	Pucks pucks;
+	std::vector< float > grace_period;
+	std::vector< PlayerType > to_serve;
+	std::vector< uint32_t > tick_number;
+	std::vector< uint32_t > epoch;
+	std::vector< double > time;
+
+	//-- internals --
+	std::vector< uint8_t > moving; //scratch: matches not in their grace period this step
+	void step_range(uint32_t begin, uint32_t end, Input const *inputs, float elapsed, float drift, float accel, Game::Stats *stats);
+
+	//worker threads each take one slice of the matches per step (slice 0 is the calling thread's):
+	struct Job {
+		Input const *inputs = nullptr;
+		float elapsed = 0.0f, drift = 0.0f, accel = 0.0f;
+	} job;
+	std::vector< Game::Stats > worker_stats;
+	WorkerPool workers; //pool thread i runs slice i + 1
+	void worker(uint32_t index); //runs slice 'index' of the current step
+	void slice(uint32_t index, uint32_t *begin, uint32_t *end) const;
+};
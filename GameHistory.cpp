@@ -0,0 +1,128 @@
+#include "GameHistory.hpp"
+
+#include "Game.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+void GameHistory::set_length(uint32_t length_) {
+	length = length_;
+	infos.assign(length, Info());
+	if (length == 0) {
+		pucks.clear();
+		pucks.shrink_to_fit();
+	} else {
+		pucks.assign(size_t(length) * Arrays * puck_count, 0.0f);
+	}
+	clear();
+}
+
+void GameHistory::set_puck_count(uint32_t puck_count_) {
+	if (puck_count_ == puck_count) return;
+	//resize storage and drop the (now mismatched) past:
+	puck_count = puck_count_;
+	pucks.assign(size_t(length) * Arrays * puck_count, 0.0f);
+	clear();
+}
+
+void GameHistory::record(Game const &game) {
+	if (length == 0) return;
+
+	set_puck_count(game.pucks.count);
+
+	newest = (recorded == 0 ? 0 : (newest + 1) % length);
+	if (recorded < length) recorded += 1;
+
+	Info &info = infos[newest];
+	info.time = game.time;
+	info.epoch = game.epoch;
+	info.player_position[0] = game.player_0.position;
+	info.player_position[1] = game.player_1.position;
+
+	float *at = slot_pucks(newest);
+	for (std::vector< float > const *array : {&game.pucks.x, &game.pucks.y, &game.pucks.vx, &game.pucks.vy, &game.pucks.prev_x, &game.pucks.prev_y}) {
+		std::memcpy(at, array->data(), puck_count * sizeof(float));
+		at += puck_count;
+	}
+}
+
+GameHistory::Frame GameHistory::frame(uint32_t ago) const {
+	assert(ago < recorded);
+	uint32_t slot = (newest + length - ago) % length;
+	Info const &info = infos[slot];
+	float const *at = slot_pucks(slot);
+
+	Frame ret;
+	ret.time = info.time;
+	ret.epoch = info.epoch;
+	ret.puck_count = puck_count;
+	ret.player_position[0] = info.player_position[0];
+	ret.player_position[1] = info.player_position[1];
+	ret.x = at + 0 * puck_count;
+	ret.y = at + 1 * puck_count;
+	ret.vx = at + 2 * puck_count;
+	ret.vy = at + 3 * puck_count;
+	ret.prev_x = at + 4 * puck_count;
+	ret.prev_y = at + 5 * puck_count;
+	return ret;
+}
+
+void GameHistory::save(std::vector< uint8_t > *bytes_) const {
+	assert(bytes_);
+	auto &bytes = *bytes_;
+
+	//(sized once up front, rather than grown a piece at a time, since recording a replay does this every keyframe)
+	size_t frame_size = sizeof(Info) + size_t(Arrays) * puck_count * sizeof(float);
+	size_t start = bytes.size();
+	bytes.resize(start + sizeof(puck_count) + sizeof(recorded) + size_t(recorded) * frame_size);
+	uint8_t *at = bytes.data() + start;
+	auto put = [&at](void const *data, size_t size) {
+		std::memcpy(at, data, size);
+		at += size;
+	};
+	put(&puck_count, sizeof(puck_count));
+	put(&recorded, sizeof(recorded));
+	//oldest first:
+	for (uint32_t ago = recorded; ago > 0; --ago) {
+		uint32_t slot = (newest + length - (ago - 1)) % length;
+		put(&infos[slot], sizeof(Info));
+		put(slot_pucks(slot), size_t(Arrays) * puck_count * sizeof(float));
+	}
+	assert(at == bytes.data() + bytes.size());
+}
+
+void GameHistory::load(uint8_t const *data, size_t size) {
+	uint32_t count, frames;
+	if (size < sizeof(count) + sizeof(frames)) {
+		throw std::runtime_error("History of " + std::to_string(size) + " bytes is too small to hold a header.");
+	}
+	std::memcpy(&count, data, sizeof(count));
+	std::memcpy(&frames, data + sizeof(count), sizeof(frames));
+	//(checked before anything is sized by it -- even with no frames, the count sizes storage below)
+	if (count == 0 || count > Game::MaxPuckCount) {
+		throw std::runtime_error("History puck count " + std::to_string(count) + " is not in [1," + std::to_string(Game::MaxPuckCount) + "].");
+	}
+	size_t frame_size = sizeof(Info) + size_t(Arrays) * count * sizeof(float);
+	if (size != sizeof(count) + sizeof(frames) + size_t(frames) * frame_size) {
+		throw std::runtime_error("History of " + std::to_string(size) + " bytes doesn't match its " + std::to_string(frames) + " frames of " + std::to_string(count) + " pucks.");
+	}
+
+	set_puck_count(count);
+	clear();
+	if (length == 0) return;
+
+	//skip frames that don't fit:
+	uint8_t const *at = data + sizeof(count) + sizeof(frames);
+	if (frames > length) {
+		at += size_t(frames - length) * frame_size;
+		frames = length;
+	}
+	for (uint32_t i = 0; i < frames; ++i) {
+		newest = i;
+		std::memcpy(&infos[newest], at, sizeof(Info));
+		std::memcpy(slot_pucks(newest), at + sizeof(Info), frame_size - sizeof(Info));
+		at += frame_size;
+	}
+	recorded = frames;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * GameHistory is a ring buffer of the last few ticks of puck and mallet state,
+ *  recorded by Game::update once per tick when it has a nonzero length.
+ *
+ * The server uses it for lag compensation: a player who was looking at an
+ *  older state when they moved gets their mallet checked against the pucks
+ *  they saw (see Game::find_player_collision).
+ *
+ * Storage is sized when the length or the puck count changes (record() also
+ *  catches a count it wasn't told about), so recording is a fixed-size copy
+ *  that never allocates.
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Game;
+
+struct GameHistory {
+	//keep the last 'length' ticks (0 turns recording off and frees storage):
+	void set_length(uint32_t length);
+	uint32_t length = 0;
+
+	//frames hold this many pucks (Game keeps it equal to its own count; changing it forgets everything recorded so far):
+	void set_puck_count(uint32_t puck_count);
+
+	//forget everything recorded so far:
+	void clear() { recorded = 0; }
+
+	//add the state at the end of the tick that was just simulated:
+	void record(Game const &game);
+
+	//number of ticks available (at most 'length'):
+	uint32_t size() const { return recorded; }
+
+	//state at the end of a past tick ('ago' = 0 is the most recent) and the step that led to it:
+	struct Frame {
+		double time;
+		uint32_t epoch;
+		uint32_t puck_count;
+		glm::vec2 player_position[2];
+		//puck arrays, each puck_count long:
+		float const *x, *y, *vx, *vy, *prev_x, *prev_y;
+	};
+	Frame frame(uint32_t ago) const;
+
+	//append everything recorded so far to 'bytes' (e.g., to save alongside a GameSnapshot):
+	void save(std::vector< uint8_t > *bytes) const;
+	//replace the recorded ticks with ones from save() (keeping only the newest 'length'); throws if malformed:
+	void load(uint8_t const *data, size_t size);
+
+	//-- internals --
+	struct Info {
+		double time = 0.0;
+		uint32_t epoch = 0;
+		glm::vec2 player_position[2] = {glm::vec2(0.0f), glm::vec2(0.0f)};
+	};
+	std::vector< Info > infos; //one per slot
+	std::vector< float > pucks; //per slot: x, y, vx, vy, prev_x, prev_y arrays of 'puck_count' each
+	uint32_t puck_count = 0; //(0 only until a Game sets it)
+	uint32_t newest = 0; //slot of the most recent record
+	uint32_t recorded = 0;
+
+	static constexpr uint32_t Arrays = 6;
+	float *slot_pucks(uint32_t slot) { return pucks.data() + size_t(slot) * Arrays * puck_count; }
+	float const *slot_pucks(uint32_t slot) const { return pucks.data() + size_t(slot) * Arrays * puck_count; }
+};
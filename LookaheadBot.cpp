@@ -0,0 +1,179 @@
+#include "LookaheadBot.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+LookaheadBot::LookaheadBot(PlayerType type_, uint32_t thread_count, float budget_) : type(type_), budget(budget_) {
+	assert(type == PLAYER_0 || type == PLAYER_1);
+	if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	PlayerType opponent = (type == PLAYER_0 ? PLAYER_1 : PLAYER_0);
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		workers.emplace_back(std::make_unique< Worker >());
+		Worker &worker = *workers.back();
+		worker.self = BotController(type);
+		worker.other = BotController(opponent);
+		worker.random = 0x9e3779b97f4a7c15ull * (i + 1); //(any nonzero seed will do)
+	}
+
+	//the calling thread runs workers[0]:
+	threads.resize(thread_count - 1, [this](uint32_t i) { run(*workers[i + 1]); });
+}
+
+LookaheadBot::~LookaheadBot() {
+	threads.resize(0, nullptr); //(stop the threads before the workers they're using go away)
+}
+
+uint32_t LookaheadBot::Worker::next_random() {
+	random ^= random << 13;
+	random ^= random >> 7;
+	random ^= random << 17;
+	return uint32_t(random >> 32);
+}
+
+void LookaheadBot::press(glm::ivec2 dir, PlayerType type, Player::Controls *controls) {
+	assert(controls);
+	controls->left.pressed = (dir.x < 0);
+	controls->right.pressed = (dir.x > 0);
+	//(bot space is PLAYER_0's view, so PLAYER_1 has up and down swapped)
+	controls->up.pressed = (type == PLAYER_0 ? dir.y > 0 : dir.y < 0);
+	controls->down.pressed = (type == PLAYER_0 ? dir.y < 0 : dir.y > 0);
+}
+
+void LookaheadBot::update(Game const &game, Player::Controls *controls) {
+	assert(controls);
+	auto before = std::chrono::steady_clock::now();
+
+	//nobody can move during the grace period after a goal, so there's nothing to decide:
+	if (game.grace_period > 0.0f) {
+		choice = Directions;
+		workers[0]->self.update(game, controls);
+		return;
+	}
+
+	//set up the clones (the threads are all idle, so the calling thread can touch their workers):
+	game.save(snapshot);
+	for (auto &w : workers) {
+		Game &sim = w->sim;
+		if (sim.deterministic != game.deterministic) sim.set_deterministic(game.deterministic);
+		//(GameConfig is plain numbers, so comparing bytes is enough -- and GameConfig::get would allocate names)
+		if (std::memcmp(&sim.config, &game.config, sizeof(GameConfig)) != 0) sim.set_config(game.config);
+		sim.puck_collisions = game.puck_collisions;
+		w->rollouts = 0;
+		w->ticks = 0;
+		w->total.fill(0.0f);
+		w->count.fill(0);
+	}
+	deadline = before + std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< float >(budget));
+	next_rollout.store(0, std::memory_order_relaxed);
+
+	//start the other threads...
+	threads.begin();
+
+	//...do rollouts here too...
+	run(*workers[0]);
+
+	//...and wait for the rest:
+	threads.wait();
+
+	//pick the candidate with the best average:
+	std::array< float, Candidates > total;
+	std::array< uint32_t, Candidates > count;
+	total.fill(0.0f);
+	count.fill(0);
+	uint32_t rollouts = 0;
+	for (auto const &w : workers) {
+		for (uint32_t c = 0; c < Candidates; ++c) {
+			total[c] += w->total[c];
+			count[c] += w->count[c];
+		}
+		rollouts += w->rollouts;
+		stats.rollout_ticks += w->ticks;
+	}
+	//(playing as a BotController is the default; a direction has to beat it by 'margin', since
+	// when nothing much happens within the horizon all the candidates score about the same)
+	choice = Directions;
+	float best = total[Directions] / std::max(1u, count[Directions]) + margin;
+	for (uint32_t c = 0; c < Directions; ++c) {
+		if (count[c] == 0) continue;
+		float mean = total[c] / count[c];
+		if (mean > best) {
+			best = mean;
+			choice = c;
+		}
+	}
+
+	if (choice < Directions) press(Direction[choice], type, controls);
+	else workers[0]->self.update(game, controls);
+
+	auto after = std::chrono::steady_clock::now();
+	float latency = std::chrono::duration< float >(after - before).count();
+	stats.decisions += 1;
+	stats.rollouts += rollouts;
+	stats.seconds += latency;
+	stats.last_rollouts = rollouts;
+	stats.last_latency = latency;
+}
+
+void LookaheadBot::run(Worker &worker) {
+	while (true) {
+		//(the first round of candidates always runs, so even a tiny budget tries each one once)
+		uint32_t index = next_rollout.fetch_add(1, std::memory_order_relaxed);
+		if (index >= Candidates && std::chrono::steady_clock::now() >= deadline) break;
+		uint32_t candidate = index % Candidates;
+		worker.total[candidate] += rollout(worker, candidate);
+		worker.count[candidate] += 1;
+		worker.rollouts += 1;
+	}
+}
+
+float LookaheadBot::rollout(Worker &worker, uint32_t candidate) const {
+	Game &sim = worker.sim;
+	sim.load(snapshot);
+
+	PlayerType opponent = (type == PLAYER_0 ? PLAYER_1 : PLAYER_0);
+	Player &self = (type == PLAYER_0 ? sim.player_0 : sim.player_1);
+	Player &other = (type == PLAYER_0 ? sim.player_1 : sim.player_0);
+	unsigned int self_score = self.score;
+	unsigned int other_score = other.score;
+
+	uint32_t steps = std::max(1u, uint32_t(std::round(horizon / step)));
+	uint32_t hold_steps = std::max(1u, uint32_t(std::round(hold / step)));
+
+	//the opponent either plays like a BotController or mashes a random direction every 'hold' seconds:
+	bool random_opponent = (worker.next_random() & 1);
+	glm::ivec2 other_dir = glm::ivec2(0);
+
+	uint32_t s = 0;
+	for (; s < steps; ++s) {
+		if (candidate < Directions && s < hold_steps) press(Direction[candidate], type, &self.controls);
+		else worker.self.update(sim, &self.controls);
+
+		if (random_opponent) {
+			if (s % hold_steps == 0) other_dir = Direction[worker.next_random() % Directions];
+			press(other_dir, opponent, &other.controls);
+		} else {
+			worker.other.update(sim, &other.controls);
+		}
+
+		sim.update(step);
+		if (self.score != self_score || other.score != other_score) {
+			s += 1;
+			break;
+		}
+	}
+	worker.ticks += s;
+
+	//a goal outweighs anything else:
+	float goals = (float(self.score) - float(self_score)) - (float(other.score) - float(other_score));
+	if (goals != 0.0f) return 10.0f * goals;
+
+	//otherwise, the further the copies are toward the other goal (and the faster they're headed there) the better:
+	float flip = (type == PLAYER_0 ? 1.0f : -1.0f);
+	float value = 0.0f;
+	for (uint32_t i = 0; i < sim.pucks.count; ++i) {
+		value += flip * (sim.pucks.y[i] + 0.25f * sim.pucks.vy[i]);
+	}
+	return value / (Game::ArenaMax.y * sim.pucks.count);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/*
+ * LookaheadBot plays one side of a Game by trying things out: every decision it saves the
+ *  game to a GameSnapshot, loads that into a private Game per thread, and rolls Game::update
+ *  forward a few hundred milliseconds for each of a handful of candidate moves (hold one of
+ *  the eight directions -- or nothing -- for a moment, then play on as a BotController would;
+ *  or just play as a BotController). The opponent in each rollout is picked at random: either
+ *  a BotController or someone mashing random directions.
+ *
+ * Rollouts are scored by goals (heavily) and by where the puck copies end up, and the
+ *  candidate with the best average wins. Rollouts are handed out round-robin over the
+ *  candidates to a pool of threads until a fixed time budget runs out, so a decision takes
+ *  about 'budget' seconds however fast the machine is; faster machines just try more rollouts.
+ *
+ * Loading a snapshot is a memcpy into arrays the clone already has (spectators, history, and
+ *  stats aren't copied), so after the first decision nothing allocates.
+ */
+
+#include "BotController.hpp"
+#include "Game.hpp"
+#include "WorkerPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct LookaheadBot {
+	//play as 'type' (PLAYER_0 or PLAYER_1), spreading rollouts over 'threads' threads counting
+	// the calling thread (0 = one per hardware thread), spending about 'budget' seconds per decision:
+	explicit LookaheadBot(PlayerType type = PLAYER_0, uint32_t threads = 0, float budget = 0.005f);
+	~LookaheadBot();
+	LookaheadBot(LookaheadBot const &) = delete;
+	LookaheadBot &operator=(LookaheadBot const &) = delete;
+	PlayerType type;
+
+	//decide what to do next in 'game' and set the pressed state of 'controls' to match:
+	// (blocks for about 'budget' seconds; doesn't touch downs, seq, or view_time)
+	void update(Game const &game, Player::Controls *controls);
+
+	//tuning:
+	float budget; //seconds to spend on each decision
+	float horizon = 0.4f; //seconds each rollout simulates
+	float hold = 0.1f; //seconds a candidate direction is held before playing on as a BotController
+	float margin = 0.02f; //how much better (in average rollout value) a direction must do than playing as a BotController
+	float step = Game::Tick; //update() length used in rollouts (should match the real game's)
+
+	//candidates: directions (bot space, so +y is toward the other goal), then "just play as a BotController":
+	inline static constexpr uint32_t Directions = 9;
+	inline static constexpr uint32_t Candidates = Directions + 1;
+	inline static constexpr glm::ivec2 Direction[Directions] = {
+		glm::ivec2( 0, 0),
+		glm::ivec2(-1, 0), glm::ivec2( 1, 0), glm::ivec2( 0,-1), glm::ivec2( 0, 1),
+		glm::ivec2(-1,-1), glm::ivec2( 1,-1), glm::ivec2(-1, 1), glm::ivec2( 1, 1),
+	};
+	uint32_t choice = Directions; //candidate picked by the last decision
+
+	//how decisions are going (for benchmarks):
+	struct Stats {
+		uint64_t decisions = 0;
+		uint64_t rollouts = 0;
+		uint64_t rollout_ticks = 0; //Game::update calls made by rollouts
+		double seconds = 0.0; //wall-clock time spent deciding
+		uint32_t last_rollouts = 0; //in the last decision
+		float last_latency = 0.0f; //seconds the last decision took
+	} stats;
+
+	//press the buttons that move a 'type' player in bot-space direction 'dir':
+	static void press(glm::ivec2 dir, PlayerType type, Player::Controls *controls);
+
+	//-- internals --
+	GameSnapshot snapshot; //the state being decided on
+
+	//everything one thread needs to run rollouts (allocated separately, so threads don't share cache lines):
+	struct Worker {
+		Game sim;
+		BotController self, other;
+		uint64_t random = 0; //xorshift64 state
+		uint32_t rollouts = 0;
+		uint64_t ticks = 0;
+		std::array< float, Candidates > total; //sum of rollout values per candidate
+		std::array< uint32_t, Candidates > count; //rollouts per candidate
+		uint32_t next_random();
+	};
+	std::vector< std::unique_ptr< Worker > > workers; //[0] is run by the calling thread
+	float rollout(Worker &worker, uint32_t candidate) const; //value of one rollout (higher is better for 'type')
+	void run(Worker &worker); //do rollouts until the decision's deadline
+
+	//the current decision, shared by the threads:
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic< uint32_t > next_rollout{0};
+
+	WorkerPool threads; //pool thread i runs workers[i + 1]
+};
@@ -56,6 +56,7 @@ if (maek.OS === "windows") {
 } else if (maek.OS === "linux") {
 	maek.options.CPPFlags.push(
 		`-O2`, //optimize
+		`-ffp-contract=off`, //no fused multiply-add, so Game's deterministic mode matches across compilers/CPUs
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
@@ -80,6 +81,7 @@ if (maek.OS === "windows") {
 } else if (maek.OS === "macos") {
 	maek.options.CPPFlags.push(
 		`-O2`, //optimize
+		`-ffp-contract=off`, //no fused multiply-add, so Game's deterministic mode matches across compilers/CPUs
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
@@ -138,6 +140,8 @@ if (maek.OS === 'windows') {
 const client_names = [
 	maek.CPP('client.cpp'),
 	maek.CPP('PlayMode.cpp'),
+	maek.CPP('ReplayMode.cpp'),
+	maek.CPP('PartyMode.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp'),
 	//maek.CPP('ColorTextureProgram.cpp'),  //not used right now, but you might want it
 	maek.CPP('Sound.cpp'),
@@ -149,8 +153,41 @@ const server_names = [
 	maek.CPP('server.cpp')
 ];
 
-const common_names = [
+//the server's rooms (also ticked by bench-game):
+const room_names = [
+	maek.CPP('Room.cpp')
+];
+
+//simulation code (no graphics or networking dependencies)...
+// ...just what a Game needs:
+const sim_names = [
 	maek.CPP('Game.cpp'),
+	maek.CPP('GameHistory.cpp'),
+	maek.CPP('Pucks.cpp'),
+	maek.CPP('PuckGrid.cpp')
+];
+// ...recording and playing back replays:
+const replay_names = [
+	maek.CPP('Replay.cpp')
+];
+// ...and everything built on top:
+const game_names = [
+	...sim_names,
+	...replay_names,
+	maek.CPP('GameBatch.cpp'),
+	maek.CPP('BotController.cpp'),
+	maek.CPP('LookaheadBot.cpp'),
+	maek.CPP('PartyGame.cpp')
+];
+
+//networking code (no graphics dependencies either):
+const net_names = [
+	maek.CPP('Connection.cpp')
+];
+
+const common_names = [
+	...game_names,
+	...net_names,
 	maek.CPP('data_path.cpp'),
 	maek.CPP('PathFont.cpp'),
 	maek.CPP('PathFont-font.cpp'),
@@ -163,7 +200,6 @@ const common_names = [
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
 	maek.CPP('Load.cpp'),
-	maek.CPP('Connection.cpp'),
 	maek.CPP('hex_dump.cpp')
 ];
 
@@ -179,18 +215,46 @@ const show_scene_names = [
 	maek.CPP('ShowSceneMode.cpp')
 ];
 
+const bench_game_names = [
+	maek.CPP('bench-game.cpp')
+];
+
+const bench_sim_names = [
+	maek.CPP('bench-sim.cpp')
+];
+
+const bench_net_names = [
+	maek.CPP('bench-net.cpp')
+];
+
+const sweep_names = [
+	maek.CPP('sweep.cpp')
+];
+
 //the '[exeFile =] LINK(objFiles, exeFileBase, [, options])' links an array of objects into an executable:
 // objFiles: array of objects to link
 // exeFileBase: name of executable file to produce
 //returns exeFile: exeFileBase + a platform-dependant suffix (e.g., '.exe' on windows)
 const client_exe = maek.LINK([...client_names, ...common_names], 'dist/client');
-const server_exe = maek.LINK([...server_names, ...common_names], 'dist/server');
+const server_exe = maek.LINK([...server_names, ...room_names, ...common_names], 'dist/server');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+const bench_game_exe = maek.LINK([...bench_game_names, ...room_names, ...game_names], 'bench/bench-game');
+const bench_sim_exe = maek.LINK([...bench_sim_names, ...sim_names, ...replay_names], 'bench/bench-sim'); //(replays for --record)
+const bench_net_exe = maek.LINK([...bench_net_names, ...net_names], 'bench/bench-net');
+const sweep_exe = maek.LINK([...sweep_names, ...game_names], 'tools/sweep');
 
 //set the default target to the game (and copy the readme files):
 maek.TARGETS = [client_exe, server_exe, show_meshes_exe, show_scene_exe, ...copies];
 
+//benchmarks are built on request:
+// $ node Maekfile.js :bench && ./bench/bench-game && ./bench/bench-sim && ./bench/bench-net
+maek.RULE([':bench'], [bench_game_exe, bench_sim_exe, bench_net_exe]);
+
+//so are the tools for tuning the game:
+// $ node Maekfile.js :tools && ./tools/sweep --help
+maek.RULE([':tools'], [sweep_exe]);
+
 //the '[targets =] RULE(targets, prerequisites[, recipe])' rule defines a Makefile-style task
 // targets: array of targets the task produces (can include both files and ':abstract targets')
 // prerequisites: array of targets the task waits on (can include both files and ':abstract targets')
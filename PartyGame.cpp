@@ -0,0 +1,392 @@
+#include "PartyGame.hpp"
+
+#include "Connection.hpp"
+
+#include <glm/gtx/norm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+PartyGame::PartyGame(uint32_t players_, GameConfig const &config_) : config(config_) {
+	config.validate();
+	pucks.resize(config.puck_count);
+	last_hit.assign(pucks.x.size(), NoHit);
+	Game::build_fan_table(pucks.count, config.fan_angle, false, &fan_cos, &fan_sin);
+	set_players(players_);
+}
+
+void PartyGame::set_players(uint32_t players_) {
+	if (players_ < MinPlayers || players_ > MaxPlayers) {
+		throw std::runtime_error("Party player count " + std::to_string(players_) + " is not in [" + std::to_string(MinPlayers) + "," + std::to_string(MaxPlayers) + "].");
+	}
+	players = players_;
+
+	//sides go counterclockwise from the bottom (where side 0 sits, like PLAYER_0):
+	float wedge = 3.14159265358979f / players; //half the angle each side takes up
+	normal.clear();
+	tangent.clear();
+	for (uint32_t side = 0; side < players; ++side) {
+		float angle = -0.5f * 3.14159265358979f + 2.0f * wedge * side;
+		glm::vec2 n = glm::vec2(std::cos(angle), std::sin(angle));
+		normal.emplace_back(n);
+		tangent.emplace_back(-n.y, n.x);
+	}
+
+	//far enough out that each zone (ArenaMax.x wide on either side of the middle, out to
+	// Player0Max) fits in its side's wedge even at the zone's inner edge:
+	radius = (Game::Player0Max - Game::Player0Min) + Game::ArenaMax.x / std::tan(wedge);
+
+	mallets.assign(players, Mallet());
+	current.reserve(players);
+	current_from.reserve(players);
+	current_to.reserve(players);
+
+	//cover the whole polygon, goal mouths included:
+	float extent = radius / std::cos(wedge) + 0.5f;
+	grid.setup(glm::vec2(-extent), glm::vec2(extent), 0.5f);
+
+	to_serve = 0;
+	grace_period = 0.0f;
+	reset(to_serve);
+}
+
+uint32_t PartyGame::spawn_player() {
+	for (uint32_t side = 0; side < players; ++side) {
+		if (!mallets[side].present) {
+			mallets[side].present = true;
+			return side;
+		}
+	}
+	return NoSide;
+}
+
+void PartyGame::remove_player(uint32_t side) {
+	assert(side < players && mallets[side].present);
+	Mallet &mallet = mallets[side];
+	mallet.present = false;
+	//(whoever takes the side next starts fresh, not with this player's buttons or seq)
+	mallet.controls = Player::Controls();
+	mallet.velocity = glm::vec2(0.0f);
+}
+
+void PartyGame::reset(uint32_t serve) {
+	assert(serve < players);
+	epoch += 1;
+	for (Mallet &mallet : mallets) {
+		mallet.position = Game::Player0Start;
+		mallet.controls.reset();
+	}
+
+	glm::vec2 at = to_world(serve, glm::vec2(0.0f, Game::Player0Min + ServeDepth));
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		pucks.set_position(i, at);
+		pucks.set_velocity(i, glm::vec2(0.0f));
+		pucks.prev_x[i] = at.x;
+		pucks.prev_y[i] = at.y;
+		last_hit[i] = NoHit;
+	}
+}
+
+void PartyGame::update(float elapsed) {
+	tick_number += 1;
+	time += elapsed;
+
+	//same grace period after a goal as Game:
+	bool was_grace = grace_period > 0.0f;
+	if (was_grace) {
+		grace_period = std::max(0.0f, grace_period - elapsed);
+	}
+	if (grace_period > 0.0f) return;
+	if (was_grace) reset(to_serve);
+
+	//move every mallet in its own frame (the same as PLAYER_0's half of the two-player arena):
+	float drift, accel;
+	Game::player_blend(elapsed, config.player_accel_halflife, false, &drift, &accel);
+	current.clear();
+	current_from.clear();
+	current_to.clear();
+	for (uint32_t side = 0; side < players; ++side) {
+		Mallet &mallet = mallets[side];
+		mallet.prev_position = mallet.position;
+		Player::Controls &c = mallet.controls;
+		glm::vec2 dir = glm::vec2(float(c.right.pressed) - float(c.left.pressed), float(c.up.pressed) - float(c.down.pressed));
+		Game::move_player(mallet.position, mallet.velocity, dir, drift, accel, elapsed, Game::Player0Min, Game::Player0Max);
+		c.reset();
+
+		if (mallet.present) {
+			current.emplace_back(side);
+			current_from.emplace_back(to_world(side, mallet.prev_position));
+			current_to.emplace_back(to_world(side, mallet.position));
+		}
+	}
+
+	pucks.integrate(elapsed, config.puck_speed, config.puck_retain);
+
+	//puck/mallet collisions (only the first copy to touch a mallet counts, and forks the rest):
+	bool use_grid = (pucks.count * uint32_t(current.size()) >= GridMinChecks);
+	if (use_grid) grid.build(pucks);
+	Contact contact = find_contact(use_grid);
+	if (contact.puck != pucks.count) {
+		Mallet const &mallet = mallets[contact.side];
+		Game::bounce_puck(pucks, contact.puck, to_world(contact.side, mallet.prev_position), to_world(contact.side, mallet.position),
+			to_world_direction(contact.side, mallet.velocity), contact.t, elapsed);
+		stats.hits += 1;
+
+		stats.forks += 1;
+		epoch += 1;
+		Game::fork_pucks(pucks, 0, pucks.count, contact.puck, fan_cos.data(), fan_sin.data());
+		std::fill(last_hit.begin(), last_hit.begin() + pucks.count, uint8_t(contact.side));
+	}
+
+	//puck/arena collisions:
+	uint32_t side = NoSide;
+	uint32_t scored = collide_arena(&side);
+	if (scored != pucks.count) {
+		grace_period = GRACE_PERIOD;
+		stats.goals += 1;
+		epoch += 1;
+		Game::collapse_pucks(pucks, 0, pucks.count, scored);
+
+		//against the side it went in, for whoever hit it last (unless that was the same side):
+		mallets[side].conceded += 1;
+		uint8_t hitter = last_hit[scored];
+		if (hitter != NoHit && hitter != side) mallets[hitter].score += 1;
+		to_serve = side;
+	}
+}
+
+PartyGame::Contact PartyGame::find_contact(bool use_grid) const {
+	Contact first;
+	first.puck = pucks.count;
+	if (current.empty()) return first;
+
+	if (!use_grid) {
+		uint32_t which = 0;
+		first.puck = Game::first_contact(pucks, 0, pucks.count, uint32_t(current.size()), current_from.data(), current_to.data(), &which, &first.t);
+		if (first.puck != pucks.count) first.side = current[which];
+		return first;
+	}
+
+	//earliest contact wins (ties go to the lower puck index, then the lower side, as in Game::first_contact):
+	uint32_t first_which = 0;
+	grid.query_swept(pucks, uint32_t(current.size()), current_from.data(), current_to.data(), Game::PlayerRadius + Game::PuckRadius, [&](uint32_t which, uint32_t i) {
+		float t = Game::time_of_impact(glm::vec2(pucks.prev_x[i], pucks.prev_y[i]), pucks.position(i), current_from[which], current_to[which]);
+		if (t == Game::NoImpact) return;
+		if (t < first.t || (t == first.t && (i < first.puck || (i == first.puck && which < first_which)))) {
+			first.puck = i;
+			first.t = t;
+			first_which = which;
+		}
+	});
+	if (first.puck != pucks.count) first.side = current[first_which];
+	return first;
+}
+
+uint32_t PartyGame::collide_arena(uint32_t *side_) {
+	assert(side_);
+	float const wall = radius - Game::PuckRadius; //puck centers further out than this touch a wall
+	float const mouth = config.goal_radius - Game::PuckRadius; //and closer to the middle than this fit through the goal
+	uint32_t scored = pucks.count;
+
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		glm::vec2 p = pucks.position(i);
+		//(most copies are well inside the walls)
+		if (glm::length2(p) <= wall * wall) continue;
+
+		glm::vec2 v = pucks.velocity(i);
+		glm::vec2 prev = glm::vec2(pucks.prev_x[i], pucks.prev_y[i]);
+		for (uint32_t side = 0; side < players; ++side) {
+			glm::vec2 const &n = normal[side];
+			glm::vec2 const &t = tangent[side];
+			float d = glm::dot(p, n);
+			if (d <= wall) continue;
+
+			float u = glm::dot(p, t);
+			if (std::abs(u) <= mouth) {
+				//in the goal mouth; entirely past the goal line is a goal:
+				if (d > radius + Game::PuckRadius && scored == pucks.count) {
+					scored = i;
+					*side_ = side;
+				}
+				continue;
+			}
+
+			if (glm::dot(prev, n) > wall && std::abs(glm::dot(prev, t)) <= mouth) {
+				//was already in the mouth, so it hit the inside of a post -- bounce back toward the middle of the goal:
+				float post = (u < 0.0f ? -mouth : mouth);
+				p += 2.0f * (post - u) * t;
+				float along = glm::dot(v, t);
+				if (along * u > 0.0f) v -= 2.0f * along * t;
+			} else {
+				//hit the wall (or the outside of a post):
+				p -= 2.0f * (d - wall) * n;
+				float out = glm::dot(v, n);
+				if (out > 0.0f) v -= 2.0f * out * n;
+			}
+		}
+		pucks.set_position(i, p);
+		pucks.set_velocity(i, v);
+	}
+	return scored;
+}
+
+void PartyGame::send_state_message(Connection *connection_) const {
+	assert(connection_);
+	auto &connection = *connection_;
+
+	connection.send(Message::S2C_PartyState);
+	//will patch message size in later, for now placeholder bytes:
+	connection.send(uint8_t(0));
+	connection.send(uint8_t(0));
+	connection.send(uint8_t(0));
+	size_t mark = connection.send_buffer.size(); //keep track of this position in the buffer
+
+	connection.send(time);
+	connection.send(epoch);
+	connection.send(grace_period);
+
+	//players (positions are in each side's own frame):
+	connection.send(uint8_t(players));
+	for (Mallet const &mallet : mallets) {
+		connection.send(uint8_t(mallet.present));
+		connection.send(mallet.position);
+		connection.send(mallet.velocity);
+		connection.send(mallet.score);
+		connection.send(mallet.conceded);
+	}
+
+	//pucks:
+	connection.send(pucks.count);
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		connection.send(pucks.position(i));
+		connection.send(pucks.velocity(i));
+		connection.send(last_hit[i]);
+	}
+
+	//compute the message size and patch into the message header:
+	uint32_t size = uint32_t(connection.send_buffer.size() - mark);
+	connection.send_buffer[mark-3] = uint8_t(size);
+	connection.send_buffer[mark-2] = uint8_t(size >> 8);
+	connection.send_buffer[mark-1] = uint8_t(size >> 16);
+}
+
+bool PartyGame::recv_state_message(Connection *connection_) {
+	assert(connection_);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	if (recv_buffer.size() < 4) return false;
+	if (recv_buffer[0] != uint8_t(Message::S2C_PartyState)) return false;
+	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
+	              | (uint32_t(recv_buffer[2]) << 8)
+	              |  uint32_t(recv_buffer[1]);
+	uint32_t at = 0;
+	//expecting complete message:
+	if (recv_buffer.size() < 4 + size) return false;
+
+	//copy bytes from buffer and advance position:
+	auto read = [&](auto *val) {
+		if (at + sizeof(*val) > size) {
+			throw std::runtime_error("Ran out of bytes reading party state message.");
+		}
+		std::memcpy(static_cast< void * >(val), &recv_buffer[4 + at], sizeof(*val));
+		at += sizeof(*val);
+	};
+
+	double new_time;
+	uint32_t new_epoch;
+	float new_grace_period;
+	read(&new_time);
+	read(&new_epoch);
+	read(&new_grace_period);
+
+	uint8_t player_count;
+	read(&player_count);
+	if (player_count < MinPlayers || player_count > MaxPlayers) {
+		throw std::runtime_error("Party state message has " + std::to_string(player_count) + " players.");
+	}
+	if (player_count != players) set_players(player_count); //(resets everything, so the header is applied after)
+	time = new_time;
+	epoch = new_epoch;
+	grace_period = new_grace_period;
+	for (Mallet &mallet : mallets) {
+		uint8_t present;
+		read(&present);
+		mallet.present = (present != 0);
+		read(&mallet.position);
+		read(&mallet.velocity);
+		read(&mallet.score);
+		read(&mallet.conceded);
+	}
+
+	uint32_t puck_count;
+	read(&puck_count);
+	if (puck_count == 0 || puck_count > Game::MaxPuckCount) {
+		throw std::runtime_error("Party state message has " + std::to_string(puck_count) + " pucks.");
+	}
+	if (puck_count != pucks.count) {
+		pucks.resize(puck_count);
+		last_hit.assign(pucks.x.size(), NoHit);
+		config.puck_count = puck_count;
+		Game::build_fan_table(pucks.count, config.fan_angle, false, &fan_cos, &fan_sin);
+	}
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		glm::vec2 position, velocity;
+		read(&position);
+		read(&velocity);
+		read(&last_hit[i]);
+		if (last_hit[i] != NoHit && last_hit[i] >= players) {
+			throw std::runtime_error("Party state message has a puck hit by side " + std::to_string(last_hit[i]) + ".");
+		}
+		pucks.set_position(i, position);
+		pucks.set_velocity(i, velocity);
+	}
+
+	if (at != size) throw std::runtime_error("Trailing data in party state message.");
+
+	//delete message from buffer:
+	recv_buffer.consume(4 + size);
+
+	return true;
+}
+
+void PartyGame::send_ack_message(Connection *connection_, uint32_t side, uint32_t seq) {
+	assert(connection_);
+	auto &connection = *connection_;
+	assert(side < MaxPlayers || side == NoSide);
+
+	uint32_t size = 1 + 4;
+	connection.send(Message::S2C_Ack);
+	connection.send(uint8_t(size));
+	connection.send(uint8_t(size >> 8));
+	connection.send(uint8_t(size >> 16));
+
+	connection.send(uint8_t(side == NoSide ? NoHit : side));
+	connection.send(seq);
+}
+
+bool PartyGame::recv_ack_message(Connection *connection_, uint32_t *side, uint32_t *seq) {
+	assert(connection_);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	if (recv_buffer.size() < 4) return false;
+	if (recv_buffer[0] != uint8_t(Message::S2C_Ack)) return false;
+	uint32_t size = (uint32_t(recv_buffer[3]) << 16)
+	              | (uint32_t(recv_buffer[2]) << 8)
+	              |  uint32_t(recv_buffer[1]);
+	if (size != 5) throw std::runtime_error("Ack message with size " + std::to_string(size) + " != 5!");
+	if (recv_buffer.size() < 4 + size) return false;
+
+	if (recv_buffer[4] >= MaxPlayers && recv_buffer[4] != NoHit) throw std::runtime_error("Ack message with bad side " + std::to_string(recv_buffer[4]) + ".");
+	*side = (recv_buffer[4] == NoHit ? NoSide : recv_buffer[4]);
+	std::memcpy(seq, &recv_buffer[5], sizeof(*seq));
+
+	recv_buffer.consume(4 + size);
+
+	return true;
+}
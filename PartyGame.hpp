@@ -0,0 +1,134 @@
+#pragma once
+
+/*
+ * PartyGame is a free-for-all version of Game for 3-16 players: the arena is a regular
+ *  polygon with one side (and one goal, in the middle of that side) per player.
+ *
+ * Each mallet moves in its own side's frame, which is exactly PLAYER_0's half of the
+ *  two-player arena (x in ArenaMin.x..ArenaMax.x, y in Player0Min..Player0Max, with the goal
+ *  at y = Player0Min), so mallets move with Game::move_player just like in the two-player game.
+ *  The polygon is sized so that every side's zone fits inside its own wedge of the arena,
+ *  so zones never overlap.
+ *
+ * Pucks are the same superposed copies as in Game (the same Pucks passes and fork/collapse
+ *  helpers), and the first mallet to touch any copy forks them all. With many mallets and
+ *  copies the puck/mallet checks go through a PuckGrid broadphase, so each mallet only looks
+ *  at the copies near it, rather than every mallet being checked against every copy.
+ *
+ * A goal counts against the side it went into and for whoever hit the puck last.
+ *  The state message carries the player count, so it grows with the number of players.
+ *  The server hosts party rooms with --party, and ./client --party plays in them (PartyMode).
+ */
+
+#include "Game.hpp"
+#include "PuckGrid.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Connection;
+
+struct PartyGame {
+	//'players' sides (throws if not in [MinPlayers, MaxPlayers], or if 'config' is invalid):
+	explicit PartyGame(uint32_t players, GameConfig const &config = GameConfig());
+
+	GameConfig config; //(puck_collisions and deterministic mode aren't supported in party mode)
+
+	//---- arena ----
+	uint32_t players = 0;
+	float radius = 0.0f; //from the center to the middle of each side
+	//per side: unit vector out through the middle of the side, and along the side (local +x):
+	std::vector< glm::vec2 > normal, tangent;
+
+	//convert between a side's frame (see above) and the arena:
+	glm::vec2 to_world(uint32_t side, glm::vec2 const &local) const {
+		return local.x * tangent[side] + (radius + Game::Player0Min - local.y) * normal[side];
+	}
+	glm::vec2 to_world_direction(uint32_t side, glm::vec2 const &local) const {
+		return local.x * tangent[side] - local.y * normal[side];
+	}
+	glm::vec2 to_local(uint32_t side, glm::vec2 const &world) const {
+		return glm::vec2(glm::dot(world, tangent[side]), radius + Game::Player0Min - glm::dot(world, normal[side]));
+	}
+	glm::vec2 to_local_direction(uint32_t side, glm::vec2 const &world) const {
+		return glm::vec2(glm::dot(world, tangent[side]), -glm::dot(world, normal[side]));
+	}
+
+	//---- mallets (one per side) ----
+	struct Mallet {
+		Player::Controls controls;
+		//in the side's own frame:
+		glm::vec2 position = Game::Player0Start;
+		glm::vec2 velocity = glm::vec2(0.0f);
+		glm::vec2 prev_position = Game::Player0Start;
+		bool present = false; //someone is playing this side (empty sides don't block pucks)
+		uint32_t score = 0; //goals scored into other sides
+		uint32_t conceded = 0; //goals let in
+	};
+	std::vector< Mallet > mallets;
+
+	//take the first empty side (returns NoSide if the game is full) or give one up:
+	uint32_t spawn_player();
+	void remove_player(uint32_t side);
+	inline static constexpr uint32_t NoSide = ~0u;
+
+	//---- pucks ----
+	Pucks pucks; //(in arena coordinates; pucks.last_hit isn't used)
+	std::vector< uint8_t > last_hit; //side that last hit each copy, or NoHit
+	inline static constexpr uint8_t NoHit = 0xff;
+	std::vector< float > fan_cos, fan_sin;
+
+	uint32_t to_serve = 0; //side the next serve goes to
+	float grace_period = 0.0f;
+	uint32_t tick_number = 0;
+	double time = 0.0;
+	uint32_t epoch = 0;
+	Game::Stats stats;
+
+	//---- update ----
+	void update(float elapsed);
+	void reset(uint32_t serve); //mallets back to their starts, pucks to 'serve's side
+
+	//earliest contact between a copy and a present mallet this step (puck == pucks.count if none);
+	// with 'use_grid' (grid must be built) only copies near each mallet are checked:
+	struct Contact {
+		uint32_t puck = 0;
+		uint32_t side = NoSide;
+		float t = Game::NoImpact;
+	};
+	Contact find_contact(bool use_grid) const;
+
+	//bounce copies off the walls; returns the first copy to go into a goal (pucks.count if none) and whose goal it was:
+	uint32_t collide_arena(uint32_t *side);
+
+	//broadphase for puck/mallet checks (used once pucks.count * present mallets reaches GridMinChecks):
+	PuckGrid grid;
+	inline static constexpr uint32_t GridMinChecks = 512;
+
+	//scratch, in arena coordinates, for the present mallets:
+	std::vector< uint32_t > current; //sides
+	std::vector< glm::vec2 > current_from, current_to;
+
+	//---- communication ----
+	//send the whole state (players, scores, pucks):
+	void send_state_message(Connection *connection) const;
+	//returns 'false' if no (complete) party state message; adopts the sender's player and puck counts;
+	// throws on a malformed message:
+	bool recv_state_message(Connection *connection);
+
+	//tell a client which side it plays (NoSide if watching) and the latest controls seq included in the state that follows:
+	// (a Message::S2C_Ack, with the side -- 0xff if watching -- where Game's has a PlayerType)
+	static void send_ack_message(Connection *connection, uint32_t side, uint32_t seq);
+	//returns 'false' if no (complete) ack message, throws on malformed ack message:
+	static bool recv_ack_message(Connection *connection, uint32_t *side, uint32_t *seq);
+
+	//---- constants ----
+	inline static constexpr uint32_t MinPlayers = 3;
+	inline static constexpr uint32_t MaxPlayers = 16;
+	inline static constexpr float ServeDepth = 1.25f; //serves land this far in front of the goal line
+
+	//sets up the arena for 'players' sides (resets scores and the game):
+	void set_players(uint32_t players);
+};
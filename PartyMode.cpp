@@ -0,0 +1,175 @@
+#include "PartyMode.hpp"
+
+#include "PlayMode.hpp"
+
+#include "DrawLines.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+PartyMode::PartyMode(Client &client_) : client(client_) {
+}
+
+PartyMode::~PartyMode() {
+}
+
+bool PartyMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
+	//(each side's frame is player 0's, so the keys mean the same thing as in a two-player match)
+	return PlayMode::handle_controls(evt, &controls);
+}
+
+void PartyMode::update(float elapsed) {
+	since_state += elapsed;
+
+	//queue data for sending to server:
+	controls.seq += 1;
+	controls.send_controls_message(&client.connection);
+	controls.reset();
+
+	//send/receive data:
+	client.poll([this](Connection *c, Connection::Event event){
+		if (event == Connection::OnOpen) {
+			std::cout << "[" << c->socket << "] opened" << std::endl;
+		} else if (event == Connection::OnClose) {
+			std::cout << "[" << c->socket << "] closed (!)" << std::endl;
+			throw std::runtime_error("Lost connection to server!");
+		} else { assert(event == Connection::OnRecv);
+			bool handled_message;
+			try {
+				do {
+					handled_message = false;
+					uint32_t seq;
+					if (PartyGame::recv_ack_message(c, &local_side, &seq)) handled_message = true;
+					GameConfig config;
+					if (config.recv_config_message(c)) {
+						config.validate();
+						//(only the goals matter for drawing; state messages bring the puck count)
+						game.config.goal_radius = config.goal_radius;
+						handled_message = true;
+					}
+					if (game.recv_state_message(c)) {
+						since_state = 0.0f;
+						handled_message = true;
+					}
+				} while (handled_message);
+			} catch (std::exception const &e) {
+				std::cerr << "[" << c->socket << "] malformed message from server: " << e.what() << std::endl;
+				//quit the game:
+				throw e;
+			}
+		}
+	}, 0.0);
+}
+
+//sides' colors, spread around the hue wheel:
+static glm::u8vec4 side_color(uint32_t side, uint32_t players) {
+	float h = 6.0f * float(side) / float(players);
+	glm::vec3 rgb = glm::clamp(glm::vec3(std::abs(h - 3.0f) - 1.0f, 2.0f - std::abs(h - 2.0f), 2.0f - std::abs(h - 4.0f)), 0.0f, 1.0f);
+	return glm::u8vec4(glm::vec3(255.0f) * rgb, 0xff);
+}
+
+void PartyMode::draw(glm::uvec2 const &drawable_size) {
+	static std::array< glm::vec2, 16 > const circle = [](){
+		std::array< glm::vec2, 16 > ret;
+		for (uint32_t a = 0; a < ret.size(); ++a) {
+			float ang = a / float(ret.size()) * 2.0f * float(M_PI);
+			ret[a] = glm::vec2(std::cos(ang), std::sin(ang));
+		}
+		return ret;
+	}();
+
+	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_DEPTH_TEST);
+
+	//turn the arena so our side (or side 0, when watching) is at the bottom, where player 0 is in a two-player match:
+	uint32_t players = game.players;
+	float wedge = float(M_PI) / players; //(as in PartyGame::set_players)
+	uint32_t bottom = (local_side < players ? local_side : 0);
+	float turn = -2.0f * wedge * bottom;
+	glm::mat2 rotate = glm::mat2(std::cos(turn), std::sin(turn), -std::sin(turn), std::cos(turn));
+	auto view = [&](glm::vec2 const &world) {
+		return glm::vec3(rotate * world, 0.0f);
+	};
+
+	//fit the whole polygon (and the goals behind it) in the window:
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	float extent = game.radius / std::cos(wedge) + 0.2f;
+	float scale = std::min(aspect, 1.0f) / extent;
+	glm::mat4 world_to_clip = glm::mat4(
+		scale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, scale, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+
+	//things move along their velocities until the next state arrives (but nothing moves during the grace period):
+	float dt = (game.grace_period > 0.0f ? 0.0f : std::min(since_state, MaxExtrapolate));
+
+	{
+		DrawLines lines(world_to_clip);
+
+		auto draw_text = [&](glm::vec2 const &at, std::string const &text, float H, glm::u8vec4 const &color) {
+			lines.draw_text(text,
+				glm::vec3(at.x, at.y, 0.0),
+				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+				color);
+		};
+		auto draw_circle = [&](glm::vec2 const &world, float radius, glm::u8vec4 const &color) {
+			for (uint32_t a = 0; a < circle.size(); ++a) {
+				lines.draw(view(world + radius * circle[a]), view(world + radius * circle[(a+1)%circle.size()]), color);
+			}
+		};
+
+		static constexpr glm::u8vec4 purple = glm::u8vec4(0xff, 0x00, 0xff, 0xff);
+		static constexpr glm::u8vec4 white = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+		static constexpr glm::u8vec4 gray = glm::u8vec4(0x60, 0x60, 0x60, 0xff);
+
+		float half_side = game.radius * std::tan(wedge);
+		float goal = game.config.goal_radius;
+		for (uint32_t side = 0; side < players; ++side) {
+			glm::vec2 const &n = game.normal[side];
+			glm::vec2 const &t = game.tangent[side];
+			glm::vec2 middle = game.radius * n;
+			PartyGame::Mallet const &mallet = game.mallets[side];
+			glm::u8vec4 color = (mallet.present ? side_color(side, players) : gray);
+
+			//walls either side of the goal, and its posts:
+			lines.draw(view(middle - half_side * t), view(middle - goal * t), purple);
+			lines.draw(view(middle + goal * t), view(middle + half_side * t), purple);
+			lines.draw(view(middle - goal * t), view(middle - goal * t + 0.1f * n), white);
+			lines.draw(view(middle + goal * t), view(middle + goal * t + 0.1f * n), white);
+
+			//the edge of the side's zone:
+			lines.draw(view(game.to_world(side, glm::vec2(Game::ArenaMin.x, Game::Player0Max))), view(game.to_world(side, glm::vec2(Game::ArenaMax.x, Game::Player0Max))), color);
+
+			//score (goals scored, then goals let in) behind the goal:
+			glm::vec3 at = view(middle + 0.15f * n);
+			draw_text(glm::vec2(at.x - 0.1f, at.y), std::to_string(mallet.score) + "/" + std::to_string(mallet.conceded), 0.08f, color);
+
+			if (mallet.present) {
+				draw_circle(game.to_world(side, mallet.position + mallet.velocity * dt), Game::PlayerRadius, color);
+				if (side == local_side) draw_circle(game.to_world(side, mallet.position + mallet.velocity * dt), 0.5f * Game::PlayerRadius, color);
+			}
+		}
+
+		for (uint32_t i = 0; i < game.pucks.count; ++i) {
+			uint8_t hit = game.last_hit[i];
+			glm::u8vec4 color = (hit == PartyGame::NoHit ? white : side_color(hit, players));
+			draw_circle(game.pucks.position(i) + game.pucks.velocity(i) * dt, Game::PuckRadius, color);
+		}
+
+		if (game.grace_period > 0.0f) {
+			int num = static_cast< int >(std::ceil(game.grace_period));
+			draw_text(glm::vec2(-0.1f, -0.2f), std::to_string(num), 0.5f, white);
+		}
+
+		std::string caption = (local_side < players ? "playing side " + std::to_string(local_side) : "watching (every side is taken)");
+		draw_text(glm::vec2(-aspect / scale + 0.1f, -1.0f / scale + 0.1f), caption, 0.08f, white);
+	}
+	GL_ERRORS();
+}
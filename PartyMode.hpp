@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Mode.hpp"
+
+#include "Connection.hpp"
+#include "PartyGame.hpp"
+
+#include <glm/glm.hpp>
+
+/*
+ * PartyMode plays in one of a server's party rooms (./server --party): WASD moves this
+ *  client's mallet, and the arena is drawn turned so that its side is at the bottom.
+ *  States are drawn as they arrive, carried along their velocities until the next one
+ *  (there is none of PlayMode's prediction or interpolation).
+ */
+
+struct PartyMode : Mode {
+	PartyMode(Client &client);
+	virtual ~PartyMode();
+
+	//functions called by main loop:
+	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
+	virtual void update(float elapsed) override;
+	virtual void draw(glm::uvec2 const &drawable_size) override;
+
+	//input tracking for local player:
+	Player::Controls controls;
+
+	//latest state from the server (adopts its player and puck counts):
+	PartyGame game = PartyGame(PartyGame::MinPlayers);
+
+	//which side the server says we play (NoSide while watching):
+	uint32_t local_side = PartyGame::NoSide;
+
+	//seconds since 'game' arrived (drawing moves things along for up to MaxExtrapolate of it):
+	float since_state = 0.0f;
+	inline static constexpr float MaxExtrapolate = 0.1f;
+
+	//connection to server:
+	Client &client;
+};
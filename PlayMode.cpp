@@ -8,16 +8,24 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
-#include <random>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <random>
 
-PlayMode::PlayMode(Client &client_) : client(client_) {
+PlayMode::PlayMode(Client &client_, float delay_) : delay(delay_), client(client_) {
 }
 
 PlayMode::~PlayMode() {
 }
 
 bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
+	return handle_controls(evt, &controls);
+}
+
+bool PlayMode::handle_controls(SDL_Event const &evt, Player::Controls *controls_) {
+	assert(controls_);
+	auto &controls = *controls_;
 
 	if (evt.type == SDL_KEYDOWN) {
 		if (evt.key.repeat) {
@@ -65,11 +73,143 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 	return false;
 }
 
+Player *PlayMode::local_player() {
+	if (local_type == PLAYER_0 && game.player_0.type == PLAYER_0) return &game.player_0;
+	if (local_type == PLAYER_1 && game.player_1.type == PLAYER_1) return &game.player_1;
+	return nullptr;
+}
+
+void PlayMode::predict(PendingControls const &p) {
+	Player *player = local_player();
+	if (!player) return;
+	player->controls = p.controls;
+	if (player == &game.player_0) {
+		game.update_player(*player, p.elapsed, Game::Player0Min, Game::Player0Max);
+	} else {
+		game.update_player(*player, p.elapsed, Game::Player1Min, Game::Player1Max);
+	}
+}
+
+void PlayMode::reconcile() {
+	//forget controls the server has already applied:
+	while (!pending.empty() && int32_t(pending.front().controls.seq - acked_seq) <= 0) {
+		pending.pop_front();
+	}
+
+	//players are frozen (and then reset) during the grace period after a goal, so there's nothing to predict:
+	if (game.grace_period > 0.0f) {
+		pending.clear();
+		return;
+	}
+
+	//server state is as of acked_seq, so re-apply everything newer:
+	for (auto const &p : pending) {
+		predict(p);
+	}
+}
+
+void PlayMode::record_state() {
+	//a server restart (or similar) sends time backward; start over:
+	if (history_count && game.time <= history[(history_begin + history_count - 1) % history.size()].time) {
+		history_count = 0;
+	}
+	//once full, reuse the oldest slot (slots keep their puck storage, so this soon stops allocating):
+	if (history_count == history.size()) {
+		history_begin = (history_begin + 1) % history.size();
+		history_count -= 1;
+	}
+	TimedState &state = history[(history_begin + history_count) % history.size()];
+	history_count += 1;
+
+	state.time = game.time;
+	state.epoch = game.epoch;
+	state.grace_period = game.grace_period;
+	state.player_position[0] = game.player_0.position;
+	state.player_position[1] = game.player_1.position;
+	state.player_velocity[0] = game.player_0.velocity;
+	state.player_velocity[1] = game.player_1.velocity;
+	state.pucks = game.pucks;
+
+	//track the server clock, snapping to it when first connected or when far off:
+	double offset = game.time - local_time;
+	if (history_count == 1 || std::abs(offset - clock_offset) > 1.0) {
+		clock_offset = offset;
+	} else {
+		clock_offset += (offset - clock_offset) * 0.05;
+	}
+}
+
+void PlayMode::interpolate() {
+	if (history_count == 0) return;
+	auto get = [this](uint32_t i) -> TimedState const & {
+		return history[(history_begin + i) % history.size()];
+	};
+
+	double at = local_time + clock_offset - delay;
+
+	TimedState const &newest = get(history_count - 1);
+	if (at >= newest.time) {
+		//no state that new yet: keep things moving along their last velocities for a little while
+		// (clamped to the side walls, which is where extrapolation tends to go most obviously wrong):
+		shown = newest;
+		if (newest.grace_period > 0.0f) return; //(nothing moves during the grace period)
+		float dt = float(std::min(at - newest.time, double(MaxExtrapolate)));
+		for (uint32_t p = 0; p < 2; ++p) {
+			shown.player_position[p] += shown.player_velocity[p] * dt;
+			shown.player_position[p].x = std::clamp(shown.player_position[p].x, Game::ArenaMin.x + Game::PlayerRadius, Game::ArenaMax.x - Game::PlayerRadius);
+		}
+		for (uint32_t i = 0; i < shown.pucks.count; ++i) {
+			shown.pucks.set_position(i, shown.pucks.position(i) + shown.pucks.velocity(i) * dt);
+			shown.pucks.x[i] = std::clamp(shown.pucks.x[i], Game::ArenaMin.x + Game::PuckRadius, Game::ArenaMax.x - Game::PuckRadius);
+		}
+		return;
+	}
+
+	//find the states just before and after 'at':
+	uint32_t after = 0;
+	while (get(after).time <= at) ++after;
+	if (after == 0) {
+		//older than anything buffered (e.g., just connected):
+		shown = get(0);
+		return;
+	}
+	TimedState const &a = get(after - 1);
+	TimedState const &b = get(after);
+	float amt = float((at - a.time) / (b.time - a.time));
+
+	shown = a;
+
+	//players only jump when reset at the end of the grace period:
+	if (a.grace_period == 0.0f && b.grace_period == 0.0f) {
+		for (uint32_t p = 0; p < 2; ++p) {
+			shown.player_position[p] = glm::mix(a.player_position[p], b.player_position[p], amt);
+		}
+	}
+
+	//pucks jump on every fork/goal/reset; show the earlier state until the later one's time:
+	if (a.epoch == b.epoch && a.pucks.count == b.pucks.count) {
+		for (uint32_t i = 0; i < shown.pucks.count; ++i) {
+			shown.pucks.set_position(i, glm::mix(a.pucks.position(i), b.pucks.position(i), amt));
+		}
+	}
+}
+
 void PlayMode::update(float elapsed) {
+	local_time += elapsed;
 
 	//queue data for sending to server:
+	controls.seq += 1;
+	//(and which moment we're showing, so the server can check hits against the pucks we saw)
+	controls.view_time = (history_count ? local_time + clock_offset - delay : 0.0);
 	controls.send_controls_message(&client.connection);
 
+	//move the local player now rather than waiting to hear back from the server:
+	if (game.grace_period == 0.0f && local_player()) {
+		pending.emplace_back(PendingControls{controls, elapsed});
+		if (pending.size() > MaxPending) pending.pop_front();
+		predict(pending.back());
+	}
+
 	//reset button press counters:
 	controls.left.downs = 0;
 	controls.right.downs = 0;
@@ -85,12 +225,27 @@ void PlayMode::update(float elapsed) {
 			std::cout << "[" << c->socket << "] closed (!)" << std::endl;
 			throw std::runtime_error("Lost connection to server!");
 		} else { assert(event == Connection::OnRecv);
-			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
+			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer.data(), c->recv_buffer.size()); std::cout.flush(); //DEBUG
 			bool handled_message;
 			try {
 				do {
 					handled_message = false;
-					if (game.recv_state_message(c)) handled_message = true;
+					if (Game::recv_ack_message(c, &local_type, &acked_seq)) handled_message = true;
+					if (Game::recv_events_message(c, &incoming_events)) handled_message = true;
+					GameConfig config;
+					if (config.recv_config_message(c)) {
+						game.set_config(config);
+						handled_message = true;
+					}
+					if (game.recv_state_message(c)) {
+						record_state();
+						reconcile();
+						for (GameEvent const &incoming : incoming_events) {
+							recent_events.emplace_back(TimedEvent{game.time, incoming});
+						}
+						incoming_events.clear();
+						handled_message = true;
+					}
 				} while (handled_message);
 			} catch (std::exception const &e) {
 				std::cerr << "[" << c->socket << "] malformed message from server: " << e.what() << std::endl;
@@ -99,6 +254,9 @@ void PlayMode::update(float elapsed) {
 			}
 		}
 	}, 0.0);
+
+	//figure out what to draw:
+	interpolate();
 }
 
 inline glm::u8vec4 get_color(PlayerType type) {
@@ -115,6 +273,27 @@ inline glm::u8vec4 get_color(PlayerType type) {
 
 
 void PlayMode::draw(glm::uvec2 const &drawable_size) {
+	//the local player is drawn where it was predicted to be, everything else is interpolated:
+	Player const *local = local_player();
+	glm::vec2 player_position[2] = {
+		(local == &game.player_0 ? game.player_0.position : shown.player_position[0]),
+		(local == &game.player_1 ? game.player_1.position : shown.player_position[1])
+	};
+	//flash hits and goals once the moment being drawn gets to them:
+	double at = local_time + clock_offset - delay;
+	while (!recent_events.empty() && recent_events.front().time + FlashTime < at) {
+		recent_events.pop_front();
+	}
+	flashes.clear();
+	for (TimedEvent const &timed : recent_events) {
+		if (timed.time > at) break;
+		flashes.emplace_back(Flash{timed.event, float(at - timed.time)});
+	}
+
+	draw_game(drawable_size, game, player_position, shown.pucks, "", flashes);
+}
+
+void PlayMode::draw_game(glm::uvec2 const &drawable_size, Game const &game, glm::vec2 const player_position[2], Pucks const &pucks, std::string const &caption, std::vector< Flash > const &flashes) {
 
 	static std::array< glm::vec2, 16 > const circle = [](){
 		std::array< glm::vec2, 16 > ret;
@@ -177,19 +356,19 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 		lines.draw(glm::vec3(Game::ArenaMin.x, Game::Player1Min, 0.0f), glm::vec3(Game::ArenaMax.x, Game::Player1Min, 0.0f), white);
 
 		//goals
-		lines.draw(glm::vec3(-Game::GoalRadius, Game::ArenaMin.y, 0.0f), glm::vec3(-Game::GoalRadius, Game::ArenaMin.y - 0.1f, 0.0f), white);
-		lines.draw(glm::vec3( Game::GoalRadius, Game::ArenaMin.y, 0.0f), glm::vec3( Game::GoalRadius, Game::ArenaMin.y - 0.1f, 0.0f), white);
-		lines.draw(glm::vec3(-Game::GoalRadius, Game::ArenaMax.y, 0.0f), glm::vec3(-Game::GoalRadius, Game::ArenaMax.y + 0.1f, 0.0f), white);
-		lines.draw(glm::vec3( Game::GoalRadius, Game::ArenaMax.y, 0.0f), glm::vec3( Game::GoalRadius, Game::ArenaMax.y + 0.1f, 0.0f), white);
+		lines.draw(glm::vec3(-game.config.goal_radius, Game::ArenaMin.y, 0.0f), glm::vec3(-game.config.goal_radius, Game::ArenaMin.y - 0.1f, 0.0f), white);
+		lines.draw(glm::vec3( game.config.goal_radius, Game::ArenaMin.y, 0.0f), glm::vec3( game.config.goal_radius, Game::ArenaMin.y - 0.1f, 0.0f), white);
+		lines.draw(glm::vec3(-game.config.goal_radius, Game::ArenaMax.y, 0.0f), glm::vec3(-game.config.goal_radius, Game::ArenaMax.y + 0.1f, 0.0f), white);
+		lines.draw(glm::vec3( game.config.goal_radius, Game::ArenaMax.y, 0.0f), glm::vec3( game.config.goal_radius, Game::ArenaMax.y + 0.1f, 0.0f), white);
 		for (uint32_t a = 0; a < circle.size(); ++a) {
-			glm::vec2 pos1 = Game::Goal0Center + Game::GoalRadius * circle[a];
-			glm::vec2 pos2 = Game::Goal0Center + Game::GoalRadius * circle[(a+1)%circle.size()];
+			glm::vec2 pos1 = Game::Goal0Center + game.config.goal_radius * circle[a];
+			glm::vec2 pos2 = Game::Goal0Center + game.config.goal_radius * circle[(a+1)%circle.size()];
 			if (pos1.y < Game::ArenaMin.y || pos2.y < Game::ArenaMin.y) continue;
 			lines.draw(glm::vec3(pos1, 0.0f), glm::vec3(pos2, 0.0f), white);
 		}
 		for (uint32_t a = 0; a < circle.size(); ++a) {
-			glm::vec2 pos1 = Game::Goal1Center + Game::GoalRadius * circle[a];
-			glm::vec2 pos2 = Game::Goal1Center + Game::GoalRadius * circle[(a+1)%circle.size()];
+			glm::vec2 pos1 = Game::Goal1Center + game.config.goal_radius * circle[a];
+			glm::vec2 pos2 = Game::Goal1Center + game.config.goal_radius * circle[(a+1)%circle.size()];
 			if (pos1.y > Game::ArenaMax.y || pos2.y > Game::ArenaMax.y) continue;
 			lines.draw(glm::vec3(pos1, 0.0f), glm::vec3(pos2, 0.0f), white);
 		}
@@ -198,12 +377,15 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 		lines.draw(glm::vec3(Game::ArenaMin.x, Game::ArenaMin.y, 0.0f), glm::vec3(Game::ArenaMin.x, Game::ArenaMax.y, 0.0f), purple);
 		lines.draw(glm::vec3(Game::ArenaMax.x, Game::ArenaMin.y, 0.0f), glm::vec3(Game::ArenaMax.x, Game::ArenaMax.y, 0.0f), purple);
 
+		glm::vec2 position_0 = player_position[0];
+		glm::vec2 position_1 = player_position[1];
+
 		//draw player 0
 		glm::u8vec4 col_0 = get_color(game.player_0.type);
 		for (uint32_t a = 0; a < circle.size(); ++a) {
 			lines.draw(
-				glm::vec3(game.player_0.position + Game::PlayerRadius * circle[a], 0.0f),
-				glm::vec3(game.player_0.position + Game::PlayerRadius * circle[(a+1)%circle.size()], 0.0f),
+				glm::vec3(position_0 + Game::PlayerRadius * circle[a], 0.0f),
+				glm::vec3(position_0 + Game::PlayerRadius * circle[(a+1)%circle.size()], 0.0f),
 				col_0
 			);
 		}
@@ -213,19 +395,38 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 		glm::u8vec4 col_1 = get_color(game.player_1.type);
 		for (uint32_t a = 0; a < circle.size(); ++a) {
 			lines.draw(
-				glm::vec3(game.player_1.position + Game::PlayerRadius * circle[a], 0.0f),
-				glm::vec3(game.player_1.position + Game::PlayerRadius * circle[(a+1)%circle.size()], 0.0f),
+				glm::vec3(position_1 + Game::PlayerRadius * circle[a], 0.0f),
+				glm::vec3(position_1 + Game::PlayerRadius * circle[(a+1)%circle.size()], 0.0f),
 				col_1
 			);
 		}
 		draw_text(glm::vec2(0.8f, 0.25f), std::to_string(game.player_1.score), 0.1f);
 
-		for (auto const &puck : game.pucks) {
-			glm::u8vec4 col = get_color(puck.last_hit);
+		for (uint32_t i = 0; i < pucks.count; ++i) {
+			glm::u8vec4 col = get_color(pucks.last_hit[i]);
+			glm::vec2 position = pucks.position(i);
 			for (uint32_t a = 0; a < circle.size(); ++a) {
 				lines.draw(
-					glm::vec3(puck.position + Game::PuckRadius * circle[a], 0.0f),
-					glm::vec3(puck.position + Game::PuckRadius * circle[(a+1)%circle.size()], 0.0f),
+					glm::vec3(position + Game::PuckRadius * circle[a], 0.0f),
+					glm::vec3(position + Game::PuckRadius * circle[(a+1)%circle.size()], 0.0f),
+					col
+				);
+			}
+		}
+
+		//hits ring out in the hitter's color, goals in white (and bigger), fading into the background as they grow:
+		// (lines aren't blended, so fading is done by mixing the color toward the clear color)
+		for (Flash const &flash : flashes) {
+			if (flash.event.type != GameEvent::Hit && flash.event.type != GameEvent::Goal) continue;
+			float amt = std::clamp(flash.age / FlashTime, 0.0f, 1.0f);
+			bool goal = (flash.event.type == GameEvent::Goal);
+			float radius = (goal ? 0.1f + 0.5f * amt : Game::PuckRadius + 0.15f * amt);
+			glm::vec3 bright = glm::vec3(goal ? white : get_color(flash.event.player));
+			glm::u8vec4 col = glm::u8vec4(glm::mix(bright, glm::vec3(0.1f * 0xff), amt), 0xff);
+			for (uint32_t a = 0; a < circle.size(); ++a) {
+				lines.draw(
+					glm::vec3(flash.event.position + radius * circle[a], 0.0f),
+					glm::vec3(flash.event.position + radius * circle[(a+1)%circle.size()], 0.0f),
 					col
 				);
 			}
@@ -235,6 +436,10 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 			int num = static_cast< int >(std::ceil(game.grace_period));
 			draw_text(glm::vec2(-0.1f, -0.2f), std::to_string(num), 0.5f);
 		}
+
+		if (!caption.empty()) {
+			draw_text(glm::vec2(Game::ArenaMin.x + 0.05f, Game::ArenaMin.y + 0.05f), caption, 0.06f);
+		}
 	}
 	GL_ERRORS();
 }
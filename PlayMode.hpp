@@ -1,3 +1,5 @@
+#pragma once
+
 #include "Mode.hpp"
 
 #include "Connection.hpp"
@@ -5,11 +7,12 @@
 
 #include <glm/glm.hpp>
 
+#include <string>
 #include <vector>
 #include <deque>
 
 struct PlayMode : Mode {
-	PlayMode(Client &client);
+	PlayMode(Client &client, float delay = DefaultDelay);
 	virtual ~PlayMode();
 
 	//functions called by main loop:
@@ -17,14 +20,91 @@ struct PlayMode : Mode {
 	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
 
+	//WASD (and space) press and release 'controls' (returns true if 'evt' was one of those keys):
+	// (shared with PartyMode)
+	static bool handle_controls(SDL_Event const &evt, Player::Controls *controls);
+
+	//a recent hit or goal, and how long before the moment being drawn it happened:
+	struct Flash {
+		GameEvent event;
+		float age = 0.0f; //seconds
+	};
+	inline static constexpr float FlashTime = 0.4f; //(flashes older than this aren't drawn)
+
+	//draw the arena, the players at 'player_position', and 'pucks' (with an optional line of text below, and rings for 'flashes'):
+	// (shared with ReplayMode)
+	static void draw_game(glm::uvec2 const &drawable_size, Game const &game, glm::vec2 const player_position[2], Pucks const &pucks, std::string const &caption = "", std::vector< Flash > const &flashes = {});
+
 	//----- game state -----
 
 	//input tracking for local player:
 	Player::Controls controls;
 
-	//latest game state (from server):
+	//latest game state (from server, with the local player predicted ahead):
 	Game game;
 
+	//----- client-side prediction -----
+	//the local player moves as soon as controls are pressed, instead of a round trip later:
+	// each frame's controls are applied locally right away and remembered until the server
+	// acknowledges them; when a new state arrives, the unacknowledged ones are replayed on top of it.
+
+	//which player the server says we control (NEUTRAL when spectating) and the last controls seq it applied:
+	PlayerType local_type = NEUTRAL;
+	uint32_t acked_seq = 0;
+
+	struct PendingControls {
+		Player::Controls controls;
+		float elapsed;
+	};
+	std::deque< PendingControls > pending;
+	static constexpr size_t MaxPending = 256; //(about four seconds of frames; older ones are dropped)
+
+	Player *local_player(); //nullptr when spectating
+	void predict(PendingControls const &pending);
+	void reconcile(); //called after each state message
+
+	//----- interpolation -----
+	//states from the server are kept (with their server time) and drawn 'delay' seconds in the past,
+	// blending between the two states on either side of that time, so motion stays smooth at any
+	// frame rate and small gaps in arrival times are hidden. Pucks aren't blended across a
+	// fork/goal (the server's 'epoch' changes) since they jump rather than move there; if states
+	// stop arriving, the newest one is extrapolated for a short while.
+	float delay;
+	inline static constexpr float DefaultDelay = 0.1f;
+	inline static constexpr float MaxExtrapolate = 0.1f; //seconds past the newest state to keep moving things
+
+	struct TimedState {
+		double time = 0.0; //server time
+		uint32_t epoch = 0;
+		float grace_period = 0.0f;
+		glm::vec2 player_position[2] = {glm::vec2(0.0f), glm::vec2(0.0f)};
+		glm::vec2 player_velocity[2] = {glm::vec2(0.0f), glm::vec2(0.0f)};
+		Pucks pucks;
+	};
+	//ring buffer of recent states, oldest at history[history_begin]:
+	std::vector< TimedState > history = std::vector< TimedState >(32);
+	uint32_t history_begin = 0, history_count = 0;
+	void record_state(); //add 'game' as received from the server
+
+	//server time ~= local_time + clock_offset (smoothed, since arrival times jitter):
+	double local_time = 0.0;
+	double clock_offset = 0.0;
+
+	//what draw() shows for the remote mallet(s) and pucks:
+	TimedState shown;
+	void interpolate();
+
+	//----- events -----
+	//the server sends what happened in each tick just before its state; events are stamped with
+	// that state's time and flashed when the (delayed) drawing time reaches them:
+	std::vector< GameEvent > incoming_events; //received, waiting for their state
+	struct TimedEvent {
+		double time = 0.0; //server time
+		GameEvent event;
+	};
+	std::deque< TimedEvent > recent_events;
+	std::vector< Flash > flashes; //(scratch for draw())
+
 	//last message from server:
 	std::string server_message;
 
@@ -0,0 +1,49 @@
+#include "PuckGrid.hpp"
+
+#include "Game.hpp"
+
+void PuckGrid::setup(glm::vec2 const &min_, glm::vec2 const &max_, float cell_size) {
+	min = min_;
+	inv_cell_size = 1.0f / cell_size;
+	width = std::max(1u, uint32_t(std::ceil((max_.x - min_.x) * inv_cell_size)));
+	height = std::max(1u, uint32_t(std::ceil((max_.y - min_.y) * inv_cell_size)));
+	//one extra entry so cell c's range is always [cell_start[c], cell_start[c+1]):
+	cell_start.assign(width * height + 1, 0);
+}
+
+void PuckGrid::build(Pucks const &pucks) {
+	assert(!cell_start.empty() && "PuckGrid::setup() must be called before build()");
+
+	puck_cell.resize(pucks.count);
+	sorted.resize(pucks.count);
+	std::fill(cell_start.begin(), cell_start.end(), 0);
+
+	//count pucks per cell:
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		uint32_t c = cell_y(pucks.y[i]) * width + cell_x(pucks.x[i]);
+		puck_cell[i] = c;
+		cell_start[c] += 1;
+	}
+
+	//running sum, so cell_start[c] is now the end of cell c's range:
+	for (uint32_t c = 1; c + 1 < cell_start.size(); ++c) {
+		cell_start[c] += cell_start[c - 1];
+	}
+	cell_start.back() = pucks.count;
+
+	//walk pucks backward, filling each cell from its end;
+	// this leaves cell_start[c] at the start of cell c and pucks ascending within each cell:
+	for (uint32_t i = pucks.count; i > 0; --i) {
+		uint32_t c = puck_cell[i - 1];
+		cell_start[c] -= 1;
+		sorted[cell_start[c]] = i - 1;
+	}
+}
+
+float PuckGrid::max_step(Pucks const &pucks) {
+	float ret = 0.0f;
+	for (uint32_t i = 0; i < pucks.count; ++i) {
+		ret = std::max(ret, std::abs(pucks.x[i] - pucks.prev_x[i]) + std::abs(pucks.y[i] - pucks.prev_y[i]));
+	}
+	return ret;
+}
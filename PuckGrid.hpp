@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * PuckGrid is a uniform grid over the arena used as a broadphase for puck
+ *  collisions: pucks are binned by cell (with a counting sort, so rebuilding
+ *  does not allocate once the grid has been sized) and queries only look at
+ *  the handful of cells near the point of interest.
+ *
+ * Positions outside the grid are clamped into the border cells, so nothing
+ *  is ever missed -- callers still do their own exact distance tests.
+ */
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct Pucks;
+
+struct PuckGrid {
+	//cover [min,max] with square cells of size 'cell_size':
+	void setup(glm::vec2 const &min, glm::vec2 const &max, float cell_size);
+
+	//bin the first pucks.count pucks by position:
+	void build(Pucks const &pucks);
+
+	//call fn(index) for every puck binned in a cell overlapping the square of half-size 'radius' around 'center':
+	template< typename F >
+	void query(glm::vec2 const &center, float radius, F const &fn) const;
+
+	//call fn(m, index) for every puck that might have come within 'reach' of mover m during the step, for 'count'
+	// movers (mallets) that went from[m] -> to[m]; 'pucks' must be what the grid was last built from:
+	// (Game and PartyGame's puck/mallet broadphase)
+	template< typename F >
+	void query_swept(Pucks const &pucks, uint32_t count, glm::vec2 const *from, glm::vec2 const *to, float reach, F const &fn) const;
+	//longest step (in x plus y) any of the pucks took since prev_*:
+	static float max_step(Pucks const &pucks);
+
+	//call fn(a, b) once for every pair of pucks in the same or in neighboring cells:
+	// (with cells at least as large as the collision distance, this finds every colliding pair)
+	template< typename F >
+	void for_each_pair(F const &fn) const;
+
+	//-- internals --
+	glm::vec2 min = glm::vec2(0.0f);
+	float inv_cell_size = 1.0f;
+	uint32_t width = 0, height = 0;
+
+	uint32_t cell_x(float x) const { return uint32_t(std::clamp(int32_t(std::floor((x - min.x) * inv_cell_size)), 0, int32_t(width) - 1)); }
+	uint32_t cell_y(float y) const { return uint32_t(std::clamp(int32_t(std::floor((y - min.y) * inv_cell_size)), 0, int32_t(height) - 1)); }
+
+	//pucks in cell c are sorted[cell_start[c]] .. sorted[cell_start[c+1]-1]:
+	std::vector< uint32_t > cell_start;
+	std::vector< uint32_t > sorted;
+	std::vector< uint32_t > puck_cell; //scratch used while building
+};
+
+template< typename F >
+void PuckGrid::query(glm::vec2 const &center, float radius, F const &fn) const {
+	uint32_t x0 = cell_x(center.x - radius), x1 = cell_x(center.x + radius);
+	uint32_t y0 = cell_y(center.y - radius), y1 = cell_y(center.y + radius);
+	for (uint32_t y = y0; y <= y1; ++y) {
+		//cells in a row are contiguous, so each row is one range of 'sorted':
+		uint32_t begin = cell_start[y * width + x0];
+		uint32_t end = cell_start[y * width + x1 + 1];
+		for (uint32_t s = begin; s < end; ++s) {
+			fn(sorted[s]);
+		}
+	}
+}
+
+template< typename F >
+void PuckGrid::query_swept(Pucks const &pucks, uint32_t count, glm::vec2 const *from, glm::vec2 const *to, float reach, F const &fn) const {
+	//grid is binned by end-of-step position, so widen each query by how far things could have moved:
+	float puck_step = max_step(pucks);
+	for (uint32_t m = 0; m < count; ++m) {
+		float step = std::abs(to[m].x - from[m].x) + std::abs(to[m].y - from[m].y);
+		query(to[m], reach + puck_step + step, [&](uint32_t i) {
+			fn(m, i);
+		});
+	}
+}
+
+template< typename F >
+void PuckGrid::for_each_pair(F const &fn) const {
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint32_t c = y * width + x;
+			uint32_t begin = cell_start[c], end = cell_start[c+1];
+			if (begin == end) continue;
+
+			//pairs within this cell:
+			for (uint32_t a = begin; a < end; ++a) {
+				for (uint32_t b = a + 1; b < end; ++b) {
+					fn(sorted[a], sorted[b]);
+				}
+			}
+
+			//pairs with the "forward" half of the neighborhood (right, and the three cells above),
+			// so that each neighboring pair of cells is visited once:
+			auto against = [&](uint32_t nbegin, uint32_t nend) {
+				for (uint32_t a = begin; a < end; ++a) {
+					for (uint32_t b = nbegin; b < nend; ++b) {
+						fn(sorted[a], sorted[b]);
+					}
+				}
+			};
+			if (x + 1 < width) against(cell_start[c+1], cell_start[c+2]);
+			if (y + 1 < height) {
+				uint32_t up = c + width;
+				uint32_t lo = (x > 0 ? up - 1 : up);
+				uint32_t hi = (x + 1 < width ? up + 1 : up);
+				against(cell_start[lo], cell_start[hi + 1]);
+			}
+		}
+	}
+}
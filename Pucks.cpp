@@ -0,0 +1,469 @@
+#include "Game.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PUCKS_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define PUCKS_AVX 1
+#include <immintrin.h>
+#endif
+
+//NOTE: the SIMD paths perform exactly the same float operations (in the same order)
+// as the scalar path, so switching kernels never changes the simulation.
+
+#if defined(PUCKS_SSE) || defined(PUCKS_AVX)
+Pucks::Kernel Pucks::kernel = Pucks::SIMD;
+#else
+Pucks::Kernel Pucks::kernel = Pucks::Scalar;
+#endif
+
+void Pucks::resize(uint32_t count_) {
+	count = count_;
+	//pad storage so the SIMD passes can always run whole blocks:
+	uint32_t padded = (count + Lanes - 1) / Lanes * Lanes;
+	for (auto *v : {&x, &y, &vx, &vy, &prev_x, &prev_y}) {
+		v->assign(padded, 0.0f);
+	}
+	last_hit.assign(padded, NEUTRAL);
+}
+
+//---------------------------------
+//scalar reference versions:
+
+static void integrate_scalar(Pucks &pucks, uint32_t begin, uint32_t end, float elapsed, float max_speed, float retain) {
+	//(through locals, so storing prev_* doesn't make the compiler reload x and y)
+	float *px = pucks.x.data(), *py = pucks.y.data(), *pvx = pucks.vx.data(), *pvy = pucks.vy.data();
+	float *pprev_x = pucks.prev_x.data(), *pprev_y = pucks.prev_y.data();
+	for (uint32_t i = begin; i < end; ++i) {
+		float x = px[i], y = py[i], vx = pvx[i], vy = pvy[i];
+		pprev_x[i] = x;
+		pprev_y[i] = y;
+		px[i] = x + vx * elapsed;
+		py[i] = y + vy * elapsed;
+		//pucks decay velocity above a certain max
+		float speed = std::sqrt(vx * vx + vy * vy);
+		if (max_speed < speed) {
+			float amt = (max_speed + (speed - max_speed) * retain) / speed;
+			pvx[i] = vx * amt;
+			pvy[i] = vy * amt;
+		}
+	}
+}
+
+//side walls: mirror about the wall rather than clamping to it, since that is where a puck
+// moving in a straight line would have ended up (clamping loses the overshoot):
+static inline void collide_sides(float &x, float &vx, float lo, float hi) {
+	if (x < lo) {
+		x = lo + (lo - x);
+		vx = std::abs(vx);
+	}
+	if (x > hi) {
+		x = hi - (x - hi);
+		vx = -std::abs(vx);
+	}
+	//(only a step longer than the arena is wide could still be outside; don't let it escape)
+	x = std::min(std::max(x, lo), hi);
+}
+
+//end walls, goal mouth, and goal posts, for a puck past one of the end lines after this step.
+//returns 'true' if the puck is now entirely inside a goal (i.e., scored):
+static bool collide_ends(Pucks &pucks, uint32_t i, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius) {
+	float &x = pucks.x[i];
+	float &y = pucks.y[i];
+	float &vx = pucks.vx[i];
+	float &vy = pucks.vy[i];
+	float prev_x = pucks.prev_x[i];
+	float prev_y = pucks.prev_y[i];
+
+	//pucks with |x| <= mouth fit through the goal mouth:
+	float mouth = goal_radius - radius;
+
+	auto end_wall = [&](float line, float side) {
+		//side is -1 for the bottom end, +1 for the top end; 'past' means beyond the line in that direction:
+		if (!((y - line) * side > 0.0f)) return;
+
+		if ((prev_y - line) * side <= 0.0f) {
+			//crossed the line during this step -- bounce unless it crossed within the goal mouth:
+			// (crossing x is interpolated along the step, which is exact unless a side wall was also hit)
+			float f = (prev_y - line) / (prev_y - y);
+			float cross_x = prev_x + f * (x - prev_x);
+			if (std::abs(cross_x) > mouth) {
+				y = line - (y - line);
+				vy = -side * std::abs(vy);
+				return;
+			}
+		} else if (std::abs(prev_x) > mouth) {
+			//was already past the line but not in the goal; shouldn't happen, but push it back in:
+			y = line;
+			vy = -side * std::abs(vy);
+			return;
+		}
+
+		//in the goal, so the goal posts act as side walls:
+		if (x < -mouth) {
+			x = -mouth + (-mouth - x);
+			vx = std::abs(vx);
+		}
+		if (x > mouth) {
+			x = mouth - (x - mouth);
+			vx = -std::abs(vx);
+		}
+	};
+	end_wall(arena_min.y + radius, -1.0f);
+	end_wall(arena_max.y - radius, 1.0f);
+
+	return y < arena_min.y - radius || y > arena_max.y + radius;
+}
+
+//a step that ended past a wall but was longer than 'max_step': walk it again in pieces no longer
+// than 'max_step', bouncing after each, so a puck that meets two walls (a corner, or an end wall
+// and then a post) meets them in the right order and in the right places.
+//(prev_* are put back to the start of the step afterward, like a single step leaves them)
+//returns 'true' if the puck ends up scored, like collide_ends:
+static bool collide_substeps(Pucks &pucks, uint32_t i, float max_step, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius) {
+	//(walked in locals, which only go through 'pucks' around the goal checks, so each piece isn't a round trip through memory)
+	float x = pucks.x[i];
+	float y = pucks.y[i];
+	float vx = pucks.vx[i];
+	float start_x = pucks.prev_x[i];
+	float start_y = pucks.prev_y[i];
+	float x_lo = arena_min.x + radius;
+	float x_hi = arena_max.x - radius;
+	float y_lo = arena_min.y + radius;
+	float y_hi = arena_max.y - radius;
+
+	float step_x = x - start_x;
+	float step_y = y - start_y;
+	float length = std::sqrt(step_x * step_x + step_y * step_y);
+	uint32_t steps = std::min(Pucks::MaxSubsteps, uint32_t(std::ceil(length / max_step)));
+
+	//the pieces before the puck first reaches a wall are a straight line, so skip them:
+	float first = 1.0f; //(fraction of the step at which the straight path leaves the walls' box)
+	if (x < x_lo) first = std::min(first, (x_lo - start_x) / (x - start_x));
+	if (x > x_hi) first = std::min(first, (x_hi - start_x) / (x - start_x));
+	if (y < y_lo) first = std::min(first, (y_lo - start_y) / (y - start_y));
+	if (y > y_hi) first = std::min(first, (y_hi - start_y) / (y - start_y));
+	uint32_t skip = std::min(steps - 1, uint32_t(std::max(0.0f, first) * float(steps)));
+
+	step_x /= float(steps);
+	step_y /= float(steps);
+
+	x = start_x + float(skip) * step_x;
+	y = start_y + float(skip) * step_y;
+	bool scored = false;
+	for (uint32_t s = skip; s < steps && !scored; ++s) {
+		float from_x = x;
+		float from_y = y;
+		float to_x = x + step_x;
+		float to_y = y + step_y;
+		x = to_x;
+		y = to_y;
+		collide_sides(x, vx, x_lo, x_hi);
+		if (y < y_lo || y > y_hi) {
+			pucks.x[i] = x;
+			pucks.y[i] = y;
+			pucks.vx[i] = vx;
+			pucks.prev_x[i] = from_x;
+			pucks.prev_y[i] = from_y;
+			scored = collide_ends(pucks, i, arena_min, arena_max, goal_radius, radius);
+			x = pucks.x[i];
+			y = pucks.y[i];
+			vx = pucks.vx[i];
+		}
+		//anything that moved the puck was a bounce, which turns the rest of the step around too:
+		if (x != to_x) step_x = std::copysign(step_x, x - to_x);
+		if (y != to_y) step_y = std::copysign(step_y, y - to_y);
+	}
+
+	pucks.x[i] = x;
+	pucks.y[i] = y;
+	pucks.vx[i] = vx;
+	pucks.prev_x[i] = start_x;
+	pucks.prev_y[i] = start_y;
+	return scored;
+}
+
+//collide_arena_scalar from the first puck past a wall on:
+static uint32_t collide_arena_rest(Pucks &pucks, uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+	float x_lo = arena_min.x + radius;
+	float x_hi = arena_max.x - radius;
+	float y_lo = arena_min.y + radius;
+	float y_hi = arena_max.y - radius;
+	float mouth = goal_radius - radius;
+	float max_step2 = max_step * max_step;
+	float width2 = (x_hi - x_lo) * (x_hi - x_lo);
+	float height2 = (y_hi - y_lo) * (y_hi - y_lo);
+	float *px = pucks.x.data(), *pvx = pucks.vx.data();
+	for (uint32_t i = begin; i < end; ++i) {
+		//pucks still inside moved in a straight line and have nothing to bounce off (most pucks, most ticks):
+		float x = px[i];
+		float y = pucks.y[i];
+		bool past_side = x < x_lo || x > x_hi;
+		bool past_end = y < y_lo || y > y_hi;
+		if (!(past_side || past_end)) continue;
+
+		//long steps that ended past a wall are re-walked in pieces if they could have met two walls: ones that end past
+		// a side wall and an end line (a corner), start past an end line or reach it within the goal mouth (the posts),
+		// or are longer than the arena. A single reflection is exact for the rest, which only met one wall:
+		float prev_x = pucks.prev_x[i];
+		float prev_y = pucks.prev_y[i];
+		float dx = x - prev_x;
+		float dy = y - prev_y;
+		if (dx * dx + dy * dy > max_step2) {
+			bool to_mouth = std::min(prev_x, x) <= mouth && std::max(prev_x, x) >= -mouth;
+			bool two_walls = (past_end && (past_side || to_mouth))
+			              || prev_y < y_lo || prev_y > y_hi
+			              || dx * dx > width2 || dy * dy > height2;
+			if (two_walls) {
+				if (collide_substeps(pucks, i, max_step, arena_min, arena_max, goal_radius, radius)) return i;
+				continue;
+			}
+		}
+
+		collide_sides(px[i], pvx[i], x_lo, x_hi);
+
+		//only pucks that reached an end line need the (branchy) goal checks:
+		// (side walls don't move a puck in y)
+		if (y < y_lo || y > y_hi) {
+			if (collide_ends(pucks, i, arena_min, arena_max, goal_radius, radius)) return i;
+		}
+	}
+	return end;
+}
+
+static uint32_t collide_arena_scalar(Pucks &pucks, uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+	//most ticks no puck is at a wall, so look for one before setting up everything bouncing takes:
+	float x_lo = arena_min.x + radius;
+	float x_hi = arena_max.x - radius;
+	float y_lo = arena_min.y + radius;
+	float y_hi = arena_max.y - radius;
+	float const *px = pucks.x.data(), *py = pucks.y.data();
+	for (uint32_t i = begin; i < end; ++i) {
+		if (px[i] < x_lo || px[i] > x_hi || py[i] < y_lo || py[i] > y_hi) {
+			return collide_arena_rest(pucks, i, end, arena_min, arena_max, goal_radius, radius, max_step);
+		}
+	}
+	return end;
+}
+
+//---------------------------------
+//SIMD versions:
+// integrate_simd() processes whole blocks (storage is padded to a multiple of Lanes) and
+// returns how many pucks it handled so the scalar version can finish the rest.
+// collide_arena_simd() only vectorizes the side walls; the few pucks at an end line
+// (and the long steps that need sub-steps) go through the same scalar code as the scalar path.
+// Fewer than SimdCount pucks take the scalar path either way (a padded block costs more than
+// that many pucks one at a time).
+
+#if defined(PUCKS_AVX)
+
+static constexpr uint32_t SimdCount = 8;
+
+static uint32_t integrate_simd(Pucks &pucks, uint32_t begin, uint32_t end, float elapsed, float max_speed, float retain) {
+	__m256 const dt = _mm256_set1_ps(elapsed);
+	__m256 const max = _mm256_set1_ps(max_speed);
+	__m256 const ret = _mm256_set1_ps(retain);
+	for (uint32_t i = begin; i < end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&pucks.x[i]);
+		__m256 y = _mm256_loadu_ps(&pucks.y[i]);
+		__m256 vx = _mm256_loadu_ps(&pucks.vx[i]);
+		__m256 vy = _mm256_loadu_ps(&pucks.vy[i]);
+		_mm256_storeu_ps(&pucks.prev_x[i], x);
+		_mm256_storeu_ps(&pucks.prev_y[i], y);
+		_mm256_storeu_ps(&pucks.x[i], _mm256_add_ps(x, _mm256_mul_ps(vx, dt)));
+		_mm256_storeu_ps(&pucks.y[i], _mm256_add_ps(y, _mm256_mul_ps(vy, dt)));
+
+		__m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+		__m256 fast = _mm256_cmp_ps(max, speed, _CMP_LT_OQ);
+		if (_mm256_movemask_ps(fast) == 0) continue;
+		__m256 amt = _mm256_div_ps(_mm256_add_ps(max, _mm256_mul_ps(_mm256_sub_ps(speed, max), ret)), speed);
+		_mm256_storeu_ps(&pucks.vx[i], _mm256_blendv_ps(vx, _mm256_mul_ps(vx, amt), fast));
+		_mm256_storeu_ps(&pucks.vy[i], _mm256_blendv_ps(vy, _mm256_mul_ps(vy, amt), fast));
+	}
+	return end;
+}
+
+static uint32_t collide_arena_simd(Pucks &pucks, uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+	__m256 const sign = _mm256_set1_ps(-0.0f);
+	__m256 const x_lo = _mm256_set1_ps(arena_min.x + radius);
+	__m256 const x_hi = _mm256_set1_ps(arena_max.x - radius);
+	__m256 const y_lo = _mm256_set1_ps(arena_min.y + radius);
+	__m256 const y_hi = _mm256_set1_ps(arena_max.y - radius);
+	__m256 const mouth = _mm256_set1_ps(goal_radius - radius);
+	__m256 const neg_mouth = _mm256_xor_ps(sign, mouth);
+	__m256 const max_step2 = _mm256_set1_ps(max_step * max_step);
+	__m256 const width2 = _mm256_mul_ps(_mm256_sub_ps(x_hi, x_lo), _mm256_sub_ps(x_hi, x_lo));
+	__m256 const height2 = _mm256_mul_ps(_mm256_sub_ps(y_hi, y_lo), _mm256_sub_ps(y_hi, y_lo));
+
+	for (uint32_t i = begin; i < end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&pucks.x[i]);
+		__m256 y = _mm256_loadu_ps(&pucks.y[i]);
+
+		//pucks still inside have nothing to bounce off (see collide_arena_scalar), so skip blocks of only those:
+		__m256 past_side = _mm256_or_ps(_mm256_cmp_ps(x, x_lo, _CMP_LT_OQ), _mm256_cmp_ps(x, x_hi, _CMP_GT_OQ));
+		__m256 past_end = _mm256_or_ps(_mm256_cmp_ps(y, y_lo, _CMP_LT_OQ), _mm256_cmp_ps(y, y_hi, _CMP_GT_OQ));
+		__m256 out = _mm256_or_ps(past_side, past_end);
+		if (_mm256_movemask_ps(out) == 0) continue;
+
+		//long steps past a wall that could have met two walls (same test as collide_arena_scalar) get sub-steps instead of the single bounce below:
+		__m256 prev_x = _mm256_loadu_ps(&pucks.prev_x[i]);
+		__m256 prev_y = _mm256_loadu_ps(&pucks.prev_y[i]);
+		__m256 dx = _mm256_sub_ps(x, prev_x);
+		__m256 dy = _mm256_sub_ps(y, prev_y);
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 to_mouth = _mm256_and_ps(_mm256_cmp_ps(_mm256_min_ps(prev_x, x), mouth, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_max_ps(prev_x, x), neg_mouth, _CMP_GE_OQ));
+		__m256 two_walls = _mm256_or_ps(
+			_mm256_or_ps(_mm256_and_ps(past_end, _mm256_or_ps(past_side, to_mouth)),
+			             _mm256_or_ps(_mm256_cmp_ps(prev_y, y_lo, _CMP_LT_OQ), _mm256_cmp_ps(prev_y, y_hi, _CMP_GT_OQ))),
+			_mm256_or_ps(_mm256_cmp_ps(_mm256_mul_ps(dx, dx), width2, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_mul_ps(dy, dy), height2, _CMP_GT_OQ))
+		);
+		__m256 walk = _mm256_and_ps(_mm256_and_ps(out, two_walls), _mm256_cmp_ps(d2, max_step2, _CMP_GT_OQ));
+
+		__m256 vx = _mm256_loadu_ps(&pucks.vx[i]);
+
+		//side walls (same as collide_sides), for the pucks not being walked:
+		__m256 m = _mm256_andnot_ps(walk, _mm256_cmp_ps(x, x_lo, _CMP_LT_OQ));
+		__m256 from = x;
+		x = _mm256_blendv_ps(x, _mm256_add_ps(x_lo, _mm256_sub_ps(x_lo, x)), m);
+		vx = _mm256_blendv_ps(vx, _mm256_andnot_ps(sign, vx), m);
+		m = _mm256_andnot_ps(walk, _mm256_cmp_ps(x, x_hi, _CMP_GT_OQ));
+		x = _mm256_blendv_ps(x, _mm256_sub_ps(x_hi, _mm256_sub_ps(x, x_hi)), m);
+		vx = _mm256_blendv_ps(vx, _mm256_or_ps(sign, vx), m);
+		x = _mm256_blendv_ps(_mm256_min_ps(_mm256_max_ps(x, x_lo), x_hi), from, walk);
+
+		_mm256_storeu_ps(&pucks.x[i], x);
+		_mm256_storeu_ps(&pucks.vx[i], vx);
+
+		//hand any puck at an end line to the scalar goal checks, and walk the long steps:
+		int ends = _mm256_movemask_ps(past_end);
+		int walks = _mm256_movemask_ps(walk);
+		for (uint32_t l = 0; (ends | walks) != 0 && l < 8 && i + l < end; ++l, ends >>= 1, walks >>= 1) {
+			if (walks & 1) {
+				if (collide_substeps(pucks, i + l, max_step, arena_min, arena_max, goal_radius, radius)) return i + l;
+			} else if ((ends & 1) && collide_ends(pucks, i + l, arena_min, arena_max, goal_radius, radius)) return i + l;
+		}
+	}
+	return end;
+}
+
+#elif defined(PUCKS_SSE)
+
+static constexpr uint32_t SimdCount = 4;
+
+//SSE2 has no blendv, so select with and/andnot/or:
+static inline __m128 blend(__m128 a, __m128 b, __m128 mask) {
+	return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+}
+
+static uint32_t integrate_simd(Pucks &pucks, uint32_t begin, uint32_t end, float elapsed, float max_speed, float retain) {
+	__m128 const dt = _mm_set1_ps(elapsed);
+	__m128 const max = _mm_set1_ps(max_speed);
+	__m128 const ret = _mm_set1_ps(retain);
+	for (uint32_t i = begin; i < end; i += 4) {
+		__m128 x = _mm_loadu_ps(&pucks.x[i]);
+		__m128 y = _mm_loadu_ps(&pucks.y[i]);
+		__m128 vx = _mm_loadu_ps(&pucks.vx[i]);
+		__m128 vy = _mm_loadu_ps(&pucks.vy[i]);
+		_mm_storeu_ps(&pucks.prev_x[i], x);
+		_mm_storeu_ps(&pucks.prev_y[i], y);
+		_mm_storeu_ps(&pucks.x[i], _mm_add_ps(x, _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(&pucks.y[i], _mm_add_ps(y, _mm_mul_ps(vy, dt)));
+
+		__m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+		__m128 fast = _mm_cmplt_ps(max, speed);
+		if (_mm_movemask_ps(fast) == 0) continue;
+		__m128 amt = _mm_div_ps(_mm_add_ps(max, _mm_mul_ps(_mm_sub_ps(speed, max), ret)), speed);
+		_mm_storeu_ps(&pucks.vx[i], blend(vx, _mm_mul_ps(vx, amt), fast));
+		_mm_storeu_ps(&pucks.vy[i], blend(vy, _mm_mul_ps(vy, amt), fast));
+	}
+	return end;
+}
+
+static uint32_t collide_arena_simd(Pucks &pucks, uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+	__m128 const sign = _mm_set1_ps(-0.0f);
+	__m128 const x_lo = _mm_set1_ps(arena_min.x + radius);
+	__m128 const x_hi = _mm_set1_ps(arena_max.x - radius);
+	__m128 const y_lo = _mm_set1_ps(arena_min.y + radius);
+	__m128 const y_hi = _mm_set1_ps(arena_max.y - radius);
+	__m128 const mouth = _mm_set1_ps(goal_radius - radius);
+	__m128 const neg_mouth = _mm_xor_ps(sign, mouth);
+	__m128 const max_step2 = _mm_set1_ps(max_step * max_step);
+	__m128 const width2 = _mm_mul_ps(_mm_sub_ps(x_hi, x_lo), _mm_sub_ps(x_hi, x_lo));
+	__m128 const height2 = _mm_mul_ps(_mm_sub_ps(y_hi, y_lo), _mm_sub_ps(y_hi, y_lo));
+
+	for (uint32_t i = begin; i < end; i += 4) {
+		__m128 x = _mm_loadu_ps(&pucks.x[i]);
+		__m128 y = _mm_loadu_ps(&pucks.y[i]);
+
+		//pucks still inside have nothing to bounce off (see collide_arena_scalar), so skip blocks of only those:
+		__m128 past_side = _mm_or_ps(_mm_cmplt_ps(x, x_lo), _mm_cmpgt_ps(x, x_hi));
+		__m128 past_end = _mm_or_ps(_mm_cmplt_ps(y, y_lo), _mm_cmpgt_ps(y, y_hi));
+		__m128 out = _mm_or_ps(past_side, past_end);
+		if (_mm_movemask_ps(out) == 0) continue;
+
+		//long steps past a wall that could have met two walls (same test as collide_arena_scalar) get sub-steps instead of the single bounce below:
+		__m128 prev_x = _mm_loadu_ps(&pucks.prev_x[i]);
+		__m128 prev_y = _mm_loadu_ps(&pucks.prev_y[i]);
+		__m128 dx = _mm_sub_ps(x, prev_x);
+		__m128 dy = _mm_sub_ps(y, prev_y);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 to_mouth = _mm_and_ps(_mm_cmple_ps(_mm_min_ps(prev_x, x), mouth), _mm_cmpge_ps(_mm_max_ps(prev_x, x), neg_mouth));
+		__m128 two_walls = _mm_or_ps(
+			_mm_or_ps(_mm_and_ps(past_end, _mm_or_ps(past_side, to_mouth)), _mm_or_ps(_mm_cmplt_ps(prev_y, y_lo), _mm_cmpgt_ps(prev_y, y_hi))),
+			_mm_or_ps(_mm_cmpgt_ps(_mm_mul_ps(dx, dx), width2), _mm_cmpgt_ps(_mm_mul_ps(dy, dy), height2))
+		);
+		__m128 walk = _mm_and_ps(_mm_and_ps(out, two_walls), _mm_cmpgt_ps(d2, max_step2));
+
+		__m128 vx = _mm_loadu_ps(&pucks.vx[i]);
+
+		//side walls (same as collide_sides), for the pucks not being walked:
+		__m128 m = _mm_andnot_ps(walk, _mm_cmplt_ps(x, x_lo));
+		__m128 from = x;
+		x = blend(x, _mm_add_ps(x_lo, _mm_sub_ps(x_lo, x)), m);
+		vx = blend(vx, _mm_andnot_ps(sign, vx), m);
+		m = _mm_andnot_ps(walk, _mm_cmpgt_ps(x, x_hi));
+		x = blend(x, _mm_sub_ps(x_hi, _mm_sub_ps(x, x_hi)), m);
+		vx = blend(vx, _mm_or_ps(sign, vx), m);
+		x = blend(_mm_min_ps(_mm_max_ps(x, x_lo), x_hi), from, walk);
+
+		_mm_storeu_ps(&pucks.x[i], x);
+		_mm_storeu_ps(&pucks.vx[i], vx);
+
+		//hand any puck at an end line to the scalar goal checks, and walk the long steps:
+		int ends = _mm_movemask_ps(past_end);
+		int walks = _mm_movemask_ps(walk);
+		for (uint32_t l = 0; (ends | walks) != 0 && l < 4 && i + l < end; ++l, ends >>= 1, walks >>= 1) {
+			if (walks & 1) {
+				if (collide_substeps(pucks, i + l, max_step, arena_min, arena_max, goal_radius, radius)) return i + l;
+			} else if ((ends & 1) && collide_ends(pucks, i + l, arena_min, arena_max, goal_radius, radius)) return i + l;
+		}
+	}
+	return end;
+}
+
+#endif
+
+//---------------------------------
+
+void Pucks::integrate(uint32_t begin, uint32_t end, float elapsed, float max_speed, float retain) {
+	assert(begin % Lanes == 0 && end <= x.size());
+	uint32_t done = begin;
+	#if defined(PUCKS_SSE) || defined(PUCKS_AVX)
+	if (kernel == SIMD && end - begin >= SimdCount) done = integrate_simd(*this, begin, end, elapsed, max_speed, retain);
+	#endif
+	integrate_scalar(*this, done, end, elapsed, max_speed, retain);
+}
+
+uint32_t Pucks::collide_arena(uint32_t begin, uint32_t end, glm::vec2 const &arena_min, glm::vec2 const &arena_max, float goal_radius, float radius, float max_step) {
+	assert(begin % Lanes == 0 && end <= x.size());
+	assert(max_step > 0.0f);
+	#if defined(PUCKS_SSE) || defined(PUCKS_AVX)
+	if (kernel == SIMD && end - begin >= SimdCount) return collide_arena_simd(*this, begin, end, arena_min, arena_max, goal_radius, radius, max_step);
+	#endif
+	return collide_arena_scalar(*this, begin, end, arena_min, arena_max, goal_radius, radius, max_step);
+}
@@ -0,0 +1,392 @@
+#include "Replay.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX 1
+#endif
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+//record framing (shared with the network messages):
+static constexpr size_t FrameHeader = 4;
+static constexpr uint8_t KeyframeRecord = 'k';
+
+static void put_frame(std::vector< uint8_t > &buffer, uint8_t type, size_t size) {
+	assert(size < (1 << 24));
+	buffer.emplace_back(type);
+	buffer.emplace_back(uint8_t(size));
+	buffer.emplace_back(uint8_t(size >> 8));
+	buffer.emplace_back(uint8_t(size >> 16));
+}
+
+template< typename T >
+static void put(std::vector< uint8_t > &buffer, T const &value) {
+	static_assert(std::is_trivially_copyable_v< T >, "put() copies with memcpy.");
+	size_t at = buffer.size();
+	buffer.resize(at + sizeof(T));
+	std::memcpy(buffer.data() + at, &value, sizeof(T));
+}
+
+template< typename T >
+static T get(uint8_t const *at) {
+	T value;
+	std::memcpy(&value, at, sizeof(T));
+	return value;
+}
+
+//-----------------------------------------
+
+ReplayWriter::ReplayWriter() {
+	thread = std::thread(&ReplayWriter::run, this);
+}
+
+ReplayWriter::~ReplayWriter() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void ReplayWriter::write(std::ofstream *file, std::vector< uint8_t > &&bytes, std::unique_ptr< std::ofstream > &&close) {
+	assert(file);
+	assert(!close || close.get() == file);
+	bool now;
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		waiting += bytes.size();
+		now = (waiting >= WakeBytes || close);
+		jobs.emplace_back(Job{file, std::move(bytes), std::move(close)});
+		if (now) hurry = true;
+	}
+	if (now) wake.notify_one();
+}
+
+std::vector< uint8_t > ReplayWriter::spare() {
+	std::unique_lock< std::mutex > lock(mutex);
+	if (spares.empty()) return std::vector< uint8_t >();
+	std::vector< uint8_t > bytes = std::move(spares.back());
+	spares.pop_back();
+	return bytes;
+}
+
+void ReplayWriter::run() {
+	std::vector< Job > doing;
+	std::vector< std::ofstream * > written; //files to flush once 'doing' is written
+	while (true) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			wake.wait_for(lock, WriteInterval, [this](){ return quit || hurry; });
+			if (jobs.empty()) {
+				if (quit) break;
+				continue;
+			}
+			doing.swap(jobs);
+			waiting = 0;
+			hurry = false;
+		}
+		for (Job &job : doing) {
+			job.file->write(reinterpret_cast< char const * >(job.bytes.data()), job.bytes.size());
+			if (job.close) {
+				//(closing flushes)
+				written.erase(std::remove(written.begin(), written.end(), job.file), written.end());
+				job.close->close();
+				if (!*job.close) std::cerr << "WARNING: error writing a replay file; it may be truncated." << std::endl;
+			} else if (std::find(written.begin(), written.end(), job.file) == written.end()) {
+				written.emplace_back(job.file);
+			}
+		}
+		for (std::ofstream *file : written) {
+			file->flush(); //(so a server that gets killed leaves a readable file)
+		}
+		written.clear();
+		{ //keep the buffers around for recorders to reuse:
+			std::unique_lock< std::mutex > lock(mutex);
+			for (Job &job : doing) {
+				if (spares.size() == MaxSpares) break;
+				job.bytes.clear();
+				spares.emplace_back(std::move(job.bytes));
+			}
+		}
+		doing.clear();
+	}
+}
+
+//-----------------------------------------
+
+ReplayRecorder::ReplayRecorder(ReplayWriter &writer_, std::string const &path, Game const &game, float tick, uint32_t keyframe_interval_)
+	: keyframe_interval(keyframe_interval_), writer(writer_) {
+	if (keyframe_interval == 0) throw std::runtime_error("Replay keyframe interval must be at least one tick.");
+
+	file = std::make_unique< std::ofstream >(path, std::ios::binary);
+	if (!*file) throw std::runtime_error("Failed to open '" + path + "' to record a replay.");
+
+	ReplayHeader header;
+	header.config = game.config;
+	header.tick = tick;
+	header.history_length = game.history.length;
+	header.keyframe_interval = keyframe_interval;
+	header.puck_collisions = game.puck_collisions;
+	header.deterministic = game.deterministic;
+	buffer.reserve(BufferBytes);
+	put(buffer, header);
+
+	interval.resize(size_t(keyframe_interval) * (FrameHeader + RunSize));
+
+	record_keyframe(game);
+}
+
+ReplayRecorder::~ReplayRecorder() {
+	encode_interval();
+	writer.write(file.get(), std::move(buffer), std::move(file));
+}
+
+void ReplayRecorder::encode_interval() {
+	//record() stored each run's first tick in place of its count:
+	uint8_t *begin = interval.data(), *end = begin + interval_size;
+	for (uint8_t *at = begin; at != end; ) {
+		uint8_t *next = at + FrameHeader + at[1];
+		uint32_t first = get< uint32_t >(at + 4);
+		uint32_t next_first = (next != end ? get< uint32_t >(next + 4) : pending);
+		uint32_t count = next_first - first;
+		std::memcpy(at + 4, &count, sizeof(uint32_t));
+		at = next;
+	}
+	//(otherwise, the runs are already records)
+	buffer.insert(buffer.end(), begin, end);
+}
+
+void ReplayRecorder::end_interval(Game const &game) {
+	encode_interval();
+	ticks += pending;
+	interval_size = 0;
+	pending = 0;
+	last_types_buttons = NoRun;
+	record_keyframe(game);
+	if (buffer.size() >= HandOffBytes) {
+		//hand everything up to here to the writer:
+		std::vector< uint8_t > bytes = writer.spare();
+		bytes.swap(buffer);
+		writer.write(file.get(), std::move(bytes));
+		//(a spare already has about this much room; a fresh buffer gets it now, rather than growing into it a copy at a time)
+		buffer.reserve(BufferBytes);
+	}
+}
+
+void ReplayRecorder::record_keyframe(Game const &game) {
+	game.save(snapshot);
+	size_t start = buffer.size();
+	put_frame(buffer, KeyframeRecord, 0); //(size patched below)
+	put(buffer, ticks);
+	put(buffer, game.state_hash());
+	put(buffer, uint32_t(snapshot.bytes.size()));
+	buffer.insert(buffer.end(), snapshot.bytes.begin(), snapshot.bytes.end());
+	game.history.save(&buffer);
+
+	size_t size = buffer.size() - start - FrameHeader;
+	if (size >= (1 << 24)) throw std::runtime_error("Replay keyframe of " + std::to_string(size) + " bytes is too large to record.");
+	buffer[start + 1] = uint8_t(size);
+	buffer[start + 2] = uint8_t(size >> 8);
+	buffer[start + 3] = uint8_t(size >> 16);
+}
+
+//-----------------------------------------
+
+ReplayReader::ReplayReader(std::string const &path) {
+	//map the file:
+	#ifdef _WIN32
+	file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		file_handle = nullptr;
+		throw std::runtime_error("Failed to open replay '" + path + "'.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size)) {
+		unmap();
+		throw std::runtime_error("Failed to get size of replay '" + path + "'.");
+	}
+	size = size_t(file_size.QuadPart);
+	if (size != 0) {
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle) data = reinterpret_cast< uint8_t const * >(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (!data) {
+			unmap();
+			throw std::runtime_error("Failed to map replay '" + path + "'.");
+		}
+	}
+	#else
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Failed to open replay '" + path + "': " + std::strerror(errno));
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		unmap();
+		throw std::runtime_error("Failed to stat replay '" + path + "'.");
+	}
+	size = size_t(info.st_size);
+	if (size != 0) {
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			unmap();
+			throw std::runtime_error("Failed to map replay '" + path + "': " + std::strerror(errno));
+		}
+		data = reinterpret_cast< uint8_t const * >(mapped);
+	}
+	#endif
+
+	try {
+		//check the header:
+		if (size < sizeof(header)) throw std::runtime_error("Replay '" + path + "' is too small to hold a header.");
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, ReplayHeader().magic, sizeof(header.magic)) != 0) {
+			throw std::runtime_error("'" + path + "' isn't a replay.");
+		}
+		if (header.version != ReplayHeader::Version) {
+			throw std::runtime_error("Replay '" + path + "' is version " + std::to_string(header.version) + ", expected " + std::to_string(ReplayHeader::Version) + ".");
+		}
+		header.config.validate();
+		if (!(header.tick > 0.0f)) throw std::runtime_error("Replay '" + path + "' has a bad tick length.");
+
+		//index the records:
+		size_t at = sizeof(header);
+		size_t view_times = 0; //of the last 't' record
+		while (at + FrameHeader <= size) {
+			uint8_t type = data[at];
+			uint32_t record_size = uint32_t(data[at+1]) | (uint32_t(data[at+2]) << 8) | (uint32_t(data[at+3]) << 16);
+			size_t payload = at + FrameHeader;
+			if (payload + record_size > size) break; //truncated
+
+			if (type == ReplayRecorder::RunRecord || type == ReplayRecorder::ButtonsRunRecord) {
+				uint32_t expected = (type == ReplayRecorder::RunRecord ? ReplayRecorder::RunSize : ReplayRecorder::ButtonsRunSize);
+				if (record_size != expected) throw std::runtime_error("Replay tick record with size " + std::to_string(record_size) + " != " + std::to_string(expected) + ".");
+				uint32_t count = get< uint32_t >(data + payload);
+				if (count == 0 || count > header.keyframe_interval) throw std::runtime_error("Replay tick record with a run of " + std::to_string(count) + " ticks.");
+				uint8_t const *types = data + payload + sizeof(uint32_t);
+				if (types[0] > PLAYER_1 || types[1] > PLAYER_1) throw std::runtime_error("Replay tick record with a bad player type.");
+				if (type == ReplayRecorder::RunRecord) {
+					view_times = payload + 8;
+				} else if (view_times == 0) {
+					throw std::runtime_error("Replay buttons-only tick record with no run before it since the last keyframe.");
+				}
+				tick_offsets.insert(tick_offsets.end(), count, TickOffsets{payload + 4, view_times});
+			} else if (type == KeyframeRecord) {
+				view_times = 0; //(a 'b' never refers back past a keyframe)
+				Keyframe keyframe;
+				if (record_size < 16) throw std::runtime_error("Replay keyframe record of " + std::to_string(record_size) + " bytes is too small.");
+				keyframe.tick = get< uint32_t >(data + payload);
+				keyframe.state_hash = get< uint64_t >(data + payload + 4);
+				keyframe.snapshot_size = get< uint32_t >(data + payload + 12);
+				keyframe.snapshot_offset = payload + 16;
+				if (16 + size_t(keyframe.snapshot_size) > record_size) throw std::runtime_error("Replay keyframe snapshot overruns its record.");
+				keyframe.history_offset = keyframe.snapshot_offset + keyframe.snapshot_size;
+				keyframe.history_size = record_size - 16 - keyframe.snapshot_size;
+				if (keyframe.tick != tick_offsets.size()) {
+					throw std::runtime_error("Replay keyframe for tick " + std::to_string(keyframe.tick) + " found after " + std::to_string(tick_offsets.size()) + " ticks.");
+				}
+				keyframes.emplace_back(keyframe);
+			} else {
+				throw std::runtime_error("Replay record with unknown type " + std::to_string(int(type)) + ".");
+			}
+			at = payload + record_size;
+		}
+		if (keyframes.empty() || keyframes[0].tick != 0) throw std::runtime_error("Replay '" + path + "' doesn't start with a keyframe.");
+	} catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+ReplayReader::~ReplayReader() {
+	unmap();
+}
+
+void ReplayReader::unmap() {
+	#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	mapping_handle = file_handle = nullptr;
+	#else
+	if (data) munmap(const_cast< uint8_t * >(data), size);
+	if (fd >= 0) close(fd);
+	fd = -1;
+	#endif
+	data = nullptr;
+	size = 0;
+}
+
+void ReplayReader::setup(Game *game) const {
+	assert(game);
+	game->set_config(header.config);
+	game->puck_collisions = header.puck_collisions;
+	game->set_deterministic(header.deterministic);
+	game->history.set_length(header.history_length);
+}
+
+void ReplayReader::seek(Game *game, uint32_t tick) {
+	assert(game);
+	tick = std::min(tick, ticks());
+
+	//last keyframe at or before 'tick':
+	auto after = std::upper_bound(keyframes.begin(), keyframes.end(), tick, [](uint32_t t, Keyframe const &k) {
+		return t < k.tick;
+	});
+	assert(after != keyframes.begin()); //(keyframe 0 always exists)
+	Keyframe const &keyframe = *(after - 1);
+
+	snapshot.bytes.assign(data + keyframe.snapshot_offset, data + keyframe.snapshot_offset + keyframe.snapshot_size);
+	game->load(snapshot);
+	game->history.load(data + keyframe.history_offset, keyframe.history_size);
+
+	for (uint32_t t = keyframe.tick; t < tick; ++t) {
+		step(game, t);
+	}
+}
+
+bool ReplayReader::step(Game *game, uint32_t tick) const {
+	assert(game);
+	assert(tick < ticks());
+
+	uint8_t const *inputs = data + tick_offsets[tick].inputs;
+	uint8_t const *view_times = data + tick_offsets[tick].view_times;
+	uint32_t i = 0;
+	for (Player *player : {&game->player_0, &game->player_1}) {
+		Player::Controls &controls = player->controls;
+		uint8_t buttons = inputs[2 + i];
+		player->type = PlayerType(inputs[i]);
+		controls.left.pressed = (buttons & 0x01);
+		controls.right.pressed = (buttons & 0x02);
+		controls.up.pressed = (buttons & 0x04);
+		controls.down.pressed = (buttons & 0x08);
+		controls.jump.pressed = (buttons & 0x10);
+		controls.view_time = get< double >(view_times + i * sizeof(double));
+		i += 1;
+	}
+
+	game->update(header.tick);
+
+	//check against the keyframe recorded after this tick, if there is one:
+	if (header.keyframe_interval != 0 && (tick + 1) % header.keyframe_interval == 0) {
+		uint32_t index = (tick + 1) / header.keyframe_interval;
+		if (index < keyframes.size() && keyframes[index].tick == tick + 1) {
+			return game->state_hash() == keyframes[index].state_hash;
+		}
+	}
+	return true;
+}
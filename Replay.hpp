@@ -0,0 +1,223 @@
+#pragma once
+
+/*
+ * A replay file records one match: the server writes it as the match is played,
+ *  and ReplayMode plays it back.
+ *
+ * The file is a ReplayHeader (everything the game was simulated with) followed by
+ *  records framed like network messages, [type, size_low0, size_mid8, size_high8] + payload:
+ *   'k' keyframe: the full state after some number of ticks --
+ *       tick (u32), state_hash (u64), snapshot size (u32), a GameSnapshot, then GameHistory::save() bytes
+ *   't' ticks: a run of ticks whose update()s all saw the same inputs -- count (u32), then each player's
+ *       type (2 x u8), pressed buttons (2 x u8: left, right, up, down, jump from the low bit), view_time (2 x f64)
+ *   'b' ticks: a run that only changed types or buttons -- like 't', but without the view_times
+ *       (which are those of the run before it)
+ * Ticks count from the start of the recording. The first record is keyframe 0, and there is
+ *  another keyframe every 'keyframe_interval' ticks after it (runs don't span keyframes, and
+ *  the first run after a keyframe is always a 't').
+ *
+ * Playback restores the nearest earlier keyframe and re-simulates from there, so it only
+ *  reproduces the match exactly on a build that simulates like the server did (any build,
+ *  if the server ran in deterministic mode). Keyframe hashes catch it when it doesn't.
+ *
+ * Recording costs packing both players' inputs each tick and comparing them to the last tick's
+ *  (a tick that changes nothing just counts up its run; one that changes only buttons -- say, a
+ *  bot steering -- stores 12 bytes), then copying a keyframe interval's runs out along with a
+ *  snapshot at each keyframe; all file I/O happens on a ReplayWriter thread (one writer can serve
+ *  any number of recorders). 'bench-game replay' times a Room::tick with and without a recorder.
+ */
+
+#include "Game.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct ReplayHeader {
+	char magic[4] = {'q', 'a', 'h', 'r'};
+	uint32_t version = Version;
+	GameConfig config;
+	float tick = Game::Tick; //seconds per update()
+	uint32_t history_length = 0; //lag compensation ticks (see GameHistory)
+	uint32_t keyframe_interval = 0; //ticks
+	uint8_t puck_collisions = 0;
+	uint8_t deterministic = 0;
+	uint8_t padding[2] = {0, 0};
+
+	inline static constexpr uint32_t Version = 3; //(2: fast pucks take sub-steps against the walls; 3: state_hash covers time, epoch, and view_time)
+};
+static_assert(std::is_trivially_copyable_v< ReplayHeader >, "ReplayHeader is copied with memcpy.");
+
+//does file I/O for recorders on its own thread:
+struct ReplayWriter {
+	ReplayWriter();
+	~ReplayWriter(); //writes everything already handed over, then stops the thread
+
+	//---- called from any thread ----
+	//append 'bytes' to 'file' (and then close it, if 'close' is set; the writer owns it from then on):
+	void write(std::ofstream *file, std::vector< uint8_t > &&bytes, std::unique_ptr< std::ofstream > &&close = nullptr);
+	//an empty buffer to fill next -- one the writer is done with, if it has one, so recorders don't
+	// keep allocating (and faulting in) fresh ones:
+	std::vector< uint8_t > spare();
+
+	//the writer isn't woken for each hand-off (on a busy core, the wake-up cost the ticking thread more than
+	// recording did): it looks for work every WriteInterval, or once WakeBytes are waiting or a file is to be closed,
+	// then writes everything waiting and flushes each file once:
+	inline static constexpr std::chrono::milliseconds WriteInterval = std::chrono::milliseconds(1000);
+	inline static constexpr size_t WakeBytes = 256 * 1024;
+
+	//-- internals --
+	struct Job {
+		std::ofstream *file;
+		std::vector< uint8_t > bytes;
+		std::unique_ptr< std::ofstream > close;
+	};
+	std::mutex mutex; //guards the members below it:
+	std::condition_variable wake;
+	std::vector< Job > jobs;
+	size_t waiting = 0; //bytes in 'jobs'
+	bool hurry = false; //set (along with a notify) when jobs shouldn't wait for WriteInterval
+	std::vector< std::vector< uint8_t > > spares; //written-out buffers (emptied, but with their capacity)
+	bool quit = false;
+	inline static constexpr size_t MaxSpares = 16;
+
+	std::thread thread;
+	void run();
+};
+
+//records one game (use from the thread that updates it):
+struct ReplayRecorder {
+	//creates 'path' (throws if it can't) and records 'game' as it is now as keyframe 0:
+	ReplayRecorder(ReplayWriter &writer, std::string const &path, Game const &game, float tick, uint32_t keyframe_interval = DefaultKeyframeInterval);
+	~ReplayRecorder(); //hands the rest of the recording to the writer, which closes the file
+
+	//call right after each game.update(tick)
+	// (this runs every tick, so it only packs the players' inputs and, if they changed, starts a run; runs are copied out an interval at a time):
+	void record(Game const &game) {
+		//(the inputs as three words, so comparing them with the last tick's is three compares)
+		uint32_t types_buttons = uint32_t(game.player_0.type) | (uint32_t(game.player_1.type) << 8)
+			| (uint32_t(pack_buttons(game.player_0.controls)) << 16) | (uint32_t(pack_buttons(game.player_1.controls)) << 24);
+		uint64_t view_time_0, view_time_1;
+		std::memcpy(&view_time_0, &game.player_0.controls.view_time, sizeof(double));
+		std::memcpy(&view_time_1, &game.player_1.controls.view_time, sizeof(double));
+		bool same_view_times = (view_time_0 == last_view_time_0 && view_time_1 == last_view_time_1 && interval_size != 0);
+		bool changed = (types_buttons != last_types_buttons || !same_view_times);
+		//write the record for a run starting here either way, but only keep it if something changed
+		// (bots' buttons change unpredictably often, so this beats branching on it):
+		uint8_t *at = interval.data() + interval_size;
+		at[0] = (same_view_times ? ButtonsRunRecord : RunRecord);
+		at[1] = uint8_t(same_view_times ? ButtonsRunSize : RunSize);
+		at[2] = at[3] = 0;
+		std::memcpy(at + 4, &pending, sizeof(uint32_t)); //(the run's first tick, until encode_interval() makes it a count)
+		std::memcpy(at + 8, &types_buttons, sizeof(uint32_t)); //(type[2] then buttons[2], on the little-endian machines this runs on)
+		std::memcpy(at + 12, &view_time_0, sizeof(uint64_t)); //(past the end of a 'b', where the next record will go)
+		std::memcpy(at + 20, &view_time_1, sizeof(uint64_t));
+		interval_size += (changed ? 4 + at[1] : 0);
+		last_types_buttons = types_buttons;
+		last_view_time_0 = view_time_0;
+		last_view_time_1 = view_time_1;
+		pending += 1;
+		if (pending == keyframe_interval) end_interval(game);
+	}
+
+	inline static constexpr uint32_t DefaultKeyframeInterval = 900;
+	//the recording is handed to the writer at the first keyframe after at least this much has built up
+	// (so a server that gets killed loses about this much, plus up to ReplayWriter::WriteInterval):
+	inline static constexpr size_t HandOffBytes = 64 * 1024;
+	inline static constexpr size_t BufferBytes = 2 * HandOffBytes; //(room for a hand-off's worth, plus the interval that crosses it)
+
+	//-- internals --
+	//(everything record() touches each tick comes first, so it shares a cache line or two:)
+	uint32_t keyframe_interval;
+	uint32_t pending = 0; //ticks this interval's runs cover
+	//the last run's inputs, as record() compares them (NoRun, which no inputs pack to, at the start of an interval):
+	uint32_t last_types_buttons = NoRun;
+	size_t interval_size = 0; //bytes of records stored in 'interval' so far
+	uint64_t last_view_time_0 = 0, last_view_time_1 = 0;
+	std::vector< uint8_t > interval; //this interval's run records (sized up front for a 't' every tick, so record() neither allocates nor divides)
+	inline static constexpr uint32_t NoRun = 0xffffffff; //(packed buttons never set the high bits)
+	//run records (payload sizes; see the top of this file):
+	inline static constexpr uint8_t RunRecord = 't';
+	inline static constexpr uint8_t ButtonsRunRecord = 'b';
+	inline static constexpr uint32_t RunSize = 4 + 2 + 2 + 2 * 8;
+	inline static constexpr uint32_t ButtonsRunSize = 4 + 2 + 2;
+	static uint8_t pack_buttons(Player::Controls const &controls) {
+		return uint8_t(
+			  (controls.left.pressed ? 0x01 : 0)
+			| (controls.right.pressed ? 0x02 : 0)
+			| (controls.up.pressed ? 0x04 : 0)
+			| (controls.down.pressed ? 0x08 : 0)
+			| (controls.jump.pressed ? 0x10 : 0)
+		);
+	}
+
+	ReplayWriter &writer;
+	std::unique_ptr< std::ofstream > file;
+	uint32_t ticks = 0; //recorded up to the last keyframe
+	std::vector< uint8_t > buffer; //records not yet handed to the writer
+	GameSnapshot snapshot; //(scratch)
+	void encode_interval(); //append the run records in 'interval' to 'buffer'
+	void end_interval(Game const &game); //encode_interval(), then a keyframe, then hand off to the writer if enough has built up
+	void record_keyframe(Game const &game);
+};
+
+//reads a replay file (memory-mapped, so opening even a long one is quick):
+struct ReplayReader {
+	//maps and indexes 'path'; throws if it isn't a replay.
+	// (a truncated last record -- say, from a server that was killed -- is ignored)
+	explicit ReplayReader(std::string const &path);
+	~ReplayReader();
+	ReplayReader(ReplayReader const &) = delete;
+	ReplayReader &operator=(ReplayReader const &) = delete;
+
+	ReplayHeader header;
+
+	//number of ticks recorded:
+	uint32_t ticks() const { return uint32_t(tick_offsets.size()); }
+
+	//apply the recording's settings to 'game':
+	void setup(Game *game) const;
+
+	//put 'game' (which has been setup()) in the state after 'tick' ticks:
+	void seek(Game *game, uint32_t tick);
+
+	//advance 'game' from the state after 'tick' ticks to the next one:
+	// returns false if the result doesn't match a keyframe recorded there (the simulation has diverged)
+	bool step(Game *game, uint32_t tick) const;
+
+	//-- internals --
+	struct Keyframe {
+		uint32_t tick;
+		uint64_t state_hash;
+		size_t snapshot_offset; //into the file
+		uint32_t snapshot_size;
+		size_t history_offset;
+		uint32_t history_size;
+	};
+	std::vector< Keyframe > keyframes; //by tick
+	struct TickOffsets {
+		size_t inputs; //types and buttons of the run each tick is in
+		size_t view_times; //(which may be in an earlier run)
+	};
+	std::vector< TickOffsets > tick_offsets;
+	GameSnapshot snapshot; //(scratch)
+
+	//the mapped file:
+	uint8_t const *data = nullptr;
+	size_t size = 0;
+	#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#else
+	int fd = -1;
+	#endif
+	void unmap();
+};
@@ -0,0 +1,151 @@
+#include "ReplayMode.hpp"
+
+#include "PlayMode.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+ReplayMode::ReplayMode(std::string const &path) : reader(path) {
+	reader.setup(&game);
+	seek(0);
+	std::cout << "Replaying '" << path << "': " << reader.ticks() << " ticks (" << reader.ticks() * reader.header.tick << " seconds)." << std::endl;
+}
+
+ReplayMode::~ReplayMode() {
+}
+
+bool ReplayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
+	if (evt.type != SDL_KEYDOWN) return false;
+
+	bool shift = (evt.key.keysym.mod & KMOD_SHIFT);
+	uint32_t skip = uint32_t(std::round(SkipSeconds / reader.header.tick));
+
+	if (evt.key.keysym.sym == SDLK_SPACE) {
+		if (evt.key.repeat) return true;
+		if (!playing && tick == reader.ticks()) seek(0); //(play from the start again once at the end)
+		playing = !playing;
+		accumulated = 0.0f;
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_LEFT) {
+		if (shift) {
+			playing = false;
+			seek(tick == 0 ? 0 : tick - 1);
+		} else {
+			seek(tick < skip ? 0 : tick - skip);
+		}
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_RIGHT) {
+		if (shift) {
+			playing = false;
+			accumulated = 0.0f;
+			if (tick < reader.ticks()) step();
+		} else {
+			seek(std::min(reader.ticks(), tick + skip));
+		}
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_UP) {
+		speed = std::min(MaxSpeed, speed * 2.0f);
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_DOWN) {
+		speed = std::max(MinSpeed, speed * 0.5f);
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_HOME) {
+		seek(0);
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_END) {
+		seek(reader.ticks());
+		return true;
+	}
+
+	return false;
+}
+
+void ReplayMode::seek(uint32_t tick_) {
+	tick = std::min(tick_, reader.ticks());
+	reader.seek(&game, tick);
+	accumulated = 0.0f;
+	remember_prev();
+	recent_events.clear();
+}
+
+void ReplayMode::step() {
+	assert(tick < reader.ticks());
+	remember_prev();
+	bool matched = reader.step(&game, tick);
+	for (GameEvent const &event : game.events) {
+		recent_events.emplace_back(TimedEvent{tick * double(reader.header.tick), event});
+	}
+	tick += 1;
+	if (!matched) {
+		if (!diverged) std::cerr << "WARNING: replay diverged from the recording at tick " << tick << "; picking up again from the recorded state." << std::endl;
+		diverged = true;
+		reader.seek(&game, tick); //(lands exactly on the keyframe that didn't match)
+	}
+}
+
+void ReplayMode::remember_prev() {
+	prev_player_position[0] = game.player_0.position;
+	prev_player_position[1] = game.player_1.position;
+	prev_epoch = game.epoch;
+	prev_pucks = game.pucks;
+}
+
+void ReplayMode::update(float elapsed) {
+	if (!playing) return;
+
+	accumulated += elapsed * speed;
+	while (accumulated >= reader.header.tick && tick < reader.ticks()) {
+		accumulated -= reader.header.tick;
+		step();
+	}
+	if (tick == reader.ticks()) {
+		playing = false;
+		accumulated = 0.0f;
+	}
+}
+
+void ReplayMode::draw(glm::uvec2 const &drawable_size) {
+	//blend from the previous tick toward the current one (like PlayMode's interpolation, so that
+	// playback is smooth at any speed and frame rate; pucks jump rather than move across an epoch change):
+	float amt = std::min(1.0f, (playing ? accumulated / reader.header.tick : 1.0f));
+	glm::vec2 player_position[2] = {
+		glm::mix(prev_player_position[0], game.player_0.position, amt),
+		glm::mix(prev_player_position[1], game.player_1.position, amt)
+	};
+	if (game.grace_period > 0.0f) {
+		player_position[0] = game.player_0.position;
+		player_position[1] = game.player_1.position;
+	}
+	shown_pucks = game.pucks;
+	if (prev_epoch == game.epoch && prev_pucks.count == game.pucks.count) {
+		for (uint32_t i = 0; i < shown_pucks.count; ++i) {
+			shown_pucks.set_position(i, glm::mix(prev_pucks.position(i), game.pucks.position(i), amt));
+		}
+	}
+
+	auto clock = [](float seconds) {
+		char buffer[32];
+		uint32_t s = uint32_t(seconds);
+		std::snprintf(buffer, sizeof(buffer), "%u:%02u", s / 60, s % 60);
+		return std::string(buffer);
+	};
+	std::string caption = clock(tick * reader.header.tick) + " / " + clock(reader.ticks() * reader.header.tick);
+	if (!playing) caption += " paused";
+	else if (speed != 1.0f) caption += " x" + (speed < 1.0f ? "1/" + std::to_string(int(std::round(1.0f / speed))) : std::to_string(int(speed)));
+	if (diverged) caption += " (diverged)";
+
+	//(drawing is 'amt' of the way through the tick leading to 'tick')
+	double at = (tick == 0 ? 0.0 : (tick - 1 + amt) * double(reader.header.tick));
+	while (!recent_events.empty() && recent_events.front().time + PlayMode::FlashTime < at) {
+		recent_events.pop_front();
+	}
+	flashes.clear();
+	for (TimedEvent const &timed : recent_events) {
+		flashes.emplace_back(PlayMode::Flash{timed.event, float(at - timed.time)});
+	}
+
+	PlayMode::draw_game(drawable_size, game, player_position, shown_pucks, caption, flashes);
+}
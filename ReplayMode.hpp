@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Mode.hpp"
+
+#include "Game.hpp"
+#include "PlayMode.hpp"
+#include "Replay.hpp"
+
+#include <glm/glm.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/*
+ * ReplayMode plays back a replay file recorded by the server (see Replay.hpp).
+ *  space pauses, left/right skip back/ahead (one tick at a time with shift held),
+ *  up/down double/halve the playback speed, and home/end jump to the start/end.
+ */
+
+struct ReplayMode : Mode {
+	ReplayMode(std::string const &path); //throws if 'path' can't be read as a replay
+	virtual ~ReplayMode();
+
+	//functions called by main loop:
+	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
+	virtual void update(float elapsed) override;
+	virtual void draw(glm::uvec2 const &drawable_size) override;
+
+	//----- playback state -----
+	ReplayReader reader;
+	Game game; //state after 'tick' ticks of the recording
+	uint32_t tick = 0;
+
+	bool playing = true;
+	float speed = 1.0f;
+	float accumulated = 0.0f; //playback seconds since 'tick' (drawing blends toward the next tick by this)
+	bool diverged = false; //re-simulating stopped matching the recording at some keyframe
+
+	inline static constexpr float SkipSeconds = 5.0f;
+	inline static constexpr float MinSpeed = 1.0f / 8.0f;
+	inline static constexpr float MaxSpeed = 16.0f;
+
+	void seek(uint32_t tick); //jump to the state after 'tick' ticks
+	void step(); //advance one tick
+
+	//state before the last step, to blend from:
+	glm::vec2 prev_player_position[2] = {glm::vec2(0.0f), glm::vec2(0.0f)};
+	uint32_t prev_epoch = 0;
+	Pucks prev_pucks;
+	Pucks shown_pucks; //(scratch)
+	void remember_prev();
+
+	//hits and goals from Game::events as playback steps, flashed like PlayMode does:
+	struct TimedEvent {
+		double time = 0.0; //playback seconds (the start of the tick it happened in)
+		GameEvent event;
+	};
+	std::deque< TimedEvent > recent_events; //(cleared on seek)
+	std::vector< PlayMode::Flash > flashes; //(scratch for draw())
+};
@@ -0,0 +1,309 @@
+#include "Room.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+Room::Room(GameConfig const &config, bool puck_collisions, uint32_t history_length) : game(config) {
+	game.puck_collisions = puck_collisions;
+	game.history.set_length(history_length);
+}
+
+Room::Room(GameConfig const &config, uint32_t players) : party(std::make_unique< PartyGame >(players, config)) {
+}
+
+void Room::record(ReplayWriter &writer, std::string const &path, float tick) {
+	if (party) throw std::runtime_error("Party rooms can't be recorded.");
+	recorder = std::make_unique< ReplayRecorder >(writer, path, game, tick);
+}
+
+void Room::fill_with_bots(float lookahead_budget) {
+	if (party) throw std::runtime_error("Party rooms can't be filled with bots.");
+	use_bots = true;
+	bot_lookahead_budget = lookahead_budget;
+	seat_bots();
+}
+
+void Room::seat_bots() {
+	if (!use_bots) return;
+	while (game.next_player != NEUTRAL) {
+		Game::Seat seat = game.spawn_player();
+		bots.emplace_back(Bot{seat, BotController(seat.type), nullptr});
+		if (bot_lookahead_budget > 0.0f) {
+			//(rollouts run on the room's worker thread, since the other workers are busy with their own rooms)
+			bots.back().lookahead = std::make_unique< LookaheadBot >(seat.type, 1, bot_lookahead_budget);
+		}
+	}
+}
+
+void Room::join(SlotHandle client) {
+	std::unique_lock< std::mutex > lock(mutex);
+	inbox.emplace_back(Event{Event::Join, client, {}});
+}
+
+void Room::leave(SlotHandle client) {
+	std::unique_lock< std::mutex > lock(mutex);
+	inbox.emplace_back(Event{Event::Leave, client, {}});
+}
+
+void Room::receive(SlotHandle client, uint8_t const *data, size_t size) {
+	std::unique_lock< std::mutex > lock(mutex);
+	inbox.emplace_back(Event{Event::Receive, client, {}});
+	if (!spare.empty()) {
+		inbox.back().bytes.swap(spare.back());
+		spare.pop_back();
+	}
+	inbox.back().bytes.assign(data, data + size);
+}
+
+void Room::take_output(std::vector< Output > *output) {
+	std::unique_lock< std::mutex > lock(mutex);
+	if (output->empty()) {
+		output->swap(outbox);
+	} else {
+		std::move(outbox.begin(), outbox.end(), std::back_inserter(*output));
+		outbox.clear();
+	}
+}
+
+void Room::recycle(std::vector< Output > *output) {
+	std::unique_lock< std::mutex > lock(mutex);
+	for (Output &o : *output) {
+		if (o.bytes.capacity() == 0) continue;
+		o.bytes.clear();
+		spare.emplace_back(std::move(o.bytes));
+	}
+	output->clear();
+}
+
+Room::Timing Room::take_timing() {
+	std::unique_lock< std::mutex > lock(mutex);
+	Timing ret = timing;
+	timing = Timing();
+	return ret;
+}
+
+void Room::tick(float elapsed) {
+	auto before = std::chrono::steady_clock::now();
+
+	{ //grab what the network thread handed over (and give back last tick's buffers for it to refill):
+		std::unique_lock< std::mutex > lock(mutex);
+		for (Event &event : events) {
+			if (event.bytes.capacity() == 0) continue;
+			event.bytes.clear();
+			spare.emplace_back(std::move(event.bytes));
+		}
+		events.clear();
+		events.swap(inbox);
+		//(and enough buffers for everyone's output, if the network thread has handed that many back)
+		while (free_bytes.size() < clients.size() && !spare.empty()) {
+			free_bytes.emplace_back(std::move(spare.back()));
+			spare.pop_back();
+		}
+	}
+
+	uint64_t hits = 0, goals = 0;
+	if (party) tick_party(elapsed, &hits, &goals);
+	else tick_game(elapsed, &hits, &goals);
+	//(events are cleared at the start of the next tick, once their buffers are handed back)
+
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+
+	std::unique_lock< std::mutex > lock(mutex);
+	std::move(sent.begin(), sent.end(), std::back_inserter(outbox));
+	sent.clear();
+	timing.ticks += 1;
+	timing.total += seconds;
+	timing.max = std::max(timing.max, seconds);
+	timing.hits += hits;
+	timing.goals += goals;
+}
+
+void Room::drop_client(SlotHandle handle, Client &client, std::exception const &e) {
+	std::cout << "Disconnecting client:" << e.what() << std::endl;
+	client.closing = true;
+	client.mirror.recv_buffer.clear();
+	sent.emplace_back();
+	sent.back().client = handle;
+	sent.back().close = true;
+}
+
+std::shared_ptr< std::vector< uint8_t > const > Room::share_broadcast() {
+	//the network thread drops its references as clients' sends finish, so usually last tick's buffer is free again:
+	std::shared_ptr< std::vector< uint8_t > > *buffer = nullptr;
+	for (auto &b : broadcasts) {
+		if (b.use_count() == 1) {
+			buffer = &b;
+			break;
+		}
+	}
+	std::shared_ptr< std::vector< uint8_t > > fresh;
+	if (buffer) {
+		//(use_count() doesn't synchronize; this pairs with the release when the other thread let go, before refilling)
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} else if (broadcasts.size() < MaxBroadcasts) {
+		broadcasts.emplace_back(std::make_shared< std::vector< uint8_t > >());
+		buffer = &broadcasts.back();
+	} else {
+		fresh = std::make_shared< std::vector< uint8_t > >();
+		buffer = &fresh;
+	}
+	(*buffer)->assign(broadcast.send_buffer.data(), broadcast.send_buffer.data() + broadcast.send_buffer.size());
+	broadcast.send_buffer.clear();
+	return *buffer;
+}
+
+void Room::send_to(SlotHandle handle, Client &client, std::shared_ptr< std::vector< uint8_t > const > const &shared) {
+	sent.emplace_back();
+	Output &output = sent.back();
+	output.client = handle;
+	if (!free_bytes.empty()) {
+		output.bytes.swap(free_bytes.back());
+		free_bytes.pop_back();
+	}
+	output.bytes.assign(client.mirror.send_buffer.data(), client.mirror.send_buffer.data() + client.mirror.send_buffer.size());
+	client.mirror.send_buffer.clear();
+	output.shared = shared;
+}
+
+void Room::tick_game(float elapsed, uint64_t *hits, uint64_t *goals) {
+	for (Event &event : events) {
+		if (event.type == Event::Join) {
+			if (game.next_player == NEUTRAL && !bots.empty()) {
+				//make room by retiring a bot (PLAYER_0's first, so clients take seats in the usual order):
+				auto retire = std::min_element(bots.begin(), bots.end(), [](Bot const &a, Bot const &b) {
+					return a.seat.type < b.seat.type;
+				});
+				game.remove_player(retire->seat);
+				bots.erase(retire);
+			}
+			Client &client = clients[event.client.bits()];
+			client.seat = game.spawn_player();
+			//tell them how the game is set up:
+			game.config.send_config_message(&client.mirror);
+		} else if (event.type == Event::Leave) {
+			auto f = clients.find(event.client.bits());
+			if (f == clients.end()) continue;
+			game.remove_player(f->second.seat);
+			clients.erase(f);
+			seat_bots();
+		} else { assert(event.type == Event::Receive);
+			auto f = clients.find(event.client.bits());
+			if (f == clients.end() || f->second.closing) continue;
+			Client &client = f->second;
+			client.mirror.recv_buffer.append(event.bytes.data(), event.bytes.size());
+
+			//handle messages from client:
+			try {
+				Player *player = game.get_player(client.seat);
+				while (player->controls.recv_controls_message(&client.mirror)) { }
+			} catch (std::exception const &e) {
+				drop_client(event.client, client, e);
+			}
+		}
+	}
+
+	for (Bot &bot : bots) {
+		Player::Controls *controls = &game.get_player(bot.seat)->controls;
+		if (bot.lookahead) {
+			bot.lookahead->step = elapsed;
+			bot.lookahead->update(game, controls);
+		} else {
+			bot.controller.update(game, controls);
+		}
+	}
+
+	//update current game state
+	game.update(elapsed);
+	if (recorder) recorder->record(game);
+
+	for (GameEvent const &event : game.events) {
+		if (event.type == GameEvent::Hit) *hits += 1;
+		if (event.type == GameEvent::Goal) *goals += 1;
+	}
+
+	//what happened and the updated game state are the same for every client, so encode them once...
+	if (!game.events.empty()) Game::send_events_message(&broadcast, game.events);
+	game.send_state_message(&broadcast);
+	auto shared = share_broadcast();
+
+	//...and send each client its own ack, followed by a reference to them:
+	for (auto &[id, client] : clients) {
+		if (client.closing) continue;
+		Player *player = game.get_player(client.seat);
+		Game::send_ack_message(&client.mirror, *player);
+		send_to(SlotHandle::from_bits(id), client, shared);
+	}
+}
+
+void Room::tick_party(float elapsed, uint64_t *hits, uint64_t *goals) {
+	for (Event &event : events) {
+		if (event.type == Event::Join) {
+			Client &client = clients[event.client.bits()];
+			client.side = party->spawn_player(); //(NoSide, so watching, if every side is taken)
+			party->config.send_config_message(&client.mirror);
+		} else if (event.type == Event::Leave) {
+			auto f = clients.find(event.client.bits());
+			if (f == clients.end()) continue;
+			if (f->second.side != PartyGame::NoSide) party->remove_player(f->second.side);
+			clients.erase(f);
+		} else { assert(event.type == Event::Receive);
+			auto f = clients.find(event.client.bits());
+			if (f == clients.end() || f->second.closing) continue;
+			Client &client = f->second;
+			client.mirror.recv_buffer.append(event.bytes.data(), event.bytes.size());
+
+			//handle messages from client (watchers' controls are read, to check them, but go nowhere):
+			try {
+				Player::Controls watching;
+				Player::Controls &controls = (client.side != PartyGame::NoSide ? party->mallets[client.side].controls : watching);
+				while (controls.recv_controls_message(&client.mirror)) { }
+			} catch (std::exception const &e) {
+				drop_client(event.client, client, e);
+			}
+		}
+	}
+
+	Game::Stats before = party->stats;
+	party->update(elapsed);
+	*hits += party->stats.hits - before.hits;
+	*goals += party->stats.goals - before.goals;
+
+	//the state is the same for every client, so encode it once...
+	party->send_state_message(&broadcast);
+	auto shared = share_broadcast();
+
+	//...and send each client its own ack, followed by a reference to it:
+	for (auto &[id, client] : clients) {
+		if (client.closing) continue;
+		uint32_t seq = (client.side != PartyGame::NoSide ? party->mallets[client.side].controls.seq : 0);
+		PartyGame::send_ack_message(&client.mirror, client.side, seq);
+		send_to(SlotHandle::from_bits(id), client, shared);
+	}
+}
+
+//-----------------------------------------
+
+RoomWorker::RoomWorker(std::vector< Room * > const &rooms_, float tick_) : rooms(rooms_), tick(tick_) {
+	thread = std::thread(&RoomWorker::run, this);
+}
+
+RoomWorker::~RoomWorker() {
+	quit = true;
+	thread.join();
+}
+
+void RoomWorker::run() {
+	auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration< double >(tick);
+	while (!quit) {
+		//(like the single-room server, a late tick is caught up on rather than skipped)
+		std::this_thread::sleep_until(next_tick);
+		next_tick += std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< double >(tick));
+
+		for (Room *room : rooms) {
+			room->tick(tick);
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+/*
+ * A Room is one match hosted by the server: a Game and the clients playing or
+ *  watching it. A server process hosts many rooms, each ticked by one of a pool
+ *  of RoomWorker threads, while the main thread does all the socket work.
+ *
+ * Rooms never touch sockets: the network thread hands a room what its clients
+ *  sent (join/receive/leave), and collects what the room sent back (take_output).
+ *  Inside the room each client gets a socket-less "mirror" Connection, so the
+ *  usual Game message code reads and writes its buffers unchanged.
+ *
+ * Clients are named by handles the network thread hands out (not Connection
+ *  pointers, which get reused once a connection closes).
+ *
+ * A party room hosts a PartyGame instead: clients take its sides in turn (and
+ *  watch once they're full), and are sent a PartyGame state each tick.
+ */
+
+#include "BotController.hpp"
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "LookaheadBot.hpp"
+#include "PartyGame.hpp"
+#include "Replay.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Room {
+	//'history_length' ticks are kept for lag compensation:
+	Room(GameConfig const &config, bool puck_collisions, uint32_t history_length);
+	//a party room with 'players' sides (throws like PartyGame does); party rooms don't record or fill with bots:
+	Room(GameConfig const &config, uint32_t players);
+
+	//record every tick from now on to a replay file at 'path' (call before the room's worker starts; throws if the file can't be created):
+	void record(ReplayWriter &writer, std::string const &path, float tick);
+
+	//play any player seat no client is in with a BotController (call before the room's worker starts):
+	// (a client that joins takes a bot's seat over)
+	//with a 'lookahead_budget', bots are LookaheadBots that spend that many seconds of the room's tick deciding:
+	void fill_with_bots(float lookahead_budget = 0.0f);
+
+	//---- called from the network thread ----
+	void join(SlotHandle client);
+	void leave(SlotHandle client);
+	//(the bytes are copied into one of the room's spare buffers, so the caller can clear its own and reuse it)
+	void receive(SlotHandle client, uint8_t const *data, size_t size);
+
+	//bytes to send to a client (and whether to then disconnect it, after a malformed message):
+	struct Output {
+		SlotHandle client;
+		std::vector< uint8_t > bytes;
+		//sent after 'bytes'; the tick's events and state, encoded once and shared by every client in the room:
+		std::shared_ptr< std::vector< uint8_t > const > shared;
+		bool close = false;
+	};
+	//move everything sent since the last call to the end of 'output':
+	void take_output(std::vector< Output > *output);
+	//hand back output from take_output() once it has been sent, so the room refills its buffers instead of allocating more (clears 'output'):
+	void recycle(std::vector< Output > *output);
+
+	//tick times (and what happened, from the game's events) since the last take_timing():
+	struct Timing {
+		uint64_t ticks = 0;
+		double total = 0.0, max = 0.0; //seconds
+		uint64_t hits = 0, goals = 0;
+	};
+	Timing take_timing();
+
+	//---- called from the room's worker thread ----
+	//handle what clients sent, advance the game, and queue state for every client:
+	void tick(float elapsed);
+
+	//-- internals --
+	Game game; //(only the worker thread touches this after construction)
+	std::unique_ptr< PartyGame > party; //(party rooms play this instead of 'game')
+
+	struct Event {
+		enum Type : uint8_t { Join, Receive, Leave } type;
+		SlotHandle client;
+		std::vector< uint8_t > bytes;
+	};
+
+	std::mutex mutex; //guards the members below it:
+	std::vector< Event > inbox;
+	std::vector< std::vector< uint8_t > > spare; //emptied buffers (received events the worker is done with, recycled output) to refill
+	std::vector< Output > outbox;
+	Timing timing;
+
+	//worker-only:
+	std::vector< Event > events; //inbox, swapped out each tick
+	std::vector< Output > sent; //this tick's output, before it goes in the outbox (kept, so it doesn't reallocate every tick)
+	std::vector< std::vector< uint8_t > > free_bytes; //buffers taken from 'spare' for this tick's output
+	struct Client {
+		Game::Seat seat;
+		uint32_t side = PartyGame::NoSide; //(party rooms; NoSide if watching)
+		Connection mirror;
+		bool closing = false; //sent something malformed; ignore it until it leaves
+	};
+	std::unordered_map< uint64_t, Client > clients; //by SlotHandle::bits()
+	Connection broadcast; //(socket-less, like the mirrors) where each tick's shared events and state are encoded
+	//buffers the broadcast is handed out in, each reused once the network thread has dropped every reference to it:
+	std::vector< std::shared_ptr< std::vector< uint8_t > > > broadcasts;
+	inline static constexpr size_t MaxBroadcasts = 8; //(past this many still in flight -- say, a client that stopped reading -- new ones aren't kept)
+	std::shared_ptr< std::vector< uint8_t > const > share_broadcast(); //moves what's in 'broadcast' into one of them
+	//queue what's in a client's mirror, followed by the shared broadcast:
+	void send_to(SlotHandle handle, Client &client, std::shared_ptr< std::vector< uint8_t > const > const &shared);
+	std::unique_ptr< ReplayRecorder > recorder; //(if recording)
+	bool use_bots = false;
+	float bot_lookahead_budget = 0.0f;
+	struct Bot {
+		Game::Seat seat;
+		BotController controller;
+		std::unique_ptr< LookaheadBot > lookahead; //(plays instead of 'controller' if set)
+	};
+	std::vector< Bot > bots;
+	void seat_bots(); //put bots in any empty player seats
+
+	//the part of tick() between taking the inbox and handing over the outbox, for each kind of room:
+	void tick_game(float elapsed, uint64_t *hits, uint64_t *goals);
+	void tick_party(float elapsed, uint64_t *hits, uint64_t *goals);
+	//stop listening to a client that sent something malformed, and disconnect it:
+	void drop_client(SlotHandle handle, Client &client, std::exception const &e);
+};
+
+//ticks a fixed set of rooms every 'tick' seconds on its own thread:
+struct RoomWorker {
+	RoomWorker(std::vector< Room * > const &rooms, float tick);
+	~RoomWorker(); //stops the thread
+
+	std::vector< Room * > rooms;
+	float tick;
+
+	//-- internals --
+	std::atomic< bool > quit{false};
+	std::thread thread;
+	void run();
+};
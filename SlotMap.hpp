@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+ * SlotMap is a pool of values named by generational handles: values live in
+ *  one contiguous array of slots, freed slots are chained into a free list and
+ *  reused, and each slot counts how many times it has been reused so that a
+ *  handle to something since removed is detected instead of finding whatever
+ *  moved in after it.
+ *
+ * emplace, erase, and get are O(1), and nothing allocates once the array has
+ *  grown to the largest number of values held at once (or been reserve()'d).
+ *
+ * Handles stay valid until their value is erased. Pointers from get() are only
+ *  good until the next emplace (which may grow the array), so hold on to handles.
+ */
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//names a value in a SlotMap (any SlotMap; handles don't know which one they came from):
+struct SlotHandle {
+	uint32_t index = 0;
+	uint32_t generation = 0; //live slots have odd generations, so a default handle never names anything
+
+	bool operator==(SlotHandle const &o) const { return index == o.index && generation == o.generation; }
+	bool operator!=(SlotHandle const &o) const { return !(*this == o); }
+
+	//as one integer (e.g., to use as a map key or to stash somewhere untyped):
+	uint64_t bits() const { return (uint64_t(generation) << 32) | index; }
+	static SlotHandle from_bits(uint64_t bits) { return SlotHandle{uint32_t(bits), uint32_t(bits >> 32)}; }
+};
+
+template< typename T >
+struct SlotMap {
+	template< typename... Args >
+	SlotHandle emplace(Args &&... args);
+
+	//returns false (and does nothing) if 'handle' is stale:
+	bool erase(SlotHandle handle);
+
+	//nullptr if 'handle' is stale:
+	T *get(SlotHandle handle);
+	T const *get(SlotHandle handle) const;
+
+	uint32_t size() const { return live; }
+	bool empty() const { return live == 0; }
+	void reserve(uint32_t count) { slots.reserve(count); }
+	void clear();
+
+	//call fn(handle, value) for every value (in slot order, which is not insertion order):
+	template< typename F >
+	void for_each(F const &fn);
+	template< typename F >
+	void for_each(F const &fn) const;
+
+	//-- internals --
+	inline static constexpr uint32_t NoSlot = ~0u;
+	struct Slot {
+		T value;
+		uint32_t generation = 0; //odd while live
+		uint32_t next_free = NoSlot;
+	};
+	std::vector< Slot > slots;
+	uint32_t free_head = NoSlot;
+	uint32_t live = 0;
+};
+
+template< typename T >
+template< typename... Args >
+SlotHandle SlotMap< T >::emplace(Args &&... args) {
+	uint32_t index;
+	if (free_head != NoSlot) {
+		index = free_head;
+		free_head = slots[index].next_free;
+		slots[index].value = T(std::forward< Args >(args)...);
+	} else {
+		index = uint32_t(slots.size());
+		slots.emplace_back();
+		slots.back().value = T(std::forward< Args >(args)...);
+	}
+	Slot &slot = slots[index];
+	slot.generation += 1;
+	slot.next_free = NoSlot;
+	assert(slot.generation & 1);
+	live += 1;
+	return SlotHandle{index, slot.generation};
+}
+
+template< typename T >
+bool SlotMap< T >::erase(SlotHandle handle) {
+	if (!get(handle)) return false;
+	Slot &slot = slots[handle.index];
+	slot.value = T(); //(release anything the value holds now rather than on reuse)
+	slot.generation += 1; //(wraps after 2^31 reuses of one slot; a handle that old would be a bug anyway)
+	slot.next_free = free_head;
+	free_head = handle.index;
+	live -= 1;
+	return true;
+}
+
+template< typename T >
+T *SlotMap< T >::get(SlotHandle handle) {
+	if (handle.index >= slots.size()) return nullptr;
+	Slot &slot = slots[handle.index];
+	if (slot.generation != handle.generation || !(slot.generation & 1)) return nullptr;
+	return &slot.value;
+}
+
+template< typename T >
+T const *SlotMap< T >::get(SlotHandle handle) const {
+	return const_cast< SlotMap * >(this)->get(handle);
+}
+
+template< typename T >
+void SlotMap< T >::clear() {
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].generation & 1) erase(SlotHandle{i, slots[i].generation});
+	}
+}
+
+template< typename T >
+template< typename F >
+void SlotMap< T >::for_each(F const &fn) {
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].generation & 1) fn(SlotHandle{i, slots[i].generation}, slots[i].value);
+	}
+}
+
+template< typename T >
+template< typename F >
+void SlotMap< T >::for_each(F const &fn) const {
+	for (uint32_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].generation & 1) fn(SlotHandle{i, slots[i].generation}, slots[i].value);
+	}
+}
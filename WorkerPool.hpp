@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ * WorkerPool is a handful of threads that all run the same task once per round, while the
+ *  calling thread does its own share; GameBatch (a slice of the matches each) and LookaheadBot
+ *  (rollouts until a deadline) use it to spread a step or a decision over several cores.
+ *
+ * A round goes: write whatever the task reads, begin(), do the calling thread's part, wait().
+ *  begin() and wait() both take the pool's lock, so anything written before begin() is visible
+ *  to the threads, and anything they wrote is visible after wait().
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerPool {
+	WorkerPool() = default;
+	~WorkerPool() { resize(0, nullptr); }
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	//stop any current threads, then start 'count' that each call 'task(index)' (index in [0, count)) once per round:
+	void resize(uint32_t count, std::function< void(uint32_t) > task_) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			quit = true;
+		}
+		start.notify_all();
+		for (auto &t : threads) {
+			t.join();
+		}
+		threads.clear();
+		quit = false;
+
+		task = std::move(task_);
+		for (uint32_t i = 0; i < count; ++i) {
+			//(passing the current generation, since a round might begin before the thread gets going)
+			threads.emplace_back(&WorkerPool::thread, this, i, generation);
+		}
+	}
+	uint32_t size() const { return uint32_t(threads.size()); }
+	bool empty() const { return threads.empty(); }
+
+	//start a round on every thread...
+	void begin() {
+		if (threads.empty()) return;
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			running = uint32_t(threads.size());
+			generation += 1;
+		}
+		start.notify_all();
+	}
+	//...and wait for all of them to finish it:
+	void wait() {
+		if (threads.empty()) return;
+		std::unique_lock< std::mutex > lock(mutex);
+		finish.wait(lock, [this]() { return running == 0; });
+	}
+
+	//-- internals --
+	std::vector< std::thread > threads;
+	std::function< void(uint32_t) > task;
+	std::mutex mutex;
+	std::condition_variable start, finish;
+	uint64_t generation = 0; //bumped to begin a round
+	uint32_t running = 0; //threads still busy with the current round
+	bool quit = false;
+
+	//runs 'task(index)' for each round after generation 'seen':
+	void thread(uint32_t index, uint64_t seen) {
+		while (true) {
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				start.wait(lock, [&]() { return quit || generation != seen; });
+				if (quit) return;
+				seen = generation;
+			}
+
+			task(index);
+
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				running -= 1;
+			}
+			finish.notify_one();
+		}
+	}
+};
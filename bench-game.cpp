@@ -0,0 +1,1131 @@
+//Micro-benchmarks for the simulation code in Game.cpp / Pucks.cpp / PuckGrid.cpp.
+//Run with no arguments for everything, or pass benchmark names to run only those:
+//$ ./bench-game [pucks] [update] [broadphase] [snapshot] [batch] [spectators] [replay] [bots] [lookahead] [party] [substep] [queue] [broadcast]
+
+#include "BotController.hpp"
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "GameBatch.hpp"
+#include "LookaheadBot.hpp"
+#include "PartyGame.hpp"
+#include "Replay.hpp"
+#include "Room.hpp"
+
+#include <glm/gtx/norm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX 1
+#endif
+#undef APIENTRY
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//run 'fn' (which performs 'ticks' ticks -- or whatever 'unit' is) and report ticks/sec:
+static double time_ticks(std::string const &label, uint32_t ticks, std::function< void(uint32_t) > const &fn, std::string const &unit = "tick") {
+	fn(ticks / 10 + 1); //warm up
+
+	auto before = std::chrono::steady_clock::now();
+	fn(ticks);
+	auto after = std::chrono::steady_clock::now();
+
+	double seconds = std::chrono::duration< double >(after - before).count();
+	double rate = ticks / seconds;
+	std::cout << "  " << std::left << std::setw(28) << label << std::right
+	          << std::setw(14) << std::fixed << std::setprecision(0) << rate << " " << unit << "s/sec"
+	          << std::setw(14) << std::setprecision(1) << (seconds * 1e9 / ticks) << " ns/" << unit << std::endl;
+	return rate;
+}
+
+//CPU time the calling thread has used (so time other threads get -- even on the same core -- isn't counted):
+static double thread_seconds() {
+	#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	auto seconds = [](FILETIME const &t) { //(FILETIMEs count 100ns intervals)
+		return 1e-7 * double((uint64_t(t.dwHighDateTime) << 32) | uint64_t(t.dwLowDateTime));
+	};
+	return seconds(kernel) + seconds(user);
+	#else
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return double(now.tv_sec) + 1e-9 * double(now.tv_nsec);
+	#endif
+}
+
+//----------------------------------------------------------------
+//'pucks': integrate + arena collision passes, array-of-structs vs structure-of-arrays
+
+//the puck passes as they were written before Pucks existed (array-of-structs):
+struct LegacyPuck {
+	glm::vec2 position = glm::vec2(0.0f, 0.0f);
+	glm::vec2 velocity = glm::vec2(0.0f, 0.0f);
+	glm::vec2 prev_pos;
+	PlayerType last_hit;
+};
+
+static void legacy_tick(std::vector< LegacyPuck > &pucks, float elapsed, float goal_radius) {
+	constexpr glm::vec2 ArenaMin = Game::ArenaMin;
+	constexpr glm::vec2 ArenaMax = Game::ArenaMax;
+	constexpr float PuckRadius = Game::PuckRadius;
+	constexpr float PuckSpeed = GameConfig().puck_speed;
+	constexpr float PuckRetain = GameConfig().puck_retain;
+	float GoalRadius = goal_radius;
+
+	for (auto &puck : pucks) {
+		puck.prev_pos = puck.position;
+		puck.position += puck.velocity * elapsed;
+		float speed = std::sqrt(glm::length2(puck.velocity));
+		if (PuckSpeed < speed) {
+			puck.velocity *= (PuckSpeed + (speed - PuckSpeed) * PuckRetain) / speed;
+		}
+	}
+
+	for (auto &puck : pucks) {
+		if (puck.position.x < ArenaMin.x + PuckRadius) {
+			puck.position.x = ArenaMin.x + PuckRadius;
+			puck.velocity.x = std::abs(puck.velocity.x);
+		}
+		if (puck.position.x > ArenaMax.x - PuckRadius) {
+			puck.position.x = ArenaMax.x - PuckRadius;
+			puck.velocity.x = -std::abs(puck.velocity.x);
+		}
+		bool x_goal_min = puck.position.x < -GoalRadius + PuckRadius;
+		bool x_goal_max = puck.position.x > GoalRadius - PuckRadius;
+		bool y_min = puck.position.y < ArenaMin.y + PuckRadius;
+		bool y_max = puck.position.y > ArenaMax.y - PuckRadius;
+		if (x_goal_min || x_goal_max) {
+			if (y_min) {
+				puck.position.y = ArenaMin.y + PuckRadius;
+				puck.velocity.y = std::abs(puck.velocity.y);
+			}
+			if (y_max) {
+				puck.position.y = ArenaMax.y - PuckRadius;
+				puck.velocity.y = -std::abs(puck.velocity.y);
+			}
+		}
+		if (y_min || y_max) {
+			if (x_goal_min && puck.prev_pos.x >= -GoalRadius + PuckRadius) {
+				puck.position.x = -GoalRadius + PuckRadius;
+				puck.velocity.x = std::abs(puck.velocity.x);
+			}
+			if (x_goal_max && puck.prev_pos.x < GoalRadius - PuckRadius) {
+				puck.position.x = GoalRadius - PuckRadius;
+				puck.velocity.x = -std::abs(puck.velocity.x);
+			}
+		}
+		if (puck.position.y < ArenaMin.y - PuckRadius) break;
+		if (puck.position.y > ArenaMax.y + PuckRadius) break;
+	}
+}
+
+static void bench_pucks() {
+	constexpr GameConfig Defaults;
+	std::cout << "pucks: integrate + arena collision (goals closed so pucks bounce forever)" << std::endl;
+
+	//with a goal radius of zero every puck is "outside the goal mouth", so nothing ever scores:
+	constexpr float ClosedGoal = 0.0f;
+
+	for (uint32_t count : {5u, 64u, 1024u, 4096u}) {
+		std::cout << " " << count << " pucks:" << std::endl;
+
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+		std::vector< LegacyPuck > legacy(count);
+		Pucks pucks;
+		pucks.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			glm::vec2 p = glm::vec2(0.9f * unit(mt), 1.9f * unit(mt));
+			glm::vec2 v = 4.0f * glm::vec2(unit(mt), unit(mt));
+			legacy[i].position = p;
+			legacy[i].velocity = v;
+			pucks.set_position(i, p);
+			pucks.set_velocity(i, v);
+		}
+		Pucks reference = pucks;
+
+		uint32_t ticks = std::max(1000u, 20000000u / count);
+
+		double base = time_ticks("array-of-structs (legacy)", ticks, [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) legacy_tick(legacy, Game::Tick, ClosedGoal);
+		});
+
+		for (Pucks::Kernel kernel : {Pucks::Scalar, Pucks::SIMD}) {
+			Pucks::kernel = kernel;
+			pucks = reference;
+			double rate = time_ticks(kernel == Pucks::SIMD ? "soa simd" : "soa scalar", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					pucks.integrate(Game::Tick, Defaults.puck_speed, Defaults.puck_retain);
+					pucks.collide_arena(Game::ArenaMin, Game::ArenaMax, ClosedGoal, Game::PuckRadius, Game::MaxPuckStep);
+				}
+			});
+			std::cout << "    (" << std::setprecision(2) << rate / base << "x legacy)" << std::endl;
+		}
+
+		{ //kernels must agree bit-for-bit:
+			// (goals stay closed: once a puck scores, the kernels may leave different values in pucks the game then overwrites)
+			Pucks a = reference, b = reference;
+			for (uint32_t t = 0; t < 1000; ++t) {
+				Pucks::kernel = Pucks::Scalar;
+				a.integrate(Game::Tick, Defaults.puck_speed, Defaults.puck_retain);
+				a.collide_arena(Game::ArenaMin, Game::ArenaMax, ClosedGoal, Game::PuckRadius, Game::MaxPuckStep);
+				Pucks::kernel = Pucks::SIMD;
+				b.integrate(Game::Tick, Defaults.puck_speed, Defaults.puck_retain);
+				b.collide_arena(Game::ArenaMin, Game::ArenaMax, ClosedGoal, Game::PuckRadius, Game::MaxPuckStep);
+			}
+			bool same = std::memcmp(a.x.data(), b.x.data(), count * sizeof(float)) == 0
+			         && std::memcmp(a.y.data(), b.y.data(), count * sizeof(float)) == 0
+			         && std::memcmp(a.vx.data(), b.vx.data(), count * sizeof(float)) == 0
+			         && std::memcmp(a.vy.data(), b.vy.data(), count * sizeof(float)) == 0;
+			if (!same) std::cout << "    WARNING: scalar and simd kernels disagree!" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'update': whole Game::update with both players holding buttons
+
+static void bench_update() {
+	std::cout << "update: Game::update with both players moving" << std::endl;
+
+	for (uint32_t count : {5u, 64u, 1024u, 4096u})
+	for (Pucks::Kernel kernel : {Pucks::Scalar, Pucks::SIMD}) {
+		Pucks::kernel = kernel;
+		Game game(count, 360.0f / count);
+		game.player_0.type = PLAYER_0;
+		game.player_1.type = PLAYER_1;
+		std::string label = std::to_string(count) + " pucks, " + (kernel == Pucks::SIMD ? "simd" : "scalar");
+		time_ticks(label, std::max(2000u, 10000000u / count), [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) {
+				//sweep the mallets back and forth so they keep hitting things:
+				bool flip = (t / 45) % 2;
+				game.player_0.controls.left.pressed = flip;
+				game.player_0.controls.right.pressed = !flip;
+				game.player_0.controls.up.pressed = true;
+				game.player_1.controls.left.pressed = !flip;
+				game.player_1.controls.right.pressed = flip;
+				game.player_1.controls.down.pressed = true;
+				game.update(Game::Tick);
+			}
+		});
+	}
+}
+
+//----------------------------------------------------------------
+//'broadphase': puck/puck pairs and puck/player queries, brute force vs PuckGrid
+
+static void bench_broadphase() {
+	std::cout << "broadphase: puck/puck pair search and puck/player query (pucks scattered over the arena)" << std::endl;
+
+	constexpr float PairDist2 = (2.0f * Game::PuckRadius) * (2.0f * Game::PuckRadius);
+	constexpr float PlayerDist2 = (Game::PlayerRadius + Game::PuckRadius) * (Game::PlayerRadius + Game::PuckRadius);
+
+	for (uint32_t count : {5u, 100u, 5000u}) {
+		std::cout << " " << count << " pucks:" << std::endl;
+
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > ux(Game::ArenaMin.x, Game::ArenaMax.x);
+		std::uniform_real_distribution< float > uy(Game::ArenaMin.y, Game::ArenaMax.y);
+		Pucks pucks;
+		pucks.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			pucks.set_position(i, glm::vec2(ux(mt), uy(mt)));
+		}
+		std::array< glm::vec2, 2 > players{ glm::vec2(0.0f, -1.75f), glm::vec2(0.3f, 1.2f) };
+
+		auto touching = [&](uint32_t a, uint32_t b) {
+			return glm::length2(pucks.position(a) - pucks.position(b)) < PairDist2;
+		};
+		auto touching_player = [&](uint32_t i, glm::vec2 const &p) {
+			return glm::length2(pucks.position(i) - p) <= PlayerDist2;
+		};
+
+		uint32_t ticks = std::max(20u, 2000000u / (count * count / 16 + 1));
+		uint32_t brute_pairs = 0, grid_pairs = 0;
+		uint32_t brute_first = 0, grid_first = 0;
+
+		double base = time_ticks("brute force", ticks, [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) {
+				brute_pairs = 0;
+				for (uint32_t a = 0; a < count; ++a) {
+					for (uint32_t b = a + 1; b < count; ++b) {
+						if (touching(a, b)) brute_pairs += 1;
+					}
+				}
+				brute_first = count;
+				for (uint32_t i = 0; i < count && brute_first == count; ++i) {
+					for (auto const &p : players) {
+						if (touching_player(i, p)) brute_first = i;
+					}
+				}
+			}
+		});
+
+		PuckGrid grid;
+		grid.setup(Game::ArenaMin, Game::ArenaMax, 2.0f * Game::PuckRadius);
+		double rate = time_ticks("grid (incl. build)", ticks, [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) {
+				grid.build(pucks);
+				grid_pairs = 0;
+				grid.for_each_pair([&](uint32_t a, uint32_t b) {
+					if (touching(a, b)) grid_pairs += 1;
+				});
+				grid_first = count;
+				for (auto const &p : players) {
+					grid.query(p, Game::PlayerRadius + Game::PuckRadius, [&](uint32_t i) {
+						if (i < grid_first && touching_player(i, p)) grid_first = i;
+					});
+				}
+			}
+		});
+		std::cout << "    (" << std::setprecision(2) << rate / base << "x brute force; "
+		          << grid_pairs << " touching pairs)" << std::endl;
+
+		if (brute_pairs != grid_pairs || brute_first != grid_first) {
+			std::cout << "    WARNING: grid found " << grid_pairs << " pairs / first " << grid_first
+			          << ", brute force found " << brute_pairs << " / " << brute_first << "!" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'snapshot': Game::save / Game::load vs copying the whole Game
+
+static void bench_snapshot() {
+	std::cout << "snapshot: save/load of match state vs copy-constructing Game" << std::endl;
+
+	for (uint32_t count : {5u, 64u, 1024u, 4096u}) {
+		Game game(count, 360.0f / count);
+		game.player_0.type = PLAYER_0;
+		game.player_1.type = PLAYER_1;
+		for (uint32_t i = 0; i < 4; ++i) game.spectators.emplace();
+		game.player_0.controls.up.pressed = true;
+		for (uint32_t t = 0; t < 20; ++t) game.update(Game::Tick);
+
+		GameSnapshot snapshot;
+		Game restored(count, 360.0f / count);
+		uint32_t reps = std::max(20000u, 20000000u / count);
+		std::string label = std::to_string(count) + " pucks, ";
+
+		double base = time_ticks(label + "Game copy", reps / 4, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n; ++r) {
+				Game copy = game;
+				restored.tick_number += copy.tick_number; //(keep the copy from being optimized out)
+			}
+		}, "snapshot");
+		double rate = time_ticks(label + "save", reps, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n; ++r) game.save(snapshot);
+		}, "snapshot");
+		std::cout << "    (" << std::setprecision(2) << rate / base << "x Game copy; "
+		          << snapshot.bytes.size() << " bytes)" << std::endl;
+		time_ticks(label + "load", reps, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n; ++r) restored.load(snapshot);
+		}, "snapshot");
+		time_ticks(label + "save+load", reps, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n; ++r) {
+				game.save(snapshot);
+				restored.load(snapshot);
+			}
+		}, "snapshot");
+
+		restored.load(snapshot);
+		if (restored.state_hash() != game.state_hash()) {
+			std::cout << "    WARNING: restored state hash differs from the original!" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'batch': GameBatch::step vs a loop over separate Games
+
+static void bench_batch() {
+	std::cout << "batch: many matches stepped with GameBatch vs Game::update on each" << std::endl;
+
+	//each match's players hold a pseudo-random direction, re-picked every so often:
+	auto input_for = [](uint32_t match, uint32_t tick) {
+		uint32_t h = (match * 0x9e3779b9u) ^ ((tick / 16) * 0x85ebca6bu);
+		h ^= h >> 15; h *= 0x2c1b3c6du; h ^= h >> 12;
+		GameBatch::Input input;
+		input.player_0 = uint8_t(h & 0x0f);
+		input.player_1 = uint8_t((h >> 4) & 0x0f);
+		return input;
+	};
+	auto apply = [](uint8_t bits, Player::Controls *controls) {
+		controls->left.pressed = bits & GameBatch::Left;
+		controls->right.pressed = bits & GameBatch::Right;
+		controls->up.pressed = bits & GameBatch::Up;
+		controls->down.pressed = bits & GameBatch::Down;
+	};
+
+	std::vector< uint32_t > thread_counts{1};
+	if (std::thread::hardware_concurrency() > 1) thread_counts.emplace_back(std::thread::hardware_concurrency());
+
+	for (uint32_t matches : {1024u, 16384u}) {
+		std::cout << " " << matches << " matches, " << Game::DefaultPuckCount << " pucks each:" << std::endl;
+		uint32_t steps = std::max(20u, 2000000u / matches);
+		std::vector< GameBatch::Input > inputs(matches);
+
+		std::vector< Game > games(matches);
+		for (Game &game : games) {
+			game.player_0.type = PLAYER_0;
+			game.player_1.type = PLAYER_1;
+		}
+		uint32_t game_tick = 0;
+		double base = time_ticks("Game::update loop", steps * matches, [&](uint32_t n) {
+			for (uint32_t s = 0; s < n / matches; ++s, ++game_tick) {
+				for (uint32_t m = 0; m < matches; ++m) {
+					GameBatch::Input input = input_for(m, game_tick);
+					apply(input.player_0, &games[m].player_0.controls);
+					apply(input.player_1, &games[m].player_1.controls);
+					games[m].update(Game::Tick);
+				}
+			}
+		}, "match-tick");
+
+		for (uint32_t t : thread_counts) {
+			GameBatch batch(matches);
+			batch.set_threads(t);
+			uint32_t batch_tick = 0;
+			auto run = [&](uint32_t n) {
+				for (uint32_t s = 0; s < n / matches; ++s, ++batch_tick) {
+					for (uint32_t m = 0; m < matches; ++m) inputs[m] = input_for(m, batch_tick);
+					batch.step(inputs.data(), Game::Tick);
+				}
+			};
+			double rate = time_ticks("GameBatch, " + std::to_string(t) + " thread" + (t == 1 ? "" : "s"), steps * matches, run, "match-tick");
+			std::cout << "    (" << std::setprecision(2) << rate / base << "x Game::update loop)" << std::endl;
+
+			//catch up to the Games and compare:
+			if (batch_tick < game_tick) run((game_tick - batch_tick) * matches);
+			uint32_t mismatched = 0;
+			Game check;
+			for (uint32_t m = 0; m < matches && batch_tick == game_tick; ++m) {
+				batch.get(m, &check);
+				if (check.state_hash() != games[m].state_hash()) mismatched += 1;
+			}
+			if (batch_tick != game_tick || mismatched) {
+				std::cout << "    WARNING: " << mismatched << " batched matches differ from Game::update!" << std::endl;
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'spectators': join/leave storms, Game's slot map vs the std::list + linear scan it replaced
+
+static void bench_spectators() {
+	std::cout << "spectators: every spectator joins, then all leave in shuffled order" << std::endl;
+
+	for (uint32_t count : {100u, 1000u, 10000u}) {
+		std::cout << " " << count << " spectators:" << std::endl;
+		std::mt19937 mt(0x15466);
+		std::vector< uint32_t > order(count);
+		for (uint32_t i = 0; i < count; ++i) order[i] = i;
+		std::shuffle(order.begin(), order.end(), mt);
+		uint32_t rounds = std::max(4u, 2000000u / count);
+
+		std::list< Player > list;
+		std::vector< Player * > pointers(count);
+		double base = time_ticks("std::list (legacy)", (count <= 1000 ? rounds : rounds / 20) * count, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / count; ++r) {
+				for (uint32_t i = 0; i < count; ++i) {
+					list.emplace_back();
+					pointers[i] = &list.back();
+				}
+				for (uint32_t i : order) {
+					for (auto pi = list.begin(); pi != list.end(); ++pi) {
+						if (&*pi == pointers[i]) {
+							list.erase(pi);
+							break;
+						}
+					}
+				}
+			}
+		}, "join+leave");
+
+		Game game;
+		game.spawn_player();
+		game.spawn_player();
+		std::vector< Game::Seat > seats(count);
+		double rate = time_ticks("Game::spawn/remove_player", rounds * count, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / count; ++r) {
+				for (uint32_t i = 0; i < count; ++i) seats[i] = game.spawn_player();
+				for (uint32_t i : order) game.remove_player(seats[i]);
+			}
+		}, "join+leave");
+		std::cout << "    (" << std::setprecision(2) << rate / base << "x std::list)" << std::endl;
+
+		if (!game.spectators.empty() || game.get_player(seats[0])) {
+			std::cout << "    WARNING: spectators left over, or a stale seat still finds one!" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'replay': cost of recording each tick (the server's --record), of seeking in the result, and that seat changes replay
+
+static void bench_replay() {
+	std::cout << "replay: Room::tick and Game::update with and without ReplayRecorder::record, then ReplayReader::seek" << std::endl;
+
+	std::string path = "bench-game-replay.tmp";
+	std::string room_path = "bench-game-replay-room.tmp";
+	for (uint32_t count : {5u, 64u}) {
+		std::string label = std::to_string(count) + " pucks, ";
+		uint32_t ticks = std::max(100000u, 20000000u / count);
+
+		auto setup = [&](Game &game) {
+			game.history.set_length(15); //(the server's default lag compensation)
+			game.player_0.type = PLAYER_0;
+			game.player_1.type = PLAYER_1;
+		};
+		auto play = [&](Game &game, uint32_t n, ReplayRecorder *recorder) {
+			for (uint32_t t = 0; t < n; ++t) {
+				bool flip = (t / 45) % 2;
+				game.player_0.controls.left.pressed = flip;
+				game.player_0.controls.right.pressed = !flip;
+				game.player_0.controls.up.pressed = true;
+				game.player_1.controls.left.pressed = !flip;
+				game.player_1.controls.right.pressed = flip;
+				game.player_1.controls.down.pressed = true;
+				game.update(Game::Tick);
+				if (recorder) recorder->record(game);
+			}
+		};
+
+		Game plain(count, 360.0f / count);
+		setup(plain);
+		double base = time_ticks(label + "update", ticks, [&](uint32_t n) {
+			play(plain, n, nullptr);
+		});
+
+		Game recorded(count, 360.0f / count);
+		setup(recorded);
+		double rate = time_ticks(label + "update+record", ticks, [&](uint32_t n) {
+			ReplayWriter writer;
+			ReplayRecorder recorder(writer, path, recorded, Game::Tick);
+			play(recorded, n, &recorder);
+		});
+		std::cout << "    (recording adds " << std::setprecision(1) << 100.0 * (base / rate - 1.0) << "% to update, counting file I/O on the writer thread"
+		          << " -- which, flat out like this, is ~100000x more often than at 30 Hz)" << std::endl;
+
+		//just the part that runs on the ticking thread:
+		double record_rate;
+		{
+			ReplayWriter writer;
+			ReplayRecorder recorder(writer, path, recorded, Game::Tick);
+			record_rate = time_ticks(label + "record", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) recorder.record(recorded);
+			}, "record");
+		}
+		std::cout << "    (record on the ticking thread is " << std::setprecision(1) << 100.0 * base / record_rate << "% of an update)" << std::endl;
+
+		//what recording costs the server: a whole Room::tick (a client playing a bot, with the server's
+		// default lag compensation) with and without a recorder attached. Only the ticking thread's CPU
+		// time counts (ReplayWriter does its I/O on its own thread). A 1% difference is smaller than the
+		// drift in a machine's speed over a run, so the recorder is attached for every other short round
+		// on one room and the overhead is the mean over rounds of (with / without - 1), reported as a fraction
+		// with its variance, alongside the same comparison with no recorder on either side to show how
+		// closely this can be measured:
+		{
+			GameConfig config;
+			config.puck_count = count;
+			config.fan_angle = std::min(Game::DefaultFanAngle, 360.0f / count);
+			ReplayWriter writer;
+			Room room(config, false, 15);
+			room.fill_with_bots();
+			room.join(SlotHandle::from_bits(1));
+			std::vector< Room::Output > output;
+
+			double tick_seconds = 0.0; //(of the last comparison's plain rounds)
+			struct Overhead {
+				double mean = 0.0; //fraction of a room tick
+				double variance = 0.0; //of one round's fraction
+				double median = 0.0; //(less swayed by the rounds the writer thread or the OS got in the way of)
+				uint32_t rounds = 0;
+				//standard error of 'mean':
+				double error() const { return std::sqrt(variance / rounds); }
+			};
+			auto compare = [&](std::unique_ptr< ReplayRecorder > &recorder) {
+				constexpr uint32_t Rounds = 201, RoundTicks = 2000;
+				std::vector< double > fractions;
+				double plain_total = 0.0;
+				for (uint32_t round = 0; round < Rounds; ++round) {
+					double took[2];
+					for (uint32_t half = 0; half < 2; ++half) {
+						bool with = ((round + half) % 2 == 1); //(alternate which goes first)
+						if (with) std::swap(room.recorder, recorder);
+						double before = thread_seconds();
+						for (uint32_t t = 0; t < RoundTicks; ++t) {
+							room.tick(Game::Tick);
+							room.take_output(&output); //(as the network thread would)
+							room.recycle(&output);
+						}
+						took[with] = thread_seconds() - before;
+						if (with) std::swap(room.recorder, recorder);
+					}
+					fractions.emplace_back(took[1] / took[0] - 1.0);
+					plain_total += took[0];
+				}
+				tick_seconds = plain_total / (Rounds * RoundTicks);
+				Overhead overhead;
+				overhead.rounds = Rounds;
+				for (double r : fractions) overhead.mean += r;
+				overhead.mean /= Rounds;
+				for (double r : fractions) overhead.variance += (r - overhead.mean) * (r - overhead.mean);
+				overhead.variance /= (Rounds - 1);
+				std::nth_element(fractions.begin(), fractions.begin() + Rounds / 2, fractions.end());
+				overhead.median = fractions[Rounds / 2];
+				return overhead;
+			};
+			std::unique_ptr< ReplayRecorder > none;
+			Overhead control = compare(none);
+			//(the file skips the rounds the recorder sat out, so it's only good for timing)
+			std::unique_ptr< ReplayRecorder > recorder = std::make_unique< ReplayRecorder >(writer, room_path, room.game, Game::Tick);
+			Overhead added = compare(recorder);
+			recorder.reset();
+
+			std::cout << "  " << std::left << std::setw(28) << (label + "room tick") << std::right
+			          << std::setw(14) << std::fixed << std::setprecision(0) << (1.0 / tick_seconds) << " ticks/sec"
+			          << std::setw(14) << std::setprecision(1) << (tick_seconds * 1e9) << " ns/tick (ticking thread cpu)" << std::endl;
+			auto print = [](Overhead const &o) {
+				std::cout << std::setprecision(4) << o.mean << " +/- " << o.error()
+				          << " (median " << o.median << "; variance " << std::scientific << std::setprecision(2) << o.variance << std::fixed
+				          << " over " << o.rounds << " rounds)";
+			};
+			std::cout << "    (recording adds ";
+			print(added);
+			std::cout << " of a room tick; the budget is 0.01" << (added.mean > 0.01 ? " -- OVER BUDGET" : "") << ";" << std::endl;
+			std::cout << "     with no recorder either way: ";
+			print(control);
+			std::cout << ")" << std::endl;
+		}
+
+		ReplayReader reader(path);
+		std::cout << "    (" << std::setprecision(1) << double(reader.size) / reader.ticks() << " bytes/tick in the file)" << std::endl;
+
+		Game game;
+		reader.setup(&game);
+		std::mt19937 mt(0x15466);
+		time_ticks(label + "seek (random tick)", 20000, [&](uint32_t n) {
+			for (uint32_t i = 0; i < n; ++i) reader.seek(&game, mt() % (reader.ticks() + 1));
+		}, "seek");
+	}
+	std::remove(path.c_str());
+	std::remove(room_path.c_str());
+
+	//seat changes (a client joining retires a bot, leaving re-seats one) mustn't touch anything the
+	// recording can't see, or re-simulating the replay diverges at the next keyframe:
+	{
+		{
+			ReplayWriter writer;
+			Room room(GameConfig(), false, 15);
+			room.fill_with_bots();
+			room.recorder = std::make_unique< ReplayRecorder >(writer, path, room.game, Game::Tick, 30);
+			SlotHandle client = SlotHandle::from_bits(1);
+			Connection sent;
+			Player::Controls controls;
+			controls.right.pressed = true;
+			for (uint32_t t = 0; t < 200; ++t) {
+				if (t == 20) room.join(client);
+				if (t >= 20 && t < 45) {
+					controls.seq += 1;
+					controls.view_time = room.game.time - 0.1;
+					controls.send_controls_message(&sent);
+					room.receive(client, sent.send_buffer.data(), sent.send_buffer.size());
+					sent.send_buffer.clear();
+				}
+				if (t == 45) room.leave(client); //(mid-stride, so the seat is vacated while its mallet is moving)
+				room.tick(Game::Tick);
+			}
+		}
+		ReplayReader reader(path);
+		Game game;
+		reader.setup(&game);
+		reader.seek(&game, 0);
+		uint32_t diverged = reader.ticks();
+		for (uint32_t t = 0; t < reader.ticks() && diverged == reader.ticks(); ++t) {
+			if (!reader.step(&game, t)) diverged = t + 1;
+		}
+		if (diverged != reader.ticks()) {
+			std::cout << "  WARNING: a replay recorded across seat changes diverged at tick " << diverged << "!" << std::endl;
+		} else {
+			std::cout << "  (a replay recorded across seat changes matches over " << reader.ticks() << " ticks)" << std::endl;
+		}
+		std::remove(path.c_str());
+	}
+}
+
+//----------------------------------------------------------------
+//'bots': BotController::update cost, how bot-vs-bot matches go, and that a bot taking a seat back starts fresh
+
+static void bench_bots() {
+	std::cout << "bots: two BotControllers playing each other" << std::endl;
+
+	for (uint32_t count : {5u, 64u}) {
+		std::string label = std::to_string(count) + " pucks, ";
+		Game game(count, std::min(Game::DefaultFanAngle, 360.0f / count));
+		game.player_0.type = PLAYER_0;
+		game.player_1.type = PLAYER_1;
+		BotController bot_0(PLAYER_0), bot_1(PLAYER_1);
+
+		uint32_t ticks = 30 * 60 * 60; //an hour of play
+		double rate = time_ticks(label + "update+2 bots", ticks, [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) {
+				bot_0.update(game, &game.player_0.controls);
+				bot_1.update(game, &game.player_1.controls);
+				game.update(Game::Tick);
+			}
+		});
+		std::cout << "    (" << std::setprecision(0) << rate / 30.0 << " matches per core at 30 Hz; "
+		          << std::setprecision(1) << game.stats.goals / (game.time / 60.0) << " goals and "
+		          << game.stats.hits / (game.time / 60.0) << " hits per minute; score "
+		          << game.player_0.score << "-" << game.player_1.score << ")" << std::endl;
+
+		//just the bots, on states from the match above:
+		double bot_rate = time_ticks(label + "BotController::update", 1000000, [&](uint32_t n) {
+			for (uint32_t t = 0; t < n; ++t) {
+				bot_0.update(game, &game.player_0.controls);
+				game.pucks.x[t % game.pucks.count] += 1e-7f; //(so the work isn't hoisted out of the loop)
+			}
+		}, "bot update");
+		std::cout << "    (" << std::setprecision(0) << bot_rate / 30.0 << " bots per core at 30 Hz)" << std::endl;
+	}
+
+	//a bot that takes a seat back from a client that left must not keep that client's controls (in particular
+	// its view_time, which would have lag compensation rewinding the bot's hits for the rest of the match):
+	{
+		Room room(GameConfig(), false, 15);
+		room.fill_with_bots();
+		SlotHandle client = SlotHandle::from_bits(1);
+		room.join(client);
+		Connection sent;
+		Player::Controls controls;
+		controls.up.pressed = true;
+		for (uint32_t t = 0; t < 30; ++t) {
+			controls.seq += 1;
+			controls.view_time = room.game.time - 0.2; //(a client drawing 200ms behind)
+			controls.send_controls_message(&sent);
+			room.receive(client, sent.send_buffer.data(), sent.send_buffer.size());
+			sent.send_buffer.clear();
+			room.tick(Game::Tick);
+		}
+		room.leave(client);
+		for (uint32_t t = 0; t < 100; ++t) {
+			room.tick(Game::Tick);
+		}
+		Player const &reseated = room.game.player_0;
+		if (room.game.rewind_ticks(reseated, Game::Tick) != 0 || reseated.controls.seq != 0) {
+			std::cout << "  WARNING: a re-seated bot kept the last client's controls (rewinding "
+			          << room.game.rewind_ticks(reseated, Game::Tick) << " ticks, seq " << reseated.controls.seq << ")!" << std::endl;
+		} else {
+			std::cout << "  (a bot re-seated after a client leaves starts with fresh controls)" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'lookahead': LookaheadBot rollout rate and decision latency, and how it does against a BotController
+
+static void bench_lookahead() {
+	std::cout << "lookahead: LookaheadBot vs BotController" << std::endl;
+
+	uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+	std::vector< uint32_t > thread_counts{1};
+	if (cores > 1) thread_counts.emplace_back(cores);
+
+	for (uint32_t threads : thread_counts) {
+		for (PlayerType side : {PLAYER_0, PLAYER_1}) {
+			Game game;
+			game.player_0.type = PLAYER_0;
+			game.player_1.type = PLAYER_1;
+			LookaheadBot lookahead(side, threads, 0.005f);
+			BotController bot(side == PLAYER_0 ? PLAYER_1 : PLAYER_0);
+			Player &self = (side == PLAYER_0 ? game.player_0 : game.player_1);
+			Player &other = (side == PLAYER_0 ? game.player_1 : game.player_0);
+
+			std::vector< float > latency;
+			uint32_t ticks = 30 * 60 * 2; //two minutes of play
+			for (uint32_t t = 0; t < ticks; ++t) {
+				uint64_t decisions = lookahead.stats.decisions;
+				lookahead.update(game, &self.controls);
+				if (lookahead.stats.decisions != decisions) latency.emplace_back(lookahead.stats.last_latency);
+				bot.update(game, &other.controls);
+				game.update(Game::Tick);
+			}
+			std::sort(latency.begin(), latency.end());
+			auto percentile = [&](float p) {
+				return latency.empty() ? 0.0f : latency[std::min(latency.size() - 1, size_t(p * latency.size()))];
+			};
+
+			LookaheadBot::Stats const &stats = lookahead.stats;
+			std::string label = std::to_string(threads) + " thread" + (threads == 1 ? "" : "s") + ", as " + (side == PLAYER_0 ? "PLAYER_0" : "PLAYER_1");
+			std::cout << "  " << std::left << std::setw(28) << label << std::right
+			          << std::setw(14) << std::fixed << std::setprecision(0) << stats.rollouts / stats.seconds << " rollouts/sec"
+			          << std::setw(14) << std::setprecision(0) << stats.rollout_ticks / stats.seconds << " updates/sec" << std::endl;
+			std::cout << "    (" << std::setprecision(0) << double(stats.rollouts) / stats.decisions << " rollouts per decision; latency p50 "
+			          << std::setprecision(2) << percentile(0.5f) * 1e3f << " ms, p99 " << percentile(0.99f) * 1e3f << " ms, max "
+			          << (latency.empty() ? 0.0f : latency.back() * 1e3f) << " ms; score vs BotController "
+			          << self.score << "-" << other.score << ")" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'party': PartyGame update cost as players and copies grow, and the puck/mallet broadphase against brute force
+
+static void bench_party() {
+	std::cout << "party: N-player free-for-all" << std::endl;
+
+	for (uint32_t players : {4u, 8u, 16u}) {
+		for (uint32_t count : {5u, 64u, 1024u}) {
+			GameConfig config;
+			config.puck_count = count;
+			config.fan_angle = std::min(Game::DefaultFanAngle, 360.0f / count);
+			PartyGame game(players, config);
+			while (game.spawn_player() != PartyGame::NoSide) { }
+			std::mt19937 mt(0xfeed);
+
+			std::string label = std::to_string(players) + " players, " + std::to_string(count) + " pucks";
+			uint32_t ticks = std::max(2000u, 2000000u / (count * players));
+			time_ticks(label, ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					//(everyone mashes a new direction every 5 ticks)
+					if (t % 5 == 0) {
+						for (PartyGame::Mallet &mallet : game.mallets) {
+							uint32_t bits = mt();
+							mallet.controls.left.pressed = (bits & 1);
+							mallet.controls.right.pressed = (bits & 2);
+							mallet.controls.up.pressed = (bits & 4);
+							mallet.controls.down.pressed = (bits & 8);
+						}
+					}
+					game.update(Game::Tick);
+				}
+			});
+
+			//the contact check alone, on the state the match ended in:
+			double brute = time_ticks("  brute force", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					game.find_contact(false);
+					game.pucks.x[t % count] += 1e-7f; //(so the work isn't hoisted out of the loop)
+				}
+			}, "check");
+			double grid = time_ticks("  grid (incl. build)", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					game.grid.build(game.pucks);
+					game.find_contact(true);
+					game.pucks.x[t % count] += 1e-7f;
+				}
+			}, "check");
+
+			Connection connection;
+			game.send_state_message(&connection);
+			std::cout << "    (grid " << std::setprecision(2) << grid / brute << "x brute force; "
+			          << (count * players >= PartyGame::GridMinChecks ? "grid" : "brute force") << " used; "
+			          << connection.send_buffer.size() << " byte state message)" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'substep': wall bounces for fast pucks -- one step, adaptive sub-steps, and fixed 4x sub-steps
+
+static void bench_substep() {
+	constexpr GameConfig Defaults;
+	constexpr float NoDecay = 1e6f; //(max_speed high enough that every way of stepping follows the same velocities)
+	constexpr float Never = std::numeric_limits< float >::infinity();
+	constexpr float FastSpeed = 6.0f; //8 MaxPuckSteps per Tick
+	constexpr float SlowSpeed = 0.6f; //under one MaxPuckStep per Tick
+
+	//'pieces' steps of elapsed / pieces, each bounced with collide_arena(max_step); returns the puck that scored, if any:
+	auto tick = [&](Pucks &pucks, float elapsed, uint32_t pieces, float max_step, float goal_radius) {
+		for (uint32_t p = 0; p < pieces; ++p) {
+			pucks.integrate(elapsed / pieces, NoDecay, 1.0f);
+			uint32_t scored = pucks.collide_arena(Game::ArenaMin, Game::ArenaMax, goal_radius, Game::PuckRadius, max_step);
+			if (scored != pucks.count) return scored;
+		}
+		return pucks.count;
+	};
+
+	struct Method {
+		char const *label;
+		uint32_t pieces;
+		float max_step;
+	};
+	std::array< Method, 3 > methods{
+		Method{"one step", 1, Never},
+		Method{"adaptive", 1, Game::MaxPuckStep},
+		Method{"fixed 4x", 4, Never},
+	};
+
+	{ //cost, as more of the pucks move fast:
+		std::cout << "substep: arena passes with some of the pucks moving fast (goals closed so pucks bounce forever)" << std::endl;
+		constexpr float ClosedGoal = 0.0f;
+		constexpr uint32_t Count = 4096;
+
+		for (float fast : {0.0f, 0.1f, 1.0f}) {
+			std::cout << " " << Count << " pucks, " << std::setprecision(0) << fast * 100.0f << "% fast:" << std::endl;
+
+			std::mt19937 mt(0x5ab57e9);
+			std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+			std::uniform_real_distribution< float > angle(0.0f, 6.2831853f);
+			Pucks pucks;
+			pucks.resize(Count);
+			for (uint32_t i = 0; i < Count; ++i) {
+				float a = angle(mt);
+				float speed = (i < fast * Count ? FastSpeed : SlowSpeed);
+				pucks.set_position(i, glm::vec2(0.95f * unit(mt), 1.95f * unit(mt)));
+				pucks.set_velocity(i, speed * glm::vec2(std::cos(a), std::sin(a)));
+			}
+			Pucks const start = pucks;
+
+			double base = 0.0;
+			for (Method const &method : methods) {
+				pucks = start;
+				double rate = time_ticks(method.label, std::max(1000u, 20000000u / Count), [&](uint32_t n) {
+					for (uint32_t t = 0; t < n; ++t) tick(pucks, Game::Tick, method.pieces, method.max_step, ClosedGoal);
+				});
+				if (base == 0.0) base = rate;
+				else std::cout << "    (" << std::setprecision(2) << rate / base << "x one step)" << std::endl;
+			}
+		}
+	}
+
+	//accuracy, for fast shots into the corners. Each wall bounce on its own is exact in one step, so this is
+	// about whether a puck that bounced off a side wall crossed the end line inside the goal mouth -- which
+	// a single step gets wrong only once steps are long compared to the gap between the post and the side wall:
+	std::cout << " fast shots into the corners (wrong goal calls / mean error of the rest, against the same step in 1024 pieces):" << std::endl;
+	for (float goal_radius : {Defaults.goal_radius, 0.8f})
+	for (float elapsed : {Game::Tick, 0.1f, 0.2f}) {
+		constexpr uint32_t Shots = 20000;
+		float reach = FastSpeed * elapsed;
+
+		std::mt19937 mt(0xc0a1);
+		std::uniform_real_distribution< float > within(0.0f, 1.0f);
+		std::vector< Pucks > shots(Shots);
+		for (Pucks &shot : shots) {
+			//within a step of the far end wall and of a side wall, heading at both:
+			float side = (within(mt) < 0.5f ? -1.0f : 1.0f);
+			glm::vec2 velocity = FastSpeed * glm::normalize(glm::vec2(side * within(mt), within(mt) + 0.01f));
+			glm::vec2 position = glm::vec2(
+				side * std::max(0.0f, Game::ArenaMax.x - Game::PuckRadius - reach * within(mt)),
+				Game::ArenaMax.y - Game::PuckRadius - reach * within(mt)
+			);
+			shot.resize(1);
+			shot.set_position(0, position);
+			shot.set_velocity(0, velocity);
+		}
+
+		std::vector< bool > in(Shots);
+		std::vector< glm::vec2 > at(Shots);
+		for (uint32_t s = 0; s < Shots; ++s) {
+			Pucks reference = shots[s];
+			in[s] = (tick(reference, elapsed, 1024, Never, goal_radius) == 0);
+			at[s] = reference.position(0);
+		}
+
+		std::cout << "  goal_radius " << std::setprecision(2) << goal_radius << ", " << std::setw(4) << reach << "m steps:";
+		for (Method const &method : methods) {
+			uint32_t wrong = 0, kept = 0;
+			double total = 0.0;
+			for (uint32_t s = 0; s < Shots; ++s) {
+				Pucks pucks = shots[s];
+				bool scored = (tick(pucks, elapsed, method.pieces, method.max_step, goal_radius) == 0);
+				if (scored != in[s]) wrong += 1;
+				if (scored || in[s]) continue;
+				total += glm::length(pucks.position(0) - at[s]);
+				kept += 1;
+			}
+			std::cout << "  " << method.label << " " << std::setw(5) << wrong << " / "
+			          << std::setw(5) << std::setprecision(2) << (kept ? total / kept : 0.0) * 1e3 << " mm";
+		}
+		std::cout << std::endl;
+	}
+}
+
+//----------------------------------------------------------------
+//'queue': draining a backed-up connection, ByteQueue vs the vector + erase-from-front it replaced
+
+static void bench_queue() {
+	std::cout << "queue: parse every controls message backed up on a connection, and drain a backed-up send buffer 16 KiB at a time" << std::endl;
+
+	Player::Controls controls;
+	Connection one;
+	controls.send_controls_message(&one);
+	std::vector< uint8_t > message(one.send_buffer.data(), one.send_buffer.data() + one.send_buffer.size());
+
+	for (uint32_t count : {100u, 1000u, 10000u}) {
+		std::cout << " " << count << " messages backed up (" << count * message.size() << " bytes):" << std::endl;
+		uint32_t rounds = std::max(4u, 1000000u / count);
+		uint64_t parsed = 0, sink = 0;
+
+		std::vector< uint8_t > legacy;
+		double base = time_ticks("vector + erase (legacy)", (count <= 1000 ? rounds : rounds / 20) * count, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / count; ++r) {
+				for (uint32_t i = 0; i < count; ++i) legacy.insert(legacy.end(), message.begin(), message.end());
+				//(just the framing and the erase; the real parse below does more)
+				while (legacy.size() >= 4) {
+					uint32_t size = (uint32_t(legacy[3]) << 16) | (uint32_t(legacy[2]) << 8) | uint32_t(legacy[1]);
+					parsed += 1;
+					legacy.erase(legacy.begin(), legacy.begin() + 4 + size);
+				}
+			}
+		}, "message");
+
+		Connection connection;
+		double rate = time_ticks("ByteQueue + recv_controls", rounds * count, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / count; ++r) {
+				for (uint32_t i = 0; i < count; ++i) connection.recv_buffer.append(message.data(), message.size());
+				while (controls.recv_controls_message(&connection)) parsed += 1;
+			}
+		}, "message");
+		std::cout << "    (" << std::setprecision(2) << rate / base << "x vector + erase)" << std::endl;
+
+		//a spectator's backlog of state messages going out in socket-sized pieces:
+		size_t backlog = size_t(count) * 256;
+		size_t const Piece = 16384;
+		uint32_t pieces = uint32_t((backlog + Piece - 1) / Piece);
+		std::vector< uint8_t > state(backlog, 0x5a);
+		uint32_t drain_rounds = std::max(4u, 20000u / pieces);
+		double send_base = time_ticks("send: vector + erase", (count <= 1000 ? drain_rounds : drain_rounds / 10) * pieces, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / pieces; ++r) {
+				legacy.assign(state.begin(), state.end());
+				while (!legacy.empty()) {
+					size_t sent = std::min(Piece, legacy.size());
+					sink += legacy[sent - 1];
+					legacy.erase(legacy.begin(), legacy.begin() + sent);
+				}
+			}
+		}, "send");
+		double send_rate = time_ticks("send: ByteQueue", drain_rounds * pieces, [&](uint32_t n) {
+			for (uint32_t r = 0; r < n / pieces; ++r) {
+				connection.send_buffer.append(state.data(), state.size());
+				while (!connection.send_buffer.empty()) {
+					size_t sent = std::min(Piece, connection.send_buffer.size());
+					sink += connection.send_buffer[sent - 1];
+					connection.send_buffer.consume(sent);
+				}
+			}
+		}, "send");
+		std::cout << "    (" << std::setprecision(2) << send_rate / send_base << "x vector + erase)" << std::endl;
+
+		if (parsed == 0 || sink == 0) {
+			std::cout << "    WARNING: nothing was parsed or sent!" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+//'broadcast': a room's per-tick sends to every client, encoding the state once vs once per client
+
+static void bench_broadcast() {
+	std::cout << "broadcast: a room queueing each tick's events, ack, and state for every client" << std::endl;
+
+	//what a room hands the network thread for each client (as in Room::Output):
+	struct Output {
+		std::vector< uint8_t > bytes;
+		std::shared_ptr< std::vector< uint8_t > const > shared;
+	};
+
+	for (uint32_t pucks : {5u, 256u}) {
+		Game game(pucks, 360.0f / pucks);
+		game.player_0.type = PLAYER_0;
+		game.player_1.type = PLAYER_1;
+		game.player_0.controls.up.pressed = true;
+		for (uint32_t t = 0; t < 100; ++t) game.update(Game::Tick);
+		game.events.assign(2, GameEvent()); //(so there's an events message too)
+
+		for (uint32_t count : {100u, 1000u, 10000u}) {
+			std::cout << " " << pucks << " pucks, " << count << " clients:" << std::endl;
+			std::vector< Connection > mirrors(count);
+			std::vector< Output > sent(count);
+			uint32_t ticks = std::max(20u, 2000000u / (count * pucks));
+
+			double base = time_ticks("encode per client (legacy)", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					for (uint32_t i = 0; i < count; ++i) {
+						Game::send_events_message(&mirrors[i], game.events);
+						Game::send_ack_message(&mirrors[i], game.player_0);
+						game.send_state_message(&mirrors[i]);
+						sent[i].bytes.assign(mirrors[i].send_buffer.data(), mirrors[i].send_buffer.data() + mirrors[i].send_buffer.size());
+						mirrors[i].send_buffer.clear();
+					}
+				}
+			});
+
+			Connection broadcast;
+			std::vector< std::shared_ptr< std::vector< uint8_t > > > broadcasts; //(reused once nothing else holds them, as in Room::share_broadcast)
+			double rate = time_ticks("encode once, share", ticks, [&](uint32_t n) {
+				for (uint32_t t = 0; t < n; ++t) {
+					Game::send_events_message(&broadcast, game.events);
+					game.send_state_message(&broadcast);
+					auto free = std::find_if(broadcasts.begin(), broadcasts.end(), [](auto const &b) { return b.use_count() == 1; });
+					if (free == broadcasts.end()) free = broadcasts.emplace(broadcasts.end(), std::make_shared< std::vector< uint8_t > >());
+					std::shared_ptr< std::vector< uint8_t > const > shared = *free;
+					(*free)->assign(broadcast.send_buffer.data(), broadcast.send_buffer.data() + broadcast.send_buffer.size());
+					broadcast.send_buffer.clear();
+					for (uint32_t i = 0; i < count; ++i) {
+						Game::send_ack_message(&mirrors[i], game.player_0);
+						sent[i].bytes.assign(mirrors[i].send_buffer.data(), mirrors[i].send_buffer.data() + mirrors[i].send_buffer.size());
+						mirrors[i].send_buffer.clear();
+						sent[i].shared = shared; //(and the network thread drops last tick's)
+					}
+				}
+			});
+			std::cout << "    (" << std::setprecision(2) << rate / base << "x per-client encoding; "
+			          << sent[0].bytes.size() << " bytes per client + " << sent[0].shared->size() << " shared)" << std::endl;
+		}
+	}
+}
+
+//----------------------------------------------------------------
+
+int main(int argc, char **argv) {
+	std::vector< std::pair< std::string, std::function< void() > > > benches{
+		{"pucks", bench_pucks},
+		{"update", bench_update},
+		{"broadphase", bench_broadphase},
+		{"snapshot", bench_snapshot},
+		{"batch", bench_batch},
+		{"spectators", bench_spectators},
+		{"replay", bench_replay},
+		{"bots", bench_bots},
+		{"lookahead", bench_lookahead},
+		{"party", bench_party},
+		{"substep", bench_substep},
+		{"queue", bench_queue},
+		{"broadcast", bench_broadcast},
+	};
+
+	for (auto const &[name, fn] : benches) {
+		bool run = (argc == 1);
+		for (int a = 1; a < argc; ++a) {
+			if (name == argv[a]) run = true;
+		}
+		if (run) fn();
+	}
+
+	return 0;
+}
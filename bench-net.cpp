@@ -0,0 +1,307 @@
+//Network benchmark for Server's polling backends (select, epoll, io_uring; see Poller in Connection.hpp).
+//Each tick, the server queues an ack-sized and a state-sized message for every client and polls until
+// every client's controls-sized reply has come back. The clients are plain loopback sockets run by a child
+// process, so the server process's CPU time (reported alongside wall-clock time) is what the backend costs.
+//Each backend runs three ways: with the state copied into every connection's send_buffer ('copy'), with
+// one shared buffer queued on every connection by reference ('shared', as the server sends its broadcasts),
+// and with the ack folded into that shared buffer, so connections have nothing but shared output queued
+// ('shared-only'; a backend that only looked at send_buffer would never send it).
+//Run with no arguments for 100, 1000, and 10000 connections, or pass connection counts:
+//$ ./bench-net [--state <bytes>] [count...]
+//(POSIX only; backends that aren't available, or can't watch that many sockets, are skipped)
+
+#include "Connection.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+
+int main(int, char **) {
+	std::cerr << "bench-net needs fork(), so it doesn't run on Windows." << std::endl;
+	return 1;
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static uint32_t StateBytes = 256; //about a two-player state message with a handful of puck copies
+constexpr uint32_t AckBytes = 9; //an ack message
+constexpr uint32_t ReplyBytes = 17; //a controls message
+
+//child process: open 'count' connections to 'port', then answer every complete state message with a
+// reply until the server hangs up on all of them:
+static int run_clients(uint16_t port, uint32_t count) {
+	std::vector< struct pollfd > fds(count);
+	std::vector< uint32_t > pending(count, 0); //bytes of the next ack + state received so far
+	for (uint32_t i = 0; i < count; ++i) {
+		int s = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (s < 0 || connect(s, reinterpret_cast< struct sockaddr * >(&addr), sizeof(addr)) != 0) {
+			std::cerr << "client " << i << " failed to connect: " << strerror(errno) << std::endl;
+			return 1;
+		}
+		int one = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		fds[i].fd = s;
+		fds[i].events = POLLIN;
+	}
+
+	std::vector< char > buffer(65536);
+	std::vector< char > reply(ReplyBytes, 'c');
+	uint32_t open = count;
+	while (open > 0) {
+		int ret = ::poll(fds.data(), fds.size(), 10000);
+		if (ret <= 0) {
+			std::cerr << "clients timed out or failed waiting for the server." << std::endl;
+			return 1;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			if (fds[i].fd < 0 || !fds[i].revents) continue;
+			ssize_t got = recv(fds[i].fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+			if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+			if (got <= 0) {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				open -= 1;
+				continue;
+			}
+			pending[i] += uint32_t(got);
+			while (pending[i] >= AckBytes + StateBytes) {
+				pending[i] -= AckBytes + StateBytes;
+				send(fds[i].fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+			}
+		}
+	}
+	return 0;
+}
+
+static double cpu_seconds() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + 1e-6 * double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+//how each tick's messages are queued:
+enum class Queue {
+	Copy, //ack and state appended to send_buffer
+	Shared, //ack appended to send_buffer, state queued with send_shared
+	SharedOnly, //ack and state in one buffer, queued with send_shared
+};
+
+//one run: 'count' clients, 'ticks' timed ticks on 'backend' (returns false if the run couldn't be done):
+static bool bench_backend(Poller::Backend backend, Queue queue, uint32_t count, uint32_t ticks, uint16_t port) {
+	std::string label = std::string(Poller::name(backend))
+		+ (queue == Queue::Copy ? " copy" : queue == Queue::Shared ? " shared" : " shared-only");
+
+	//(Server and the backends log every connection, which would swamp the results)
+	std::streambuf *cout_buf = std::cout.rdbuf(nullptr);
+	std::streambuf *cerr_buf = std::cerr.rdbuf(nullptr);
+	auto restore = [&]() {
+		std::cout.clear();
+		std::cout.rdbuf(cout_buf);
+		std::cerr.clear();
+		std::cerr.rdbuf(cerr_buf);
+	};
+
+	std::unique_ptr< Server > server;
+	try {
+		server = std::make_unique< Server >(std::to_string(port), backend);
+	} catch (std::exception &e) {
+		restore();
+		std::cout << "  " << std::left << std::setw(20) << label << std::right << "(unavailable: " << e.what() << ")" << std::endl;
+		return false;
+	}
+
+	pid_t child = fork();
+	if (child < 0) {
+		restore();
+		std::cout << "  " << std::left << std::setw(20) << label << std::right << "(fork failed: " << strerror(errno) << ")" << std::endl;
+		return false;
+	}
+	if (child == 0) {
+		server.reset(); //(closes the child's copies of the server's sockets)
+		restore();
+		_exit(run_clients(port, count));
+	}
+
+	uint64_t replies = 0;
+	bool closed = false;
+	auto on_event = [&](Connection *c, Connection::Event event) {
+		if (event == Connection::OnRecv) {
+			replies += c->recv_buffer.size();
+			c->recv_buffer.clear();
+		} else if (event == Connection::OnClose) {
+			closed = true;
+		}
+	};
+
+	//wait for everyone to connect:
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	while (server->connections.size() < count && !closed && std::chrono::steady_clock::now() < deadline) {
+		server->poll(on_event, 0.01);
+	}
+
+	std::vector< uint8_t > ack(AckBytes, 'a');
+	uint64_t polls = 0;
+	auto run_ticks = [&](uint32_t n) {
+		for (uint32_t t = 0; t < n && !closed; ++t) {
+			auto state = std::make_shared< std::vector< uint8_t > >(StateBytes, 's');
+			if (queue == Queue::SharedOnly) state->insert(state->begin(), ack.begin(), ack.end());
+			for (auto &c : server->connections) {
+				if (queue == Queue::Copy) {
+					c.send_raw(ack.data(), ack.size());
+					c.send_raw(state->data(), state->size());
+				} else if (queue == Queue::Shared) {
+					c.send_raw(ack.data(), ack.size());
+					c.send_shared(state);
+				} else {
+					c.send_shared(state);
+				}
+			}
+			uint64_t expected = replies + uint64_t(count) * ReplyBytes;
+			auto tick_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (replies < expected && !closed) {
+				server->poll(on_event, 0.1);
+				polls += 1;
+				if (std::chrono::steady_clock::now() > tick_deadline) closed = true;
+			}
+		}
+	};
+
+	bool ok = (server->connections.size() == count);
+	double wall = 0.0, cpu = 0.0;
+	if (ok) {
+		run_ticks(std::max(2u, ticks / 10)); //warm up
+		polls = 0;
+		double cpu_before = cpu_seconds();
+		auto before = std::chrono::steady_clock::now();
+		run_ticks(ticks);
+		auto after = std::chrono::steady_clock::now();
+		cpu = cpu_seconds() - cpu_before;
+		wall = std::chrono::duration< double >(after - before).count();
+		ok = !closed;
+	}
+
+	//hang up on everyone (the child exits once they've all gone):
+	for (auto &c : server->connections) {
+		c.close();
+	}
+	server->poll(nullptr, 0.0);
+	int status = 0;
+	waitpid(child, &status, 0);
+	server.reset();
+	restore();
+
+	if (!ok) {
+		std::cout << "  " << std::left << std::setw(20) << label << std::right << "(clients didn't all connect or answer; out of descriptors?)" << std::endl;
+		return false;
+	}
+	std::cout << "  " << std::left << std::setw(20) << label << std::right
+	          << std::setw(10) << std::fixed << std::setprecision(0) << (ticks / wall) << " ticks/sec"
+	          << std::setw(10) << std::setprecision(1) << (wall * 1e6 / ticks) << " us/tick"
+	          << std::setw(10) << std::setprecision(1) << (cpu * 1e6 / ticks) << " us/tick server cpu"
+	          << std::setw(8) << std::setprecision(0) << (cpu * 1e9 / ticks / count) << " ns/connection"
+	          << std::setw(8) << std::setprecision(1) << (double(polls) / ticks) << " polls/tick" << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	//------------ argument parsing ------------
+
+	std::vector< uint32_t > counts;
+
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t./bench-net [--state <bytes>] [count...]\n"
+		             "\t--state: size of the state message sent each tick (default " << StateBytes << ")\n"
+		             "\tcount: connections to run with (default 100, 1000, and 10000)" << std::endl;
+	};
+
+	//(stoul itself would take "10x" as 10, or wrap a negative number around):
+	auto count_arg = [](std::string const &arg) -> uint32_t {
+		if (arg.empty() || arg.find_first_not_of("0123456789") != std::string::npos) throw std::invalid_argument("'" + arg + "' isn't a count");
+		unsigned long value = std::stoul(arg);
+		if (value > std::numeric_limits< uint32_t >::max()) throw std::out_of_range("'" + arg + "' is too large");
+		return uint32_t(value);
+	};
+
+	try {
+		for (int argi = 1; argi < argc; ++argi) {
+			std::string arg = argv[argi];
+			if (arg == "--state" && argi + 1 < argc) {
+				StateBytes = count_arg(argv[++argi]);
+			} else if (!arg.empty() && arg[0] != '-') {
+				counts.emplace_back(count_arg(arg));
+			} else {
+				usage();
+				return 1;
+			}
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "Bad argument: " << e.what() << std::endl;
+		usage();
+		return 1;
+	}
+	if (StateBytes == 0 || std::find(counts.begin(), counts.end(), 0u) != counts.end()) {
+		usage();
+		return 1;
+	}
+	if (counts.empty()) counts = {100u, 1000u, 10000u};
+
+	//each connection is a descriptor in both processes, so ask for as many as allowed:
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	std::cout << "net: each tick, send a " << AckBytes << "-byte ack and a " << StateBytes << "-byte state to every loopback client and wait for all of their " << ReplyBytes << "-byte replies" << std::endl;
+	uint16_t port = 15800;
+	for (uint32_t count : counts) {
+		std::cout << " " << count << " connections:" << std::endl;
+		uint32_t ticks = std::max(20u, 100000u / count);
+		for (Poller::Backend backend : {Poller::Select, Poller::Epoll, Poller::IoUring}) {
+			port += 1; //(a fresh port each run, so the last run's closed connections don't get in the way)
+			if (count + 16 > limit.rlim_cur) {
+				std::cout << "  " << std::left << std::setw(20) << Poller::name(backend) << std::right << "(skipped: only " << limit.rlim_cur << " descriptors allowed)" << std::endl;
+				continue;
+			}
+			if (backend == Poller::Select && count + 16 > FD_SETSIZE) {
+				std::cout << "  " << std::left << std::setw(20) << Poller::name(backend) << std::right << "(skipped: can't watch more than " << FD_SETSIZE << " descriptors)" << std::endl;
+				continue;
+			}
+			bool first = true;
+			for (Queue queue : {Queue::Copy, Queue::Shared, Queue::SharedOnly}) {
+				if (!first) port += 1;
+				first = false;
+				bench_backend(backend, queue, count, ticks, port);
+			}
+		}
+	}
+
+	return 0;
+}
+
+#endif
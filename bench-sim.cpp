@@ -0,0 +1,226 @@
+//Headless simulation benchmark: drives Game::update with scripted controls and
+// reports throughput, per-tick latency percentiles, and gameplay event rates.
+//This is the baseline to measure any change to the simulation hot path against.
+//
+//With --deterministic, also prints a digest of every tick's state hash; runs with the same
+// controls should print the same digest on any platform/compiler (and with either puck kernel).
+//
+//Controls files hold two bytes per tick (player 0, then player 1), each a bitmask of
+// pressed buttons (see ControlBits below); files shorter than the run are looped.
+//
+//With --record, the run is also recorded to a replay file (compare against a run without to see
+// what recording adds to each tick).
+
+#include "Game.hpp"
+#include "Replay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum ControlBits : uint8_t {
+	Left = 0x01,
+	Right = 0x02,
+	Up = 0x04,
+	Down = 0x08,
+	Jump = 0x10,
+};
+
+static void apply_controls(uint8_t bits, Player::Controls *controls) {
+	auto set = [](Button &b, bool pressed) {
+		if (pressed && !b.pressed) b.downs += 1;
+		b.pressed = pressed;
+	};
+	set(controls->left, bits & Left);
+	set(controls->right, bits & Right);
+	set(controls->up, bits & Up);
+	set(controls->down, bits & Down);
+	set(controls->jump, bits & Jump);
+}
+
+//pseudo-random "player": holds a random direction for a random number of ticks:
+static std::vector< uint8_t > random_controls(uint64_t ticks, uint32_t seed) {
+	std::mt19937 mt(seed);
+	std::vector< uint8_t > stream(ticks * 2);
+	for (uint32_t p = 0; p < 2; ++p) {
+		uint8_t bits = 0;
+		uint32_t hold = 0;
+		for (uint64_t t = 0; t < ticks; ++t) {
+			if (hold == 0) {
+				bits = uint8_t(mt() & (Left | Right | Up | Down));
+				hold = 3 + mt() % 20;
+			}
+			hold -= 1;
+			stream[t * 2 + p] = bits;
+		}
+	}
+	return stream;
+}
+
+int main(int argc, char **argv) {
+	//------------ argument parsing ------------
+
+	uint64_t ticks = 1000000;
+	uint32_t puck_count = Game::DefaultPuckCount;
+	bool puck_collisions = false;
+	bool deterministic = false;
+	bool scalar = false;
+	float tick = Game::Tick;
+	uint32_t seed = 15466;
+	std::string controls_file, save_controls_file, record_file;
+
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t./bench-sim [--ticks <count>] [--pucks <count>] [--puck-collisions] [--tick-hz <rate>]\n"
+		             "\t             [--seed <seed>] [--controls <file>] [--save-controls <file>]\n"
+		             "\t             [--deterministic] [--scalar] [--record <file>]\n"
+		             "\t--ticks: ticks to simulate; may use an 'M' suffix for millions (default 1M)\n"
+		             "\t--controls: replay controls from a file instead of generating them\n"
+		             "\t--save-controls: write the controls that were used to a file\n"
+		             "\t--deterministic: run in deterministic mode and report a digest of the per-tick state hashes\n"
+		             "\t--scalar: use the scalar puck kernels instead of SIMD\n"
+		             "\t--record: also record a replay of the run (as the server's --record does)" << std::endl;
+	};
+
+	try {
+		for (int argi = 1; argi < argc; ++argi) {
+			std::string arg = argv[argi];
+			bool has_value = argi + 1 < argc;
+			if (arg == "--ticks" && has_value) {
+				std::string val = argv[++argi];
+				double scale = 1.0;
+				if (!val.empty() && (val.back() == 'M' || val.back() == 'm')) {
+					scale = 1e6;
+					val.pop_back();
+				}
+				ticks = uint64_t(std::stod(val) * scale);
+			} else if (arg == "--pucks" && has_value) {
+				puck_count = uint32_t(std::stoul(argv[++argi]));
+			} else if (arg == "--puck-collisions") {
+				puck_collisions = true;
+			} else if (arg == "--deterministic") {
+				deterministic = true;
+			} else if (arg == "--scalar") {
+				scalar = true;
+			} else if (arg == "--tick-hz" && has_value) {
+				tick = 1.0f / std::stof(argv[++argi]);
+			} else if (arg == "--seed" && has_value) {
+				seed = uint32_t(std::stoul(argv[++argi]));
+			} else if (arg == "--controls" && has_value) {
+				controls_file = argv[++argi];
+			} else if (arg == "--save-controls" && has_value) {
+				save_controls_file = argv[++argi];
+			} else if (arg == "--record" && has_value) {
+				record_file = argv[++argi];
+			} else {
+				usage();
+				return 1;
+			}
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "Bad argument: " << e.what() << std::endl;
+		usage();
+		return 1;
+	}
+	if (ticks == 0) {
+		usage();
+		return 1;
+	}
+
+	//------------ controls ------------
+
+	std::vector< uint8_t > stream;
+	if (!controls_file.empty()) {
+		std::ifstream in(controls_file, std::ios::binary);
+		stream.assign(std::istreambuf_iterator< char >(in), std::istreambuf_iterator< char >());
+		if (stream.size() < 2 || stream.size() % 2 != 0) {
+			std::cerr << "Controls file '" << controls_file << "' should hold two bytes per tick." << std::endl;
+			return 1;
+		}
+	} else {
+		stream = random_controls(ticks, seed);
+	}
+	if (!save_controls_file.empty()) {
+		std::ofstream out(save_controls_file, std::ios::binary);
+		out.write(reinterpret_cast< char const * >(stream.data()), stream.size());
+	}
+	uint64_t stream_ticks = stream.size() / 2;
+
+	//------------ simulate ------------
+
+	Game game(puck_count, std::min(Game::DefaultFanAngle, 360.0f / puck_count));
+	game.puck_collisions = puck_collisions;
+	game.set_deterministic(deterministic);
+	if (scalar) Pucks::kernel = Pucks::Scalar;
+	game.player_0.type = PLAYER_0;
+	game.player_1.type = PLAYER_1;
+
+	//(writer declared first so it outlives the recorder and finishes the file)
+	std::unique_ptr< ReplayWriter > replay_writer;
+	std::unique_ptr< ReplayRecorder > recorder;
+	if (!record_file.empty()) {
+		replay_writer = std::make_unique< ReplayWriter >();
+		recorder = std::make_unique< ReplayRecorder >(*replay_writer, record_file, game, tick);
+	}
+
+	std::vector< uint32_t > ns(ticks);
+	uint64_t digest = 0;
+
+	auto before = std::chrono::steady_clock::now();
+	auto prev = before;
+	for (uint64_t t = 0; t < ticks; ++t) {
+		uint64_t s = t % stream_ticks;
+		apply_controls(stream[s * 2 + 0], &game.player_0.controls);
+		apply_controls(stream[s * 2 + 1], &game.player_1.controls);
+
+		game.update(tick);
+		if (recorder) recorder->record(game);
+		digest = (digest ^ game.tick_hash) * 0x100000001b3ull;
+
+		auto now = std::chrono::steady_clock::now();
+		ns[t] = uint32_t(std::min< int64_t >(UINT32_MAX, std::chrono::duration_cast< std::chrono::nanoseconds >(now - prev).count()));
+		prev = now;
+	}
+	double seconds = std::chrono::duration< double >(prev - before).count();
+
+	//------------ report ------------
+
+	double simulated = double(ticks) * tick;
+	std::cout << "Simulated " << ticks << " ticks (" << std::fixed << std::setprecision(0) << simulated << " s of play at "
+	          << 1.0f / tick << " Hz) with " << game.pucks.count << " pucks"
+	          << (puck_collisions ? " (puck collisions on)" : "") << (recorder ? ", recording" : "") << "." << std::endl;
+
+	std::cout << "  throughput: " << std::setprecision(0) << ticks / seconds << " ticks/sec ("
+	          << std::setprecision(1) << seconds * 1e9 / ticks << " ns/tick mean, includes timer overhead)" << std::endl;
+
+	std::cout << "  ns/tick:";
+	for (double pct : {50.0, 90.0, 99.0, 99.9}) {
+		auto at = ns.begin() + std::min< size_t >(ns.size() - 1, size_t(pct / 100.0 * ns.size()));
+		std::nth_element(ns.begin(), at, ns.end());
+		std::cout << "  p" << std::setprecision(pct == 99.9 ? 1 : 0) << pct << " " << *at;
+	}
+	std::cout << "  max " << *std::max_element(ns.begin(), ns.end()) << std::endl;
+
+	auto rate = [&](char const *name, uint64_t count) {
+		std::cout << "  " << std::left << std::setw(12) << name << std::right << std::setw(12) << count
+		          << std::setw(12) << std::setprecision(2) << count / simulated << " /sim sec"
+		          << std::setw(16) << std::setprecision(0) << count / seconds << " /wall sec" << std::endl;
+	};
+	rate("collisions", game.stats.hits + game.stats.puck_hits);
+	rate("forks", game.stats.forks);
+	rate("goals", game.stats.goals);
+
+	if (deterministic) {
+		std::cout << "  state hash digest: " << std::hex << std::setfill('0') << std::setw(16) << digest
+		          << " (last tick " << std::setw(16) << game.tick_hash << ")" << std::endl;
+	}
+
+	return 0;
+}
@@ -1,4 +1,6 @@
+#include "PartyMode.hpp"
 #include "PlayMode.hpp"
+#include "ReplayMode.hpp"
 
 #include "Connection.hpp"
 #include "Mode.hpp"
@@ -14,6 +16,7 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <string>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -34,13 +37,39 @@ int main(int argc, char **argv) {
 	try {
 #endif
 	//------------ command line arguments ------------
-	if (argc != 3) {
-		std::cerr << "Usage:\n\t./client <host> <port>" << std::endl;
-		return 1;
+	float delay = PlayMode::DefaultDelay;
+	bool party = false;
+	std::string replay_path;
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t./client <host> <port> [--delay <ms>] [--party]\n"
+		             "\t--delay: how far behind the server to draw, to smooth over network jitter (default "
+		          << int(PlayMode::DefaultDelay * 1000.0f) << ")\n"
+		             "\t--party: play in a free-for-all room (for servers started with --party)\n"
+		             "or, to watch a match recorded with ./server --record:\n\t./client --replay <file>" << std::endl;
+	};
+	if (argc == 3 && std::string(argv[1]) == "--replay") {
+		replay_path = argv[2];
+	} else {
+		if (argc < 3) {
+			usage();
+			return 1;
+		}
+		for (int argi = 3; argi < argc; ++argi) {
+			std::string arg = argv[argi];
+			if (arg == "--delay" && argi + 1 < argc) {
+				delay = std::stof(argv[++argi]) / 1000.0f;
+			} else if (arg == "--party") {
+				party = true;
+			} else {
+				usage();
+				return 1;
+			}
+		}
 	}
 
-	//------------ connect to server --------------
-	Client client(argv[1], argv[2]);
+	//------------ connect to server (unless replaying) --------------
+	std::unique_ptr< Client > client;
+	if (replay_path.empty()) client = std::make_unique< Client >(argv[1], argv[2]);
 
 	//------------  initialization ------------
 
@@ -109,7 +138,13 @@ int main(int argc, char **argv) {
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
-	Mode::set_current(std::make_shared< PlayMode >(client));
+	if (!replay_path.empty()) {
+		Mode::set_current(std::make_shared< ReplayMode >(replay_path));
+	} else if (party) {
+		Mode::set_current(std::make_shared< PartyMode >(*client));
+	} else {
+		Mode::set_current(std::make_shared< PlayMode >(*client, delay));
+	}
 
 	//------------ main loop ------------
 
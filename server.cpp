@@ -4,12 +4,57 @@
 #include "hex_dump.hpp"
 
 #include "Game.hpp"
+#include "Room.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
+#include <iomanip>
 #include <cassert>
-#include <unordered_map>
+#include <memory>
+#include <thread>
+
+//how long the network thread waits for socket activity before passing on what rooms sent:
+static constexpr double PollTimeout = 0.002;
+
+//print per-room tick times (and how busy that keeps each worker) since the last report:
+static void report(std::vector< std::unique_ptr< Room > > const &rooms, std::vector< uint32_t > const &room_population, uint32_t threads, float tick) {
+	struct Row {
+		uint32_t room;
+		Room::Timing timing;
+	};
+	std::vector< Row > rows;
+	std::vector< double > worker_busy(threads, 0.0);
+	uint64_t ticks = 0;
+	double total = 0.0;
+	for (uint32_t r = 0; r < rooms.size(); ++r) {
+		rows.emplace_back(Row{r, rooms[r]->take_timing()});
+		worker_busy[r % threads] += rows.back().timing.total;
+		ticks += rows.back().timing.ticks;
+		total += rows.back().timing.total;
+	}
+	if (ticks == 0) return;
+
+	//everything a worker does per period happens once per tick, so its load is busy time over ticks elapsed:
+	double period = double(rows[0].timing.ticks) * tick;
+	double busiest = *std::max_element(worker_busy.begin(), worker_busy.end());
+
+	std::cout << "Rooms: " << std::fixed << std::setprecision(1) << (total / ticks) * 1e6 << " us/tick mean over " << rooms.size() << " rooms";
+	if (period > 0.0) std::cout << "; busiest worker at " << std::setprecision(0) << 100.0 * busiest / period << "% of its tick budget";
+	std::cout << "." << std::endl;
+
+	//the slowest few rooms (by worst tick):
+	std::sort(rows.begin(), rows.end(), [](Row const &a, Row const &b) { return a.timing.max > b.timing.max; });
+	for (uint32_t i = 0; i < rows.size() && i < 5; ++i) {
+		Row const &row = rows[i];
+		if (row.timing.ticks == 0) continue;
+		std::cout << "  room " << row.room << " (" << room_population[row.room] << " clients): "
+		          << std::setprecision(1) << (row.timing.total / row.timing.ticks) * 1e6 << " us/tick mean, "
+		          << row.timing.max * 1e6 << " us max; " << row.timing.hits << " hits, " << row.timing.goals << " goals" << std::endl;
+	}
+}
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -32,89 +77,230 @@ int main(int argc, char **argv) {
 
 	//------------ argument parsing ------------
 
-	if (argc != 2) {
-		std::cerr << "Usage:\n\t./server <port>" << std::endl;
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t./server <port> [--pucks <count>] [--fan-angle <degrees>] [--puck-collisions] [--tick-hz <rate>] [--lag-compensation <ms>]\n"
+		             "\t         [--puck-speed <speed>] [--puck-retain <fraction>] [--accel-halflife <seconds>] [--goal-radius <radius>]\n"
+		             "\t         [--rooms <count>] [--threads <count>] [--report <seconds>] [--record <prefix>] [--bots] [--bot-lookahead <ms>]\n"
+		             "\t         [--poller <select|epoll|io_uring>] [--party <players>]" << std::endl;
+		std::cerr << "\t--pucks: number of superposed puck copies, 1-" << Game::MaxPuckCount << " (default " << Game::DefaultPuckCount << ")" << std::endl;
+		std::cerr << "\t--fan-angle: angle between neighboring copies when struck (default " << Game::DefaultFanAngle << ", or spread over 360 for large counts)" << std::endl;
+		std::cerr << "\t--puck-collisions: puck copies bounce off each other" << std::endl;
+		std::cerr << "\t--tick-hz: simulation/send rate (default " << 1.0f / Game::Tick << "; collisions are swept, so 15-20 is fine)" << std::endl;
+		std::cerr << "\t--lag-compensation: how far back to check hits against what clients saw (default 500; 0 to disable)" << std::endl;
+		std::cerr << "\t--puck-speed, --puck-retain: pucks above this speed keep this fraction of the excess each step (default " << GameConfig().puck_speed << ", " << GameConfig().puck_retain << ")" << std::endl;
+		std::cerr << "\t--accel-halflife: seconds for a mallet to reach half its target velocity (default " << GameConfig().player_accel_halflife << ")" << std::endl;
+		std::cerr << "\t--goal-radius: half-width of the goal mouths (default " << GameConfig().goal_radius << ")" << std::endl;
+		std::cerr << "\t--rooms: matches to host; clients fill each room's players (two, or --party's count) in turn, then spectate (default 1)" << std::endl;
+		std::cerr << "\t--threads: worker threads to tick rooms on (default: one per core, at most one per room)" << std::endl;
+		std::cerr << "\t--report: seconds between room tick time reports (default 10; 0 to disable)" << std::endl;
+		std::cerr << "\t--record: record each room to a replay file named <prefix>-<room>.replay (watch with ./client --replay)" << std::endl;
+		std::cerr << "\t--bots: computer players fill any player seat no client is in (and give it up when one joins)" << std::endl;
+		std::cerr << "\t--bot-lookahead: bots try out moves by simulating ahead for this long each tick, which makes them much stronger (implies --bots)" << std::endl;
+		std::cerr << "\t--party: host free-for-all rooms for " << PartyGame::MinPlayers << "-" << PartyGame::MaxPlayers << " players instead of two-player matches (join with ./client --party; not with --puck-collisions, --record, or bots)" << std::endl;
+		std::cerr << "\t--poller: how to wait on sockets; epoll (Linux only) has no connection limit and scales with activity, select is portable, io_uring (Linux 6.0+) batches each poll's sends and receives into one system call (default " << Poller::name(Poller::Default) << ")" << std::endl;
+	};
+
+	if (argc < 2) {
+		usage();
 		return 1;
 	}
 
+	GameConfig config;
+	float fan_angle = -1.0f;
+	bool puck_collisions = false;
+	float tick = Game::Tick;
+	float lag_compensation = 0.5f;
+	uint32_t room_count = 1;
+	uint32_t threads = 0;
+	float report_interval = 10.0f;
+	std::string record_prefix;
+	bool bots = false;
+	float bot_lookahead = 0.0f;
+	Poller::Backend poller = Poller::Default;
+	uint32_t party_players = 0;
+	for (int argi = 2; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--pucks" && argi + 1 < argc) {
+			config.puck_count = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--fan-angle" && argi + 1 < argc) {
+			fan_angle = std::stof(argv[++argi]);
+		} else if (arg == "--puck-collisions") {
+			puck_collisions = true;
+		} else if (arg == "--tick-hz" && argi + 1 < argc) {
+			tick = 1.0f / std::stof(argv[++argi]);
+		} else if (arg == "--lag-compensation" && argi + 1 < argc) {
+			lag_compensation = std::stof(argv[++argi]) / 1000.0f;
+		} else if (arg == "--puck-speed" && argi + 1 < argc) {
+			config.puck_speed = std::stof(argv[++argi]);
+		} else if (arg == "--puck-retain" && argi + 1 < argc) {
+			config.puck_retain = std::stof(argv[++argi]);
+		} else if (arg == "--accel-halflife" && argi + 1 < argc) {
+			config.player_accel_halflife = std::stof(argv[++argi]);
+		} else if (arg == "--goal-radius" && argi + 1 < argc) {
+			config.goal_radius = std::stof(argv[++argi]);
+		} else if (arg == "--rooms" && argi + 1 < argc) {
+			room_count = std::max(1u, uint32_t(std::stoul(argv[++argi])));
+		} else if (arg == "--threads" && argi + 1 < argc) {
+			threads = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--report" && argi + 1 < argc) {
+			report_interval = std::stof(argv[++argi]);
+		} else if (arg == "--record" && argi + 1 < argc) {
+			record_prefix = argv[++argi];
+		} else if (arg == "--bots") {
+			bots = true;
+		} else if (arg == "--bot-lookahead" && argi + 1 < argc) {
+			bots = true;
+			bot_lookahead = std::stof(argv[++argi]) / 1000.0f;
+		} else if (arg == "--party" && argi + 1 < argc) {
+			party_players = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--poller" && argi + 1 < argc) {
+			std::string name = argv[++argi];
+			if (name == Poller::name(Poller::Select)) poller = Poller::Select;
+			else if (name == Poller::name(Poller::Epoll)) poller = Poller::Epoll;
+			else if (name == Poller::name(Poller::IoUring)) poller = Poller::IoUring;
+			else {
+				usage();
+				return 1;
+			}
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (party_players != 0 && (party_players < PartyGame::MinPlayers || party_players > PartyGame::MaxPlayers || puck_collisions || !record_prefix.empty() || bots)) {
+		usage();
+		return 1;
+	}
+	if (fan_angle < 0.0f) {
+		//don't let a large number of copies wrap around on itself:
+		fan_angle = std::min(Game::DefaultFanAngle, 360.0f / std::max(1u, config.puck_count));
+	}
+	config.fan_angle = fan_angle;
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, room_count);
+
 	//------------ initialization ------------
 
-	Server server(argv[1]);
+	Server server(argv[1], poller);
+
+	//keep enough history to rewind 'lag_compensation' seconds:
+	uint32_t history_length = uint32_t(std::ceil(std::max(0.0f, lag_compensation) / tick));
+
+	//(declared before the rooms, so it outlives their recorders and writes out everything they hand it)
+	std::unique_ptr< ReplayWriter > replay_writer;
+	if (!record_prefix.empty()) replay_writer = std::make_unique< ReplayWriter >();
+
+	std::vector< std::unique_ptr< Room > > rooms;
+	for (uint32_t r = 0; r < room_count; ++r) {
+		if (party_players) {
+			rooms.emplace_back(std::make_unique< Room >(config, party_players));
+			continue;
+		}
+		rooms.emplace_back(std::make_unique< Room >(config, puck_collisions, history_length));
+		if (bots) rooms.back()->fill_with_bots(bot_lookahead);
+		if (replay_writer) {
+			std::string path = record_prefix + "-" + std::to_string(r) + ".replay";
+			rooms.back()->record(*replay_writer, path, tick);
+			std::cout << "Recording room " << r << " to '" << path << "'." << std::endl;
+		}
+	}
+	std::cout << "Hosting " << rooms.size() << (party_players ? " " + std::to_string(party_players) + "-player party" : "") << " room" << (rooms.size() == 1 ? "" : "s") << " on " << threads << " thread" << (threads == 1 ? "" : "s")
+	          << ", playing with " << config.puck_count << " pucks, fanned " << config.fan_angle << " degrees apart"
+	          << " (polling with " << Poller::name(poller) << ")." << std::endl;
+
+	//rooms are dealt out to workers round-robin, and stay with them:
+	std::vector< std::unique_ptr< RoomWorker > > workers;
+	for (uint32_t w = 0; w < threads; ++w) {
+		std::vector< Room * > owned;
+		for (uint32_t r = w; r < rooms.size(); r += threads) {
+			owned.emplace_back(rooms[r].get());
+		}
+		workers.emplace_back(std::make_unique< RoomWorker >(owned, tick));
+	}
 
 	//------------ main loop ------------
 
-	//keep track of which connection is controlling which player:
-	std::unordered_map< Connection *, Player * > connection_to_player;
-	//keep track of game state:
-	Game game;
+	//keep track of which connection is in which room; rooms know clients by handle (since Connection
+	// pointers get reused), and each connection keeps its handle in its tag:
+	struct ClientInfo {
+		Connection *connection = nullptr;
+		uint32_t room = 0;
+	};
+	SlotMap< ClientInfo > clients;
+	std::vector< uint32_t > room_population(rooms.size(), 0);
 
-	while (true) {
-		static auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration< double >(Game::Tick);
-		//process incoming data from clients until a tick has elapsed:
-		while (true) {
-			auto now = std::chrono::steady_clock::now();
-			double remain = std::chrono::duration< double >(next_tick - now).count();
-			if (remain < 0.0) {
-				next_tick += std::chrono::duration< double >(Game::Tick);
-				break;
-			}
+	//new clients fill the first room with an open player slot, or else watch the emptiest room:
+	uint32_t seats = (party_players ? party_players : 2);
+	auto pick_room = [&]() {
+		for (uint32_t r = 0; r < rooms.size(); ++r) {
+			if (room_population[r] < seats) return r;
+		}
+		return uint32_t(std::min_element(room_population.begin(), room_population.end()) - room_population.begin());
+	};
 
-			//helper used on client close (due to quit) and server close (due to error):
-			auto remove_connection = [&](Connection *c) {
-				auto f = connection_to_player.find(c);
-				assert(f != connection_to_player.end());
-				game.remove_player(f->second);
-				connection_to_player.erase(f);
-			};
+	auto remove_connection = [&](Connection *c) {
+		SlotHandle handle = SlotHandle::from_bits(c->tag);
+		ClientInfo *info = clients.get(handle);
+		assert(info);
+		rooms[info->room]->leave(handle);
+		room_population[info->room] -= 1;
+		clients.erase(handle);
+	};
 
-			server.poll([&](Connection *c, Connection::Event evt){
-				if (evt == Connection::OnOpen) {
-					//client connected:
+	std::vector< Room::Output > output;
+	auto next_report = std::chrono::steady_clock::now() + std::chrono::duration< double >(report_interval);
 
-					//create some player info for them:
-					connection_to_player.emplace(c, game.spawn_player());
+	while (true) {
+		//hand incoming data to the rooms:
+		// (a short timeout, so state the rooms send goes out promptly)
+		server.poll([&](Connection *c, Connection::Event evt){
+			if (evt == Connection::OnOpen) {
+				//client connected:
+				uint32_t room = pick_room();
+				SlotHandle handle = clients.emplace(ClientInfo{c, room});
+				c->tag = handle.bits();
+				room_population[room] += 1;
+				rooms[room]->join(handle);
 
-				} else if (evt == Connection::OnClose) {
-					//client disconnected:
+			} else if (evt == Connection::OnClose) {
+				//client disconnected:
+				remove_connection(c);
 
-					remove_connection(c);
+			} else { assert(evt == Connection::OnRecv);
+				//got data from client; the room's worker will parse it:
+				SlotHandle handle = SlotHandle::from_bits(c->tag);
+				ClientInfo *info = clients.get(handle);
+				assert(info);
+				//(copied into a buffer the room recycles, so neither side allocates once they're warmed up)
+				rooms[info->room]->receive(handle, c->recv_buffer.data(), c->recv_buffer.size());
+				c->recv_buffer.clear();
+			}
+		}, PollTimeout);
 
-				} else { assert(evt == Connection::OnRecv);
-					//got data from client:
-					//std::cout << "current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
-
-					//look up in players list:
-					auto f = connection_to_player.find(c);
-					assert(f != connection_to_player.end());
-					Player &player = *f->second;
-
-					//handle messages from client:
-					try {
-						bool handled_message;
-						do {
-							handled_message = false;
-							if (player.controls.recv_controls_message(c)) handled_message = true;
-						} while (handled_message);
-					} catch (std::exception const &e) {
-						std::cout << "Disconnecting client:" << e.what() << std::endl;
-						c->close();
-						remove_connection(c);
-					}
+		//send what the rooms have produced:
+		for (auto &room : rooms) {
+			room->take_output(&output);
+			for (Room::Output &o : output) {
+				ClientInfo *info = clients.get(o.client);
+				if (!info) continue; //(left since)
+				Connection *c = info->connection;
+				c->send_buffer.append(o.bytes.data(), o.bytes.size());
+				c->send_shared(o.shared); //(a reference, not a copy)
+				if (o.close) {
+					c->close();
+					remove_connection(c);
 				}
-			}, remain);
+			}
+			room->recycle(&output); //(the bytes have been copied, so the room can refill their buffers)
 		}
 
-		//update current game state
-		game.update(Game::Tick);
-
-		//send updated game state to all clients
-		for (auto &[c, player] : connection_to_player) {
-			game.send_state_message(c, player);
+		//report room tick times:
+		if (report_interval > 0.0f && std::chrono::steady_clock::now() >= next_report) {
+			next_report += std::chrono::duration< double >(report_interval);
+			report(rooms, room_population, threads, tick);
 		}
-
 	}
 
-
 	return 0;
 
 #ifdef _WIN32
@@ -0,0 +1,372 @@
+//Headless parameter sweep: plays bot-vs-bot matches for every combination of the given
+// GameConfig values and writes one CSV row of statistics per combination.
+//
+//Each config's matches are split into blocks that run as one GameBatch each; blocks are
+// spread over worker threads that steal from each other when they run out, so a slow
+// corner of the grid (e.g., many pucks) doesn't leave the other cores idle.
+//
+//Results only depend on the arguments (not on the thread count or scheduling):
+// every block seeds its bots from (seed, config, block).
+//
+//Example:
+//$ ./tools/sweep --puck_speed 2,3,4 --goal_radius 0.2,0.27,0.35 --out sweep.csv
+
+#include "GameBatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------
+//bots
+
+//a simple defender: chase whichever copy is nearest its own goal while that copy is on its side,
+// staying a little goal-side of it so the hit sends it back up the table; otherwise drift home.
+//'noise' is the chance per decision that it mashes a random direction instead.
+struct Bots {
+	uint64_t state;
+	float noise;
+	Bots(uint64_t seed, float noise_) : state(seed * 0x9e3779b97f4a7c15ull + 1), noise(noise_) { }
+
+	uint32_t next() {
+		//(xorshift64*)
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return uint32_t((state * 0x2545f4914f6cdd1dull) >> 32);
+	}
+
+	uint8_t input(GameBatch const &batch, uint32_t match, uint32_t p) {
+		if ((next() & 0xffff) < uint32_t(noise * 65536.0f)) {
+			return uint8_t(next() & (GameBatch::Left | GameBatch::Right | GameBatch::Up | GameBatch::Down));
+		}
+
+		float toward = (p == 0 ? 1.0f : -1.0f); //direction of the other player's goal
+		float goal_y = (p == 0 ? Game::ArenaMin.y : Game::ArenaMax.y);
+		glm::vec2 home = (p == 0 ? Game::Player0Start : Game::Player1Start);
+		glm::vec2 at = glm::vec2(batch.players[p].x[match], batch.players[p].y[match]);
+
+		uint32_t base = match * batch.stride;
+		uint32_t threat = base;
+		for (uint32_t i = base + 1; i < base + batch.initial.pucks.count; ++i) {
+			if (std::abs(batch.pucks.y[i] - goal_y) < std::abs(batch.pucks.y[threat] - goal_y)) threat = i;
+		}
+		glm::vec2 puck = batch.pucks.position(threat);
+
+		glm::vec2 target;
+		if (puck.y * toward < 0.0f) {
+			target = glm::vec2(puck.x, puck.y - toward * 0.5f * Game::PlayerRadius);
+		} else {
+			target = glm::vec2(0.5f * puck.x, home.y);
+		}
+
+		constexpr float Slack = 0.02f;
+		uint8_t bits = 0;
+		if (target.x < at.x - Slack) bits |= GameBatch::Left;
+		if (target.x > at.x + Slack) bits |= GameBatch::Right;
+		if (target.y < at.y - Slack) bits |= GameBatch::Down;
+		if (target.y > at.y + Slack) bits |= GameBatch::Up;
+		return bits;
+	}
+};
+
+//---------------------------------------------
+//statistics
+
+struct Results {
+	uint64_t matches = 0;
+	uint64_t ticks = 0;
+	uint64_t goals[2] = {0, 0}; //by player 0, by player 1
+	uint64_t hits = 0;
+	uint64_t rallies = 0; //(serve-to-goal; rallies still going when a match ends aren't counted)
+	uint64_t rally_ticks = 0, rally_hits = 0;
+	uint64_t longest_rally_ticks = 0;
+
+	void add(Results const &o) {
+		matches += o.matches;
+		ticks += o.ticks;
+		goals[0] += o.goals[0];
+		goals[1] += o.goals[1];
+		hits += o.hits;
+		rallies += o.rallies;
+		rally_ticks += o.rally_ticks;
+		rally_hits += o.rally_hits;
+		longest_rally_ticks = std::max(longest_rally_ticks, o.longest_rally_ticks);
+	}
+};
+
+//play 'matches' matches of 'config' for 'ticks' ticks each:
+static Results play_block(GameConfig const &config, uint32_t matches, uint32_t ticks, float tick, float noise, uint64_t seed) {
+	GameBatch batch(matches, config);
+	Bots bots(seed, noise);
+	std::vector< GameBatch::Input > inputs(matches);
+	std::vector< uint32_t > rally_ticks(matches, 0), rally_hits(matches, 0);
+
+	Results results;
+	results.matches = matches;
+	results.ticks = uint64_t(matches) * ticks;
+	for (uint32_t t = 0; t < ticks; ++t) {
+		for (uint32_t m = 0; m < matches; ++m) {
+			inputs[m].player_0 = bots.input(batch, m, 0);
+			inputs[m].player_1 = bots.input(batch, m, 1);
+		}
+		batch.step(inputs.data(), tick);
+
+		for (uint32_t m = 0; m < matches; ++m) {
+			if (!batch.moving[m]) continue;
+			rally_ticks[m] += 1;
+			if (batch.hit[m] != NEUTRAL) rally_hits[m] += 1;
+			if (batch.scored[m] != NEUTRAL) {
+				results.goals[batch.scored[m] == PLAYER_0 ? 0 : 1] += 1;
+				results.rallies += 1;
+				results.rally_ticks += rally_ticks[m];
+				results.rally_hits += rally_hits[m];
+				results.longest_rally_ticks = std::max< uint64_t >(results.longest_rally_ticks, rally_ticks[m]);
+				rally_ticks[m] = 0;
+				rally_hits[m] = 0;
+			}
+		}
+	}
+	results.hits = batch.stats.hits;
+	return results;
+}
+
+//---------------------------------------------
+//work-stealing pool
+
+struct Job {
+	uint32_t config; //index into the grid
+	uint32_t block; //which block of that config's matches
+};
+
+//each worker pops from the back of its own queue and, when that's empty, steals from the front of others':
+struct StealingQueues {
+	struct Queue {
+		std::mutex mutex;
+		std::deque< Job > jobs;
+	};
+	std::vector< Queue > queues;
+
+	explicit StealingQueues(uint32_t count) : queues(count) { }
+
+	bool take(uint32_t self, Job *job) {
+		{
+			Queue &own = queues[self];
+			std::unique_lock< std::mutex > lock(own.mutex);
+			if (!own.jobs.empty()) {
+				*job = own.jobs.back();
+				own.jobs.pop_back();
+				return true;
+			}
+		}
+		//(no job ever adds more jobs, so once every queue is seen empty there's nothing left to do)
+		for (uint32_t i = 1; i < queues.size(); ++i) {
+			Queue &other = queues[(self + i) % queues.size()];
+			std::unique_lock< std::mutex > lock(other.mutex);
+			if (!other.jobs.empty()) {
+				*job = other.jobs.front();
+				other.jobs.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+//---------------------------------------------
+
+int main(int argc, char **argv) {
+	//------------ argument parsing ------------
+
+	std::vector< std::vector< double > > axes(GameConfig::Fields.size());
+	uint32_t matches = 256;
+	float seconds = 300.0f;
+	float tick = Game::Tick;
+	float noise = 0.1f;
+	uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t block_size = 32;
+	uint64_t seed = 15466;
+	std::string out_file;
+
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t./sweep [--<config field> <v1,v2,...>]... [--matches <count>] [--seconds <seconds>] [--tick-hz <rate>]\n"
+		             "\t        [--noise <fraction>] [--threads <count>] [--block <matches>] [--seed <seed>] [--out <file.csv>]\n"
+		             "\tconfig fields (unlisted ones keep their defaults):";
+		for (char const *field : GameConfig::Fields) {
+			std::cerr << " " << field << " (" << GameConfig().get(field) << ")";
+		}
+		std::cerr << "\n"
+		             "\t--matches: matches played per config (default 256)\n"
+		             "\t--seconds: simulated length of each match (default 300)\n"
+		             "\t--noise: chance per tick that a bot presses something random (default 0.1)\n"
+		             "\t--threads: worker threads (default: one per core)\n"
+		             "\t--block: matches stepped together in one GameBatch (default 32)\n"
+		             "\t--out: CSV file to write (default: standard output)" << std::endl;
+	};
+
+	try {
+		for (int argi = 1; argi < argc; ++argi) {
+			std::string arg = argv[argi];
+			bool has_value = argi + 1 < argc;
+			auto field = std::find_if(GameConfig::Fields.begin(), GameConfig::Fields.end(), [&](char const *f) {
+				return arg == std::string("--") + f;
+			});
+			if (field != GameConfig::Fields.end() && has_value) {
+				std::vector< double > &axis = axes[field - GameConfig::Fields.begin()];
+				std::istringstream values(argv[++argi]);
+				std::string value;
+				while (std::getline(values, value, ',')) {
+					axis.emplace_back(std::stod(value));
+				}
+			} else if (arg == "--matches" && has_value) {
+				matches = uint32_t(std::stoul(argv[++argi]));
+			} else if (arg == "--seconds" && has_value) {
+				seconds = std::stof(argv[++argi]);
+			} else if (arg == "--tick-hz" && has_value) {
+				tick = 1.0f / std::stof(argv[++argi]);
+			} else if (arg == "--noise" && has_value) {
+				noise = std::stof(argv[++argi]);
+			} else if (arg == "--threads" && has_value) {
+				threads = std::max(1u, uint32_t(std::stoul(argv[++argi])));
+			} else if (arg == "--block" && has_value) {
+				block_size = std::max(1u, uint32_t(std::stoul(argv[++argi])));
+			} else if (arg == "--seed" && has_value) {
+				seed = std::stoull(argv[++argi]);
+			} else if (arg == "--out" && has_value) {
+				out_file = argv[++argi];
+			} else {
+				usage();
+				return 1;
+			}
+		}
+	} catch (std::exception const &e) {
+		std::cerr << "Bad argument: " << e.what() << std::endl;
+		usage();
+		return 1;
+	}
+	if (matches == 0 || !(seconds > 0.0f)) {
+		usage();
+		return 1;
+	}
+
+	//------------ grid ------------
+
+	std::vector< GameConfig > grid(1);
+	try {
+		for (uint32_t f = 0; f < axes.size(); ++f) {
+			if (axes[f].empty()) continue;
+			std::vector< GameConfig > expanded;
+			for (GameConfig const &config : grid) {
+				for (double value : axes[f]) {
+					expanded.emplace_back(config);
+					expanded.back().set(GameConfig::Fields[f], value);
+				}
+			}
+			grid = std::move(expanded);
+		}
+		for (GameConfig const &config : grid) {
+			config.validate();
+		}
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	uint32_t ticks = uint32_t(std::ceil(seconds / tick));
+	uint32_t blocks = (matches + block_size - 1) / block_size;
+	std::cerr << "Sweeping " << grid.size() << " configs x " << matches << " matches x " << seconds << " s on "
+	          << threads << " thread" << (threads == 1 ? "" : "s") << "." << std::endl;
+
+	//------------ play ------------
+
+	//deal the jobs out round-robin; stealing evens out whatever imbalance is left:
+	StealingQueues queues(threads);
+	for (uint32_t c = 0; c < grid.size(); ++c) {
+		for (uint32_t b = 0; b < blocks; ++b) {
+			queues.queues[(c * blocks + b) % threads].jobs.emplace_back(Job{c, b});
+		}
+	}
+
+	std::vector< Results > block_results(grid.size() * blocks);
+	std::atomic< uint32_t > done(0);
+	auto before = std::chrono::steady_clock::now();
+
+	auto work = [&](uint32_t self) {
+		Job job;
+		while (queues.take(self, &job)) {
+			uint32_t first = job.block * block_size;
+			uint32_t count = std::min(block_size, matches - first);
+			uint64_t block_seed = seed ^ (uint64_t(job.config) << 32) ^ job.block;
+			block_results[job.config * blocks + job.block] = play_block(grid[job.config], count, ticks, tick, noise, block_seed);
+
+			uint32_t finished = done.fetch_add(1) + 1;
+			if (finished % std::max(1u, uint32_t(block_results.size() / 20)) == 0) {
+				std::cerr << "  " << finished << " / " << block_results.size() << " blocks" << std::endl;
+			}
+		}
+	};
+	std::vector< std::thread > workers;
+	for (uint32_t t = 1; t < threads; ++t) {
+		workers.emplace_back(work, t);
+	}
+	work(0);
+	for (auto &w : workers) {
+		w.join();
+	}
+
+	double wall = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	double match_ticks = double(grid.size()) * matches * ticks;
+	std::cerr << "Played " << std::fixed << std::setprecision(0) << match_ticks << " match-ticks in " << std::setprecision(1) << wall << " s ("
+	          << std::setprecision(0) << match_ticks / wall << " /sec)." << std::endl;
+
+	//------------ report ------------
+
+	std::ofstream file;
+	if (!out_file.empty()) {
+		file.open(out_file);
+		if (!file) {
+			std::cerr << "Failed to open '" << out_file << "' for writing." << std::endl;
+			return 1;
+		}
+	}
+	std::ostream &out = (out_file.empty() ? std::cout : file);
+
+	for (char const *field : GameConfig::Fields) {
+		out << field << ",";
+	}
+	out << "matches,minutes,goals,goals_0,goals_1,goals_per_minute,hits,hits_per_minute,"
+	       "rallies,mean_rally_seconds,longest_rally_seconds,mean_rally_hits\n";
+
+	out << std::setprecision(6) << std::defaultfloat;
+	for (uint32_t c = 0; c < grid.size(); ++c) {
+		Results r;
+		for (uint32_t b = 0; b < blocks; ++b) {
+			r.add(block_results[c * blocks + b]);
+		}
+		double minutes = r.ticks * double(tick) / 60.0;
+		uint64_t goals = r.goals[0] + r.goals[1];
+		auto per = [](double n, double d) { return d > 0.0 ? n / d : 0.0; };
+
+		for (char const *field : GameConfig::Fields) {
+			out << grid[c].get(field) << ",";
+		}
+		out << r.matches << "," << minutes << ","
+		    << goals << "," << r.goals[0] << "," << r.goals[1] << "," << per(goals, minutes) << ","
+		    << r.hits << "," << per(r.hits, minutes) << ","
+		    << r.rallies << "," << per(r.rally_ticks * double(tick), r.rallies) << "," << r.longest_rally_ticks * double(tick) << ","
+		    << per(r.rally_hits, r.rallies) << "\n";
+	}
+
+	return 0;
+}